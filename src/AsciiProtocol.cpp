@@ -0,0 +1,86 @@
+/*!
+ * @file AsciiProtocol.cpp 与总控服务器通信的ASCII协议解析实现
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "AsciiProtocol.h"
+
+uint32_t ap_hash(const strref& str) {
+	uint32_t hash = 2166136261u;
+	for (strref::const_iterator it = str.begin(); it != str.end(); ++it)
+		hash = (hash ^ uint8_t(*it)) * 16777619u;
+	return hash;
+}
+
+strref AsciiCommand::Get(const strref& key) const {
+	for (int i = 0; i < npair; ++i) {
+		if (pairs[i].key == key) return pairs[i].value;
+	}
+	return strref();
+}
+
+/*
+ * @note 数值位于接收缓冲区中, 其后未必有结束符, 因此拷贝至栈上再转换
+ */
+bool AsciiCommand::Get(const strref& key, int& value) const {
+	double val;
+	if (!Get(key, val) || val != int(val)) return false;
+	value = int(val);
+	return true;
+}
+
+bool AsciiCommand::Get(const strref& key, double& value) const {
+	strref str = Get(key);
+	char buff[32], *end;
+	if (str.empty() || str.size() >= sizeof(buff)) return false;
+	memcpy(buff, str.data(), str.size());
+	buff[str.size()] = 0;
+	value = strtod(buff, &end);
+	return *end == 0;
+}
+
+bool AsciiProtocol::Resolve(const char* data, const int n, AsciiCommand& cmd) {
+	strref line = trim(strref(data, n > 0 ? n : 0));
+	strref::size_type pos = line.find(' ');
+
+	cmd.npair = 0;
+	cmd.gid.clear();
+	cmd.uid.clear();
+	cmd.cid.clear();
+	cmd.type = line.substr(0, pos);
+	cmd.hash = ap_hash(cmd.type);
+	if (cmd.type.empty()) return false;
+	if (pos == strref::npos) return true;
+
+	// 键值对: key=value, 以逗号分隔
+	for (strref rest = line.substr(pos + 1); !rest.empty(); ) {
+		strref::size_type comma = rest.find(',');
+		strref pair = trim(rest.substr(0, comma));
+		rest = comma == strref::npos ? strref() : rest.substr(comma + 1);
+		if (pair.empty()) continue;
+
+		strref::size_type equal = pair.find('=');
+		if (equal == strref::npos || equal == 0) return false;
+		strref key = trim(pair.substr(0, equal));
+		strref val = trim(pair.substr(equal + 1));
+
+		if      (key == "gid") cmd.gid = val;
+		else if (key == "uid") cmd.uid = val;
+		else if (key == "cid") cmd.cid = val;
+		else if (cmd.npair < AP_MAX_PAIRS) {
+			cmd.pairs[cmd.npair].key   = key;
+			cmd.pairs[cmd.npair].value = val;
+			++cmd.npair;
+		}
+		else return false;
+	}
+	return true;
+}
+
+strref AsciiProtocol::trim(strref str) {
+	while (!str.empty() && isspace((unsigned char) str.front())) str.remove_prefix(1);
+	while (!str.empty() && isspace((unsigned char) str.back()))  str.remove_suffix(1);
+	return str;
+}
@@ -0,0 +1,95 @@
+/*!
+ * @file AsciiProtocol.h 与总控服务器通信的ASCII协议解析接口
+ * @version 0.1
+ * @date 2026-10-17
+ * @note
+ * 协议格式: type key1=value1, key2=value2, ...
+ * - type与键值对之间以空格分隔, 键值对之间以逗号分隔, 忽略首尾空白
+ * - 解析结果为指向原始数据的字符串视图, 不分配内存. 视图在原始数据被清除前有效
+ * - 协议类型由编译期计算的FNV-1a散列值分派. 分派表中散列值重复时无法通过编译,
+ *   运行时再比较字符串, 排除表外类型的散列冲突
+ */
+
+#ifndef SRC_ASCIIPROTOCOL_H_
+#define SRC_ASCIIPROTOCOL_H_
+
+#include <stdint.h>
+#include <boost/utility/string_ref.hpp>
+
+typedef boost::string_ref strref;
+
+#define AP_MAX_PAIRS	32		//< 单条协议最多键值对数量
+
+/*!
+ * @brief 编译期计算字符串的FNV-1a散列值
+ */
+constexpr uint32_t ap_hash(const char* str, uint32_t hash = 2166136261u) {
+	return *str ? ap_hash(str + 1, (hash ^ uint8_t(*str)) * 16777619u) : hash;
+}
+
+/*!
+ * @brief 运行时计算字符串视图的FNV-1a散列值
+ */
+uint32_t ap_hash(const strref& str);
+
+/*!
+ * @struct AsciiKeyVal 键值对
+ */
+struct AsciiKeyVal {
+	strref key;		//< 关键字
+	strref value;	//< 数值
+};
+
+/*!
+ * @struct AsciiCommand 解析后的协议
+ */
+struct AsciiCommand {
+	strref type;	//< 协议类型
+	uint32_t hash;	//< 协议类型的散列值
+	strref gid;		//< 组标志
+	strref uid;		//< 单元标志
+	strref cid;		//< 相机标志
+	int npair;		//< 键值对数量
+	AsciiKeyVal pairs[AP_MAX_PAIRS];	//< 键值对, 不含设备标志
+
+public:
+	/*!
+	 * @brief 查找关键字对应的数值
+	 * @return
+	 * 数值. 关键字不存在时为空
+	 */
+	strref Get(const strref& key) const;
+	/*!
+	 * @brief 查找关键字对应的整数
+	 * @return
+	 * 关键字存在且数值有效
+	 */
+	bool Get(const strref& key, int& value) const;
+	/*!
+	 * @brief 查找关键字对应的浮点数
+	 * @return
+	 * 关键字存在且数值有效
+	 */
+	bool Get(const strref& key, double& value) const;
+};
+
+class AsciiProtocol {
+public:
+	/*!
+	 * @brief 解析一条协议
+	 * @param data 协议首地址, 不含换行符
+	 * @param n    协议长度
+	 * @param cmd  解析结果
+	 * @return
+	 * 协议格式是否有效
+	 */
+	bool Resolve(const char* data, const int n, AsciiCommand& cmd);
+
+protected:
+	/*!
+	 * @brief 去除首尾空白
+	 */
+	strref trim(strref str);
+};
+
+#endif /* SRC_ASCIIPROTOCOL_H_ */
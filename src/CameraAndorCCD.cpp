@@ -176,6 +176,7 @@ bool CameraAndorCCD::start_expose(float duration, bool light) {
 
 bool CameraAndorCCD::stop_expose() {
 	stoppedexp_ = DRV_SUCCESS == AbortAcquisition();
+	CancelWait();
 	return stoppedexp_;
 }
 
@@ -207,6 +208,21 @@ CameraBase::CAMERA_STATUS CameraAndorCCD::download_image() {
 	return state;
 }
 
+/*
+ * @note 以进度通知周期为超时时间, 分段等待采集完成事件
+ */
+CameraBase::CAMERA_STATUS CameraAndorCCD::wait_for_completion() {
+	CAMERA_STATUS state;
+	unsigned int rslt;
+
+	while (1) {
+		rslt = WaitForAcquisitionTimeOut(progperiod_);
+		if (rslt != DRV_SUCCESS && rslt != DRV_NO_NEW_DATA) return CAMERA_ERROR;
+		if ((state = camera_state()) != CAMERA_EXPOSE) return state;
+		notify_progress();
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 bool CameraAndorCCD::load_parameters() {
 	try {
@@ -124,6 +124,12 @@ protected:
 	 * - CAMERA_ERROR:  相机错误
 	 */
 	CAMERA_STATUS download_image();
+	/*!
+	 * @brief 等待曝光结束
+	 * @note
+	 * 基于WaitForAcquisitionTimeOut()阻塞等待, 不再周期查询GetStatus()
+	 */
+	CAMERA_STATUS wait_for_completion();
 
 protected:
 	/* Ancod CCD 相机工作参数 */
@@ -6,7 +6,15 @@
 #include "CameraBase.h"
 
 CameraBase::CameraBase() {
-	nfptr_ = boost::make_shared<CameraInfo>();
+	nfptr_    = boost::make_shared<CameraInfo>();
+	frmslots_ = 3;
+	frmseq_   = 0;
+	armed_    = false;
+	aborted_  = false;
+	progperiod_ = 500;
+	pollwin_    = 100;
+	pollperiod_ = 10;
+	softbin_    = SOFTBIN_SUM;
 }
 
 CameraBase::~CameraBase() {
@@ -38,15 +46,23 @@ bool CameraBase::Connect() {
 	nfptr_->errcode   = 0;
 	nfptr_->errmsg    = "";
 	nfptr_->roi.Reset(nfptr_->sensorW, nfptr_->sensorH);
-	nfptr_->AllocImageBuffer();
+	nfptr_->roisoft = nfptr_->roi;
+	nfptr_->softroi = false;
+	alloc_frames();
 	thrdcool_.reset(new boost::thread(boost::bind(&CameraBase::thread_cool, this)));
 	thrdexp_.reset(new boost::thread(boost::bind(&CameraBase::thread_expose, this)));
+	thrdfrm_.reset(new boost::thread(boost::bind(&CameraBase::thread_frame, this)));
 
 	return true;
 }
 
 void CameraBase::DisConnect() {
 	if (IsConnected()) {
+		{
+			mutex_lock lck(mtxexp_);
+			seq_.stopping = true;
+			seq_.active   = false;
+		}
 		if (nfptr_->state >= CAMERA_EXPOSE) {// 等待完成或结束曝光
 			AbortExpose();
 			while (nfptr_->state >= CAMERA_EXPOSE) {
@@ -54,6 +70,7 @@ void CameraBase::DisConnect() {
 			}
 		}
 		int_thread(thrdexp_);
+		int_thread(thrdfrm_);
 		int_thread(thrdcool_);
 		UpdateCooler(false);
 		close_camera();
@@ -65,22 +82,81 @@ bool CameraBase::IsConnected() {
 	return nfptr_->connected;
 }
 
-bool CameraBase::Expose(float duration, bool light) {
-	if (!nfptr_->connected || nfptr_->state != CAMERA_IDLE) return false;
-	if (!start_expose(duration, light)) return false;
-	nfptr_->ExposeBegin(duration);
-	cvexp_.notify_one();
+bool CameraBase::Expose(float duration, bool light, FrameTimeline::steady_time tmcmd) {
+	if (tmcmd == FrameTimeline::steady_time()) tmcmd = boost::chrono::steady_clock::now();
+	if (!nfptr_->connected || nfptr_->state != CAMERA_IDLE || IsSequenceActive()) return false;
+	/* 读出数据可能在start_expose()返回前到达, 故需先选定帧缓存区 */
+	if (!(frmfill_ = acquire_frame())) {
+		nfptr_->errmsg = "no free frame buffer";
+		return false;
+	}
+	frmfill_->timeline.stamp[LAT_COMMAND] = tmcmd;
+	return arm_expose(duration, light);
+}
+
+bool CameraBase::ExposeSequence(int frames, float duration, float interval, bool light,
+		FrameTimeline::steady_time tmcmd) {
+	if (tmcmd == FrameTimeline::steady_time()) tmcmd = boost::chrono::steady_clock::now();
+	if (!nfptr_->connected || nfptr_->state != CAMERA_IDLE || IsSequenceActive()) return false;
+	if (!(frmfill_ = acquire_frame())) {
+		nfptr_->errmsg = "no free frame buffer";
+		return false;
+	}
+	frmfill_->timeline.stamp[LAT_COMMAND] = tmcmd;
+	frmfill_->seqno = 1;
+	{
+		mutex_lock lck(mtxexp_);
+		seq_.total    = frames;
+		seq_.done     = 1;
+		seq_.duration = duration;
+		seq_.interval = interval;
+		seq_.light    = light;
+		seq_.stopping = false;
+		seq_.active   = true;
+	}
+	if (!arm_expose(duration, light)) {
+		mutex_lock lck(mtxexp_);
+		seq_.active = false;
+		return false;
+	}
 	return true;
 }
 
+void CameraBase::AbortSequence() {
+	mutex_lock lck(mtxexp_);
+	if (seq_.active) {
+		seq_.stopping = true;
+		cvabort_.notify_one();	// 结束帧间隔等待
+	}
+}
+
+bool CameraBase::IsSequenceActive() {
+	mutex_lock lck(mtxexp_);
+	return seq_.active;
+}
+
 void CameraBase::AbortExpose() {
-	if (nfptr_->state > CAMERA_IDLE) stop_expose();
+	AbortSequence();
+	if (nfptr_->state > CAMERA_IDLE) {
+		stop_expose();
+		mutex_lock lck(mtxexp_);
+		aborted_ = true;
+		cvabort_.notify_one();
+	}
 }
 
 void CameraBase::RegisterExposeProc(const ExpProcSlot &slot) {
 	cbexp_.connect(slot);
 }
 
+void CameraBase::SetProgressPeriod(int ms) {
+	if (ms > 0) progperiod_ = ms;
+}
+
+void CameraBase::RegisterFrameProc(const FrmProcSlot &slot) {
+	cbfrm_.connect(slot);
+}
+
 bool CameraBase::UpdateCooler(bool onoff, float set) {
 	if (!nfptr_->connected) return false;
 	if ((onoff != nfptr_->coolOn || (onoff && set != nfptr_->coolSet))
@@ -99,7 +175,7 @@ bool CameraBase::UpdateADChannel(uint16_t index) {
 		if (update_adchannel(index, nfptr_->bitpixel)) {
 			nfptr_->iADChannel = index;
 			if (bitpix != nfptr_->bitpixel)
-				nfptr_->AllocImageBuffer();
+				nfptr_->ImageBytes();
 			return true;
 		}
 	}
@@ -177,24 +253,74 @@ bool CameraBase::UpdateROI(int &xb, int &yb, int &x, int &y, int &w, int &h) {
 	if (h == 0) { y = 1, h = nfptr_->sensorH / yb * yb; }
 
 	/* 设置ROI */
-	if (update_roi(xb, yb, x, y, w, h)) {
-		nfptr_->roi.binX = xb;
-		nfptr_->roi.binY = yb;
-		nfptr_->roi.startX = x;
-		nfptr_->roi.startY = y;
-		nfptr_->roi.width  = w;
-		nfptr_->roi.height = h;
-		nfptr_->AllocImageBuffer();
+	int hxb(xb), hyb(yb), hx(x), hy(y), hw(w), hh(h);
+	if (update_roi(hxb, hyb, hx, hy, hw, hh)) {
+		ROI &soft = nfptr_->roisoft;
+		nfptr_->roi.binX = hxb;
+		nfptr_->roi.binY = hyb;
+		nfptr_->roi.startX = hx;
+		nfptr_->roi.startY = hy;
+		nfptr_->roi.width  = hw;
+		nfptr_->roi.height = hh;
+		nfptr_->ImageBytes();
+		/* 相机调整了参数: 读出区域覆盖请求区域且合并因子可整除时, 由软件完成裁剪与合并 */
+		nfptr_->softroi = (hxb != xb || hyb != yb || hx != x || hy != y || hw != w || hh != h)
+				&& xb % hxb == 0 && yb % hyb == 0
+				&& x >= hx && y >= hy && x + w <= hx + hw && y + h <= hy + hh
+				&& (x - hx) % hxb == 0 && (y - hy) % hyb == 0;
+		if (nfptr_->softroi) {
+			soft.binX = xb;
+			soft.binY = yb;
+			soft.startX = x;
+			soft.startY = y;
+			soft.width  = w;
+			soft.height = h;
+		}
+		else {
+			soft = nfptr_->roi;
+			xb = hxb, yb = hyb;
+			x  = hx,  y  = hy;
+			w  = hw,  h  = hh;
+		}
 		return true;
 	}
 
 	return false;
 }
 
+void CameraBase::SetSoftBinning(int mode) {
+	softbin_ = mode == SOFTBIN_MEAN ? SOFTBIN_MEAN : SOFTBIN_SUM;
+}
+
 bool CameraBase::UpdateIP(string const ip, string const mask, string const gw) {
 	return (nfptr_->connected && nfptr_->state == CAMERA_IDLE);
 }
 
+bool CameraBase::SetFrameSlots(int n) {
+	if (n < 1 || n > 32 || nfptr_->state > CAMERA_IDLE) return false;
+	frmslots_ = n;
+	if (nfptr_->connected) alloc_frames();
+	return true;
+}
+
+CameraBase::ImgFrmPtr CameraBase::PopFrame() {
+	ImgFrmPtr frame;
+	{
+		mutex_lock lck(mtxfrm_);
+		if (frmrdy_.size()) {
+			frame = frmrdy_.front();
+			frmrdy_.pop_front();
+			frame->state = FRAME_BUSY;
+		}
+	}
+	if (frame.use_count()) finish_frame(frame);
+	return frame;
+}
+
+string CameraBase::TransportSummary() {
+	return string();
+}
+
 void CameraBase::thread_cool() {
 	boost::chrono::seconds T(30);
 
@@ -205,21 +331,16 @@ void CameraBase::thread_cool() {
 }
 
 void CameraBase::thread_expose() {
-	boost::mutex mtx;
-	mutex_lock lck(mtx);
-	double left, percent;
-	int milsec;
 	CAMERA_STATUS &state = nfptr_->state;
 
 	while (1) {
-		cvexp_.wait(lck); // 等待曝光开始
-		/* 监测曝光过程 */
-		while ((state = camera_state()) == CAMERA_EXPOSE) {
-			nfptr_->CheckExpose(left, percent);
-			if ((milsec = int(left * 1000)) > 100) milsec = 100;
-			cbexp_(left, percent, (int) state);
-			if (milsec) boost::this_thread::sleep_for(boost::chrono::milliseconds(milsec));
+		{// 等待曝光开始
+			mutex_lock lck(mtxexp_);
+			while (!armed_) cvexp_.wait(lck);
+			armed_ = false;
 		}
+		/* 监测曝光过程 */
+		state = wait_for_completion();
 		/*
 		 * 此时state有三种可能:
 		 * - CAMERA_IMGRDY: 正常结束, 可以读出图像数据
@@ -228,12 +349,215 @@ void CameraBase::thread_expose() {
 		 */
 		if (state == CAMERA_IMGRDY) {
 			nfptr_->ExposeEnd();
+			frmfill_->timeline.Mark(LAT_EXPEND);
+			frmfill_->timeline.Mark(LAT_READBEGIN);
 			state = download_image();
+			frmfill_->timeline.Mark(LAT_READEND);
 		}
+		complete_frame(state == CAMERA_IMGRDY);
 		cbexp_(0.0, 100.001, (int) state);
 		// 图像成功读出, 将相机状态设置为空闲
 		if (state == CAMERA_IMGRDY) state = CAMERA_IDLE;
+		// 序列曝光: 读出后立即启动下一帧, 裁剪、统计等后续处理由thread_frame()完成
+		next_sequence();
+	}
+}
+
+void CameraBase::thread_frame() {
+	ImgFrmPtr frame;
+
+	while (1) {
+		{// 等待完成读出
+			mutex_lock lck(mtxfrm_);
+			while (frmrdy_.empty() || cbfrm_.empty()) cvfrm_.wait(lck);
+		}
+		while ((frame = PopFrame()).use_count()) {
+			cbfrm_(frame);
+			frame.reset(); // 释放引用, 以使该帧可用于后续读出
+		}
+	}
+}
+
+bool CameraBase::arm_expose(float duration, bool light) {
+	nfptr_->data = frmfill_->data;
+	if (!start_expose(duration, light)) {
+		complete_frame(false);
+		return false;
+	}
+	frmfill_->timeline.Mark(LAT_STARTED);
+
+	mutex_lock lck(mtxexp_);
+	nfptr_->ExposeBegin(duration);
+	armed_   = true;
+	aborted_ = false;
+	tmprog_  = boost::chrono::steady_clock::now();
+	cvexp_.notify_one();
+	return true;
+}
+
+void CameraBase::finish_frame(const ImgFrmPtr &frame) {
+	if (frame->softroi) {
+		ROI &hw = frame->roiread;
+		ROI &sw = frame->roi;
+		uint32_t satlevel = frame->bitpixel >= 32 ? UINT32_MAX : (uint32_t(1) << frame->bitpixel) - 1;
+
+		SoftCropBin(frame->data.get(), frame->bytepix, hw.Width(), hw.Height(),
+				(sw.startX - hw.startX) / hw.binX, (sw.startY - hw.startY) / hw.binY,
+				sw.binX / hw.binX, sw.binY / hw.binY, sw.Width(), sw.Height(),
+				softbin_, satlevel);
+		frame->softroi = false;
+	}
+	// 统计结果随帧分发, 后续处理无需再次遍历像素
+	if (!frame->stat.valid) {
+		ImageStatistics(frame->data.get(), frame->roi.Pixels(), frame->bytepix,
+				frame->bitpixel, frame->stat);
+	}
+}
+
+/*
+ * @note 缺省等待流程分为两个阶段:
+ * - 距曝光结束时刻较远时不访问相机, 仅按周期通知曝光进度, 可被AbortExpose()唤醒
+ * - 进入曝光结束时刻前的时间窗口后, 以短周期查询相机状态
+ */
+CameraBase::CAMERA_STATUS CameraBase::wait_for_completion() {
+	CAMERA_STATUS state;
+	ptime deadline = nfptr_->tmobs + microseconds(int64_t(nfptr_->exptm * 1E6));
+	int64_t left;
+
+	while ((left = (deadline - microsec_clock::universal_time()).total_milliseconds() - pollwin_) > 0) {
+		if (wait_abort(left < progperiod_ ? left : progperiod_)) break;
+		notify_progress();
+	}
+	while ((state = camera_state()) == CAMERA_EXPOSE) {
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(pollperiod_));
+		notify_progress();
+	}
+	return state;
+}
+
+void CameraBase::notify_progress() {
+	namespace bc = boost::chrono;
+	bc::steady_clock::time_point now = bc::steady_clock::now();
+	if (bc::duration_cast<bc::milliseconds>(now - tmprog_).count() >= progperiod_) {
+		double left, percent;
+		tmprog_ = now;
+		nfptr_->CheckExpose(left, percent);
+		cbexp_(left, percent, (int) CAMERA_EXPOSE);
+	}
+}
+
+bool CameraBase::wait_abort(int ms) {
+	mutex_lock lck(mtxexp_);
+	if (!aborted_) cvabort_.wait_for(lck, boost::chrono::milliseconds(ms));
+	return aborted_;
+}
+
+/*
+ * @note 序列曝光参数由mtxexp_保护. 中止请求仅设置stopping, 由本函数清除active标志,
+ * 避免在本线程退出等待前启动新的序列. 等待期间释放互斥锁:
+ * - 帧间隔与空闲帧等待在cvabort_上进行, 可被AbortSequence()与AbortExpose()提前结束
+ * - 背压机制: 当所有帧缓存区均被使用者持有时, 等待使用者释放帧, 而不是丢弃图像
+ */
+void CameraBase::next_sequence() {
+	mutex_lock lck(mtxexp_);
+	if (!seq_.active) return;
+	if (nfptr_->state != CAMERA_IDLE || seq_.stopping
+			|| (seq_.total > 0 && seq_.done >= seq_.total)) {
+		seq_.active = false;
+		return;
+	}
+	/* 按间隔等待下一帧 */
+	ptime tmnext = nfptr_->tmobs + microseconds(int64_t(seq_.interval * 1E6));
+	int64_t wait;
+	while (seq_.active && !seq_.stopping
+			&& (wait = (tmnext - microsec_clock::universal_time()).total_milliseconds()) > 0) {
+		cvabort_.wait_for(lck, boost::chrono::milliseconds(wait));
+	}
+	/* 等待空闲帧. 等待时间计入该帧的启动时延 */
+	FrameTimeline::steady_time tmcmd = boost::chrono::steady_clock::now();
+	while (seq_.active && !seq_.stopping && !(frmfill_ = acquire_frame()).use_count()) {
+		cvabort_.wait_for(lck, boost::chrono::milliseconds(10));
+	}
+	if (frmfill_.use_count()) frmfill_->timeline.stamp[LAT_COMMAND] = tmcmd;
+	if (!seq_.active || seq_.stopping) {
+		seq_.active = false;
+		lck.unlock();
+		complete_frame(false);
+	}
+	else {
+		float duration = seq_.duration;
+		bool light = seq_.light;
+		frmfill_->seqno = ++seq_.done;
+		lck.unlock();	// arm_expose()需要mtxexp_
+		if (!arm_expose(duration, light)) {
+			lck.lock();
+			seq_.active = false;
+		}
+	}
+}
+
+void CameraBase::alloc_frames() {
+	mutex_lock lck(mtxfrm_);
+	int bytes = nfptr_->ImageBytes();
+	int i, n;
+
+	frmrdy_.clear();
+	frames_.resize(frmslots_);
+	for (i = 0, n = frames_.size(); i < n; ++i) {
+		if (!frames_[i].unique()) frames_[i] = boost::make_shared<ImageFrame>();
+		frames_[i]->Reserve(bytes);
+	}
+}
+
+/*
+ * @note 帧选择策略:
+ * - 优先选择不被任何使用者持有的帧
+ * - 无空闲帧且未注册帧完成回调函数时, 覆盖待处理队列中最早的、且未被使用者取出的帧
+ */
+CameraBase::ImgFrmPtr CameraBase::acquire_frame() {
+	mutex_lock lck(mtxfrm_);
+	ImgFrmPtr frame;
+	int i, n;
+
+	for (i = 0, n = frames_.size(); i < n && !frame; ++i) {
+		if (frames_[i].unique() && frames_[i]->state != FRAME_FILLING)
+			frame = frames_[i];
+	}
+	if (!frame && cbfrm_.empty() && frmrdy_.size() && frmrdy_.front().use_count() == 2) {
+		frame = frmrdy_.front();
+		frmrdy_.pop_front();
+	}
+	if (frame) {
+		frame->Reserve(nfptr_->ImageBytes());
+		frame->seqno = 0;
+		frame->state = FRAME_FILLING;
+		frame->softroi = false;
+		frame->timeline.Reset();
+		frame->stat.valid = false;
+		frame->transfer.Reset();
+	}
+	return frame;
+}
+
+void CameraBase::complete_frame(bool success) {
+	mutex_lock lck(mtxfrm_);
+	if (!frmfill_.use_count()) return;
+	if (success) {
+		frmfill_->id       = ++frmseq_;
+		frmfill_->roi      = nfptr_->softroi ? nfptr_->roisoft : nfptr_->roi;
+		frmfill_->roiread  = nfptr_->roi;
+		frmfill_->softroi  = nfptr_->softroi;
+		frmfill_->bitpixel = nfptr_->bitpixel;
+		frmfill_->bytepix  = nfptr_->bytepix;
+		frmfill_->exptm    = nfptr_->exptm;
+		frmfill_->tmobs    = nfptr_->tmobs;
+		frmfill_->tmend    = nfptr_->tmend;
+		frmfill_->state    = FRAME_READY;
+		frmrdy_.push_back(frmfill_);
+		if (!cbfrm_.empty()) cvfrm_.notify_one();
 	}
+	else frmfill_->state = FRAME_FREE;
+	frmfill_.reset();
 }
 
 void CameraBase::int_thread(threadptr &thrd) {
@@ -16,6 +16,11 @@
 #include <boost/format.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <string>
+#include <vector>
+#include <deque>
+#include "LatencyStat.h"
+#include "ImageStat.h"
+#include "SoftROI.h"
 
 using std::string;
 using namespace boost::posix_time;
@@ -98,7 +103,9 @@ public:
 		string errmsg;			//< 错误描述
 
 		/** 曝光参数 **/
-		ROI roi;		//< ROI区
+		ROI roi;		//< ROI区: 相机读出的区域
+		ROI roisoft;	//< 软件裁剪与合并后的ROI区
+		bool softroi;	//< 相机不支持请求的ROI区或合并因子, 由软件在读出后完成
 		float exptm;	//< 积分时间, 量纲: 秒
 
 		/** 曝光时标 **/
@@ -107,24 +114,25 @@ public:
 		ptime tmend;	//< 曝光结束时间
 
 		/** 图像数据存储区 **/
-		boost::shared_array<uint8_t> data;	//< 图像数据存储区
+		boost::shared_array<uint8_t> data;	//< 图像数据存储区, 指向正在读出的帧缓存区
 		int bytepix;	//< 单像素占用字节数
 
 	public:
 		/*!
-		 * @brief 为图像数据分配存储区
+		 * @brief 计算单帧图像数据所需存储空间
+		 * @return
+		 * 存储空间, 量纲: 字节
 		 * @note
 		 * 前提:
 		 * - 已设置ROI区
 		 * - 已采集A/D位数
 		 */
-		void AllocImageBuffer() {
+		int ImageBytes() {
 			int n = bitpixel / 8;
 			if (n * 8 < bitpixel) ++n;
 			if (n > 1 && (n % 2)) ++n;
 			bytepix = n;
-			n *= (roi.Pixels());
-			data.reset(new uint8_t[n]);
+			return n * roi.Pixels();
 		}
 
 		/*!
@@ -164,6 +172,102 @@ public:
 		}
 	};
 	typedef boost::shared_ptr<CameraInfo> NFCamPtr;
+
+	enum FRAME_STATUS {// 帧缓存区状态
+		FRAME_FREE,		//< 空闲
+		FRAME_FILLING,	//< 正在从相机读出数据
+		FRAME_READY,	//< 已完成读出, 等待处理
+		FRAME_BUSY		//< 正在处理: 存储/显示/统计
+	};
+
+	/*!
+	 * @struct FrameTransfer 单帧网络传输统计
+	 * @note
+	 * 仅适用于网络相机. packets为0时无效
+	 */
+	struct FrameTransfer {
+		uint32_t packets;	//< 图像数据包数量
+		uint32_t lost;		//< 首次传输丢失的数据包数量
+		uint32_t recovered;	//< 经重传恢复的数据包数量
+		uint32_t resent;	//< 申请重传的数据包数量, 含合并区间内已接收的数据包
+		uint32_t requests;	//< 重传请求数量, 每个请求对应一个编号区间
+		uint32_t rounds;	//< 重传轮次
+		uint32_t bytes;		//< 已接收图像数据长度, 量纲: 字节
+		uint32_t sockdrop;	//< 套接字接收缓冲区溢出丢弃的数据包数量
+		uint32_t udpdrop;	//< 系统UDP接收缓冲区错误数量(RcvbufErrors), 含其它套接字
+		uint32_t nicdrop;	//< 网卡丢弃的数据包数量(rx_dropped + rx_missed_errors + rx_fifo_errors)
+		uint32_t delay;		//< 包间延时(GevSCPD), 量纲: 相机时间戳计数
+
+	public:
+		FrameTransfer() {
+			Reset();
+		}
+
+		void Reset() {
+			packets = lost = recovered = resent = requests = rounds = 0;
+			bytes = sockdrop = udpdrop = nicdrop = delay = 0;
+		}
+	};
+
+	/*!
+	 * @struct ImageFrame 帧缓存区: 图像数据及其曝光参数
+	 * @note
+	 * - 帧缓存区组成环形队列, 读出与存储/显示/统计使用不同的帧
+	 * - 相机仅持有帧的一份引用. 使用者释放全部引用后, 帧可再次用于读出
+	 */
+	struct ImageFrame {
+		uint32_t id;		//< 帧序号
+		int seqno;			//< 帧在序列曝光中的编号, 起始值: 1. 0: 单帧曝光
+		FRAME_STATUS state;	//< 帧状态
+		ROI roi;			//< ROI区
+		ROI roiread;		//< 相机读出的ROI区
+		bool softroi;		//< 等待由软件完成裁剪与合并, 之后roi与roiread不同
+		uint16_t bitpixel;	//< 单像素数据位数
+		int bytepix;		//< 单像素占用字节数
+		float exptm;		//< 积分时间, 量纲: 秒
+		ptime tmobs;		//< 曝光起始时间
+		ptime tmend;		//< 曝光结束时间
+		int capacity;		//< 存储区容量, 量纲: 字节
+		boost::shared_array<uint8_t> data;	//< 图像数据存储区
+		FrameTimeline timeline;	//< 各阶段时标
+		FrameStat stat;			//< 统计结果, 帧被取出处理时计算
+		FrameTransfer transfer;	//< 网络传输统计
+
+	public:
+		ImageFrame() {
+			id       = 0;
+			seqno    = 0;
+			state    = FRAME_FREE;
+			softroi  = false;
+			bitpixel = 0;
+			bytepix  = 0;
+			exptm    = 0.0;
+			capacity = 0;
+		}
+
+		/*!
+		 * @brief 检查并扩充存储区
+		 * @param bytes 单帧图像数据长度, 量纲: 字节
+		 */
+		void Reserve(int bytes) {
+			if (bytes > capacity) {
+				data.reset(new uint8_t[bytes]);
+				capacity = bytes;
+			}
+		}
+
+		/*!
+		 * @brief 图像数据长度
+		 * @return
+		 * 数据长度, 量纲: 字节
+		 */
+		int Bytes() {
+			return roi.Pixels() * bytepix;
+		}
+	};
+	typedef boost::shared_ptr<ImageFrame> ImgFrmPtr;
+	typedef std::vector<ImgFrmPtr> ImgFrmVec;
+	typedef std::deque<ImgFrmPtr> ImgFrmQue;
 	typedef boost::shared_ptr<boost::thread> threadptr;
 	typedef boost::unique_lock<boost::mutex> mutex_lock;
 
@@ -175,6 +279,35 @@ public:
 	 */
 	typedef boost::signals2::signal<void (const double, const double, const int)> ExposeProcess;
 	typedef ExposeProcess::slot_type ExpProcSlot;
+	/*!
+	 * @brief 声明帧完成插槽函数
+	 * @param <1> 完成读出的帧
+	 * @note
+	 * 在独立线程中调用, 不阻塞曝光与读出流程
+	 */
+	typedef boost::signals2::signal<void (const ImgFrmPtr&)> FrameProcess;
+	typedef FrameProcess::slot_type FrmProcSlot;
+
+	/*!
+	 * @struct SequenceInfo 序列曝光参数
+	 */
+	struct SequenceInfo {
+		bool active;	//< 序列曝光进行中
+		bool stopping;	//< 完成当前帧后结束序列
+		bool light;		//< 是否需要外界光源
+		int total;		//< 总帧数. <= 0: 持续曝光直至中止
+		int done;		//< 已启动帧数
+		float duration;	//< 积分时间, 量纲: 秒
+		float interval;	//< 相邻两帧曝光起始时间的间隔, 量纲: 秒
+
+	public:
+		SequenceInfo() {
+			active = stopping = false;
+			light  = true;
+			total  = done = 0;
+			duration = interval = 0.0;
+		}
+	};
 
 /////////////////////////////////////////////////////////////////////////////
 public:
@@ -185,10 +318,31 @@ public:
 protected:
 	/* 成员变量 */
 	ExposeProcess cbexp_;	//< 曝光进度插槽函数
+	FrameProcess cbfrm_;	//< 帧完成插槽函数
 	NFCamPtr nfptr_;		//< 相机参数及工作状态
 	threadptr thrdexp_;		//< 线程: 监测曝光进度和结果
 	threadptr thrdcool_;	//< 线程: 相机空闲时监测探测器温度
+	threadptr thrdfrm_;		//< 线程: 分发已完成读出的帧
 	boost::condition_variable cvexp_;	//< 事件: 曝光进度发生变化
+	boost::mutex mtxexp_;	//< 互斥锁: 启动曝光与序列曝光参数
+	bool armed_;			//< 已启动曝光, 等待监测线程响应
+	bool aborted_;			//< 已请求中止曝光
+	boost::condition_variable cvabort_;	//< 事件: 中止曝光
+	int progperiod_;		//< 曝光进度通知周期, 量纲: 毫秒
+	int pollwin_;			//< 临近曝光结束时查询相机状态的时间窗口, 量纲: 毫秒
+	int pollperiod_;		//< 时间窗口内查询相机状态的周期, 量纲: 毫秒
+	int softbin_;			//< 软件合并方式, SOFTBIN_MODE
+	boost::chrono::steady_clock::time_point tmprog_;	//< 最近一次通知曝光进度的时间
+	SequenceInfo seq_;		//< 序列曝光参数. 由mtxexp_保护
+
+	/* 帧缓存区 */
+	int frmslots_;			//< 帧缓存区数量
+	uint32_t frmseq_;		//< 帧序号
+	ImgFrmVec frames_;		//< 帧缓存区环形队列
+	ImgFrmPtr frmfill_;		//< 正在读出的帧
+	ImgFrmQue frmrdy_;		//< 已完成读出, 等待处理的帧
+	boost::mutex mtxfrm_;	//< 互斥锁: 帧缓存区
+	boost::condition_variable cvfrm_;	//< 事件: 完成帧读出
 
 /////////////////////////////////////////////////////////////////////////////
 public:
@@ -218,12 +372,40 @@ public:
 	 * @brief 尝试启动曝光流程
 	 * @param duration  曝光周期, 量纲: 秒
 	 * @param light     是否需要外界光源
+	 * @param tmcmd     收到曝光指令的时间. 缺省为调用时间
+	 * @return
+	 * 曝光启动结果
+	 */
+	bool Expose(float duration, bool light = true,
+			FrameTimeline::steady_time tmcmd = FrameTimeline::steady_time());
+	/*!
+	 * @brief 尝试启动序列曝光流程
+	 * @param frames    帧数. <= 0: 持续曝光直至中止
+	 * @param duration  曝光周期, 量纲: 秒
+	 * @param interval  相邻两帧曝光起始时间的间隔, 量纲: 秒. 小于曝光加读出时间时, 读出后立即启动下一帧
+	 * @param light     是否需要外界光源
+	 * @param tmcmd     收到曝光指令的时间. 缺省为调用时间
 	 * @return
 	 * 曝光启动结果
 	 */
-	bool Expose(float duration, bool light = true);
+	bool ExposeSequence(int frames, float duration, float interval = 0.0, bool light = true,
+			FrameTimeline::steady_time tmcmd = FrameTimeline::steady_time());
+	/*!
+	 * @brief 完成当前帧后结束序列曝光
+	 */
+	void AbortSequence();
+	/*!
+	 * @brief 检查序列曝光是否在进行中
+	 * @return
+	 * 序列曝光进行中标志
+	 * @note
+	 * 请求结束序列后, 直至曝光线程完成当前帧并退出序列前, 仍返回true
+	 */
+	bool IsSequenceActive();
 	/*!
 	 * @brief 中止当前曝光过程
+	 * @note
+	 * 同时中止序列曝光
 	 */
 	void AbortExpose();
 	/*!
@@ -231,6 +413,18 @@ public:
 	 * @param slot 函数插槽
 	 */
 	void RegisterExposeProc(const ExpProcSlot &slot);
+	/*!
+	 * @brief 设置曝光进度通知周期
+	 * @param ms 周期, 量纲: 毫秒
+	 */
+	void SetProgressPeriod(int ms);
+	/*!
+	 * @brief 注册帧完成回调函数
+	 * @param slot 函数插槽
+	 * @note
+	 * 注册回调函数后, 已完成读出的帧由回调函数处理, 不再通过PopFrame()取出
+	 */
+	void RegisterFrameProc(const FrmProcSlot &slot);
 	/*!
 	 * @brief 设置制冷温度
 	 * @param onoff  启动/停止制冷功能
@@ -296,14 +490,45 @@ public:
 	 * @param y   Y轴起始位置, 相对原始图像起始位置
 	 * @param w   ROI区宽度
 	 * @param h   ROI区高度
+	 * @note
+	 * 相机调整了请求的参数, 且其读出区域覆盖请求的区域时, 读出后由软件完成裁剪与合并
 	 */
 	bool UpdateROI(int &xb, int &yb, int &x, int &y, int &w, int &h);
+	/*!
+	 * @brief 设置软件合并方式
+	 * @param mode 合并方式, SOFTBIN_MODE
+	 */
+	void SetSoftBinning(int mode);
 	/*!
 	 * @brief 设置相机IP地址
 	 * @return
 	 * 操作结果
 	 */
 	virtual bool UpdateIP(string const ip, string const mask, string const gw);
+	/*!
+	 * @brief 设置帧缓存区数量
+	 * @param n 帧缓存区数量. 有效范围: [1, 32]
+	 * @return
+	 * 成功标志
+	 * @note
+	 * 应在Connect()之前或相机空闲时调用
+	 */
+	bool SetFrameSlots(int n);
+	/*!
+	 * @brief 取出最早完成读出且尚未处理的帧
+	 * @return
+	 * 帧指针. 无待处理帧时返回空指针
+	 * @note
+	 * - 使用者持有返回的指针期间, 该帧不会被新的曝光覆盖
+	 * - 软件裁剪与合并及统计在取出帧的线程中完成, 不占用曝光与读出流程
+	 */
+	ImgFrmPtr PopFrame();
+	/*!
+	 * @brief 生成数据传输统计的文本
+	 * @return
+	 * 统计文本. 相机未统计时返回空字符串
+	 */
+	virtual string TransportSummary();
 
 /////////////////////////////////////////////////////////////////////////////
 protected:
@@ -385,6 +610,31 @@ protected:
 	virtual CAMERA_STATUS download_image() = 0;
 
 protected:
+	/* 虚函数, 继承类可重载 */
+	/*!
+	 * @brief 等待曝光结束
+	 * @return
+	 * 相机工作状态. 同camera_state()
+	 * @note
+	 * - 缺省实现: 在曝光结束时刻前的时间窗口内才查询相机状态
+	 * - 支持阻塞等待的相机应重载该函数, 并在等待期间调用notify_progress()
+	 */
+	virtual CAMERA_STATUS wait_for_completion();
+
+protected:
+	/*!
+	 * @brief 按周期通知曝光进度
+	 * @note
+	 * 距上次通知的时间不足progperiod_时忽略
+	 */
+	void notify_progress();
+	/*!
+	 * @brief 等待中止曝光事件
+	 * @param ms 最长等待时间, 量纲: 毫秒
+	 * @return
+	 * 已请求中止曝光
+	 */
+	bool wait_abort(int ms);
 	/*!
 	 * @brief 线程: 采集探测器温度
 	 */
@@ -393,6 +643,42 @@ protected:
 	 * @brief 线程: 监测曝光进度
 	 */
 	void thread_expose();
+	/*!
+	 * @brief 线程: 分发已完成读出的帧
+	 */
+	void thread_frame();
+	/*!
+	 * @brief 在已选定的帧上启动曝光
+	 * @param duration  曝光周期, 量纲: 秒
+	 * @param light     是否需要外界光源
+	 * @return
+	 * 曝光启动结果
+	 */
+	bool arm_expose(float duration, bool light);
+	/*!
+	 * @brief 完成帧的软件裁剪与合并, 并统计图像
+	 * @param frame 已完成读出的帧
+	 */
+	void finish_frame(const ImgFrmPtr &frame);
+	/*!
+	 * @brief 完成一帧后启动序列曝光中的下一帧
+	 */
+	void next_sequence();
+	/*!
+	 * @brief 按当前ROI区和A/D位数分配帧缓存区
+	 */
+	void alloc_frames();
+	/*!
+	 * @brief 为新的曝光选择空闲帧
+	 * @return
+	 * 帧指针. 无空闲帧时返回空指针
+	 */
+	ImgFrmPtr acquire_frame();
+	/*!
+	 * @brief 完成读出, 将帧加入待处理队列
+	 * @param success 读出结果
+	 */
+	void complete_frame(bool success);
 	/*!
 	 * @brief 中断线程
 	 * @param thrd 线程指针
@@ -2,13 +2,22 @@
  * @file CameraGY.cpp GWAC定制相机(重庆港宇公司研发电控系统)控制接口定义文件
  */
 #include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
 #include <ifaddrs.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "CameraGY.h"
+#include "GLog.h"
 
 using namespace std;
 
-CameraGY::CameraGY(string const camIP)
+CameraGY::CameraGY(string const camIP, const IOExecPtr &exec)
 	: portCamera_(3956)
 	, portLocal_(49152)
 	, idLeader_(0x1)
@@ -16,20 +25,49 @@ CameraGY::CameraGY(string const camIP)
 	, idPayload_(0x3)
 	, headsize_(8) {
 	camIP_     = camIP;
-	msgcnt_    = 0;
+	cur_       = -1;
+	frmxfer_   = 0;
+	frmlossy_  = 0;
+	frmtmo_    = 0;
+	pcklate_   = 0;
+	pckstray_  = 0;
+	paceauto_  = false;
+	pacemax_   = 0;
+	pacestep_  = 0;
+	pacedelay_ = 0;
+	pacewrt_   = 0;
+	pacebest_  = 0;
+	paceclean_ = 0;
+	paceup_    = 0;
+	pacedown_  = 0;
+	for (int i = 0; i < GY_FRAME_SLOTS; ++i) {
+		slots_[i].block = 0;
+		slots_[i].data  = NULL;
+	}
+	packreq_   = 0;
+	packneg_   = GY_PACKET_MIN;
+	probing_   = false;
+	probelen_  = 0;
+	rcvbuf_    = 0;
+	memset(dropbase_, 0, sizeof(dropbase_));
+	lockmem_   = false;
+	locked_    = NULL;
+	lockbytes_ = 0;
 	nfptr_->model  = "GWAC, E2V CCD";
 	nfptr_->pixelX = 12.0;
 	nfptr_->pixelY = 12.0;
 
 	// 初始化通信接口
-	const UDPSession::CBSlot &slot = boost::bind(&CameraGY::receive_data, this, _1, _2);
-	udpdata_ = makeudp_session(portLocal_);
-	udpdata_->RegisterRead(slot);
-	udpcmd_ = makeudp_session();
-	udpcmd_->Connect(camIP.c_str(), portCamera_);
+	stream_ = boost::make_shared<GVSPStream>();
+	stream_->RegisterBatch(boost::bind(&CameraGY::receive_packets, this, _1, _2));
+	stream_->RegisterPlace(boost::bind(&CameraGY::place_packets, this, _1, _2));
+	stream_->Open(portLocal_, GY_PACKET_MAX - 28);	// 存储区按巨型帧分配, 协商后缩小
+	gvcp_ = boost::make_shared<GVCPClient>();
+	gvcp_->Open(camIP, portCamera_, exec);
 }
 
 CameraGY::~CameraGY() {
+	unlock_frame();
 }
 
 bool CameraGY::UpdateIP(string const ip, string const mask, string const gw) {
@@ -45,50 +83,60 @@ bool CameraGY::open_camera() {
 		uint32_t addrHost = get_hostaddr();
 		if (addrHost == 0x00)
 			throw runtime_error("no matched host IP address");
-		// 检测与相机通信是否正常
+		if (rcvbuf_ > 0) stream_->SetRecvBuffer(rcvbuf_);
+		if (!stream_->Start())
+			throw runtime_error(string("failed to open stream channel: ") + stream_->GetError());
+		// 检测与相机通信是否正常. 应答数据[36, 39]为相机当前IP地址
 		using boost::asio::ip::address_v4;
-		boost::array<uint8_t, 8> towrite = {0x42, 0x01, 0x00, 0x02, 0x00, 0x00};
-		int bytercv, trycnt(0);
-		address_v4 addr1, addr2;
-		const uint8_t *rcvd;
-
-		msgcnt_ = 0;
-		do {
-			((uint16_t*)&towrite)[3] = htons(msg_count());
-			udpcmd_->Write(towrite.c_array(), towrite.size());
-			rcvd = (const uint8_t *) udpcmd_->BlockRead(bytercv);
-		} while (bytercv < 48 && ++trycnt < 3);
-		if (bytercv < 48)
+		GVCPClient::bytevec reply;
+		if (!gvcp_->Transact(GVCP_DISCOVERY_CMD, GVCP_DISCOVERY_ACK, NULL, 0, reply) || reply.size() < 40)
 			throw runtime_error("failed to communicate with camera");
-		addr1 = address_v4(rcvd[47] + uint32_t(rcvd[46] << 8) + uint32_t(rcvd[45] << 16) + uint32_t(rcvd[44] << 24));
-		addr2 = address_v4::from_string(camIP_);
-		if (addr1 != addr2)
+		address_v4 addr1(reply[39] + uint32_t(reply[38] << 8) + uint32_t(reply[37] << 16) + uint32_t(reply[36] << 24));
+		if (addr1 != address_v4::from_string(camIP_))
 			throw runtime_error("not found camera");
 
 		// 初始化参数
-		reg_write(0x0A00,     0x03);		// Set GevCCP
-		reg_write(0x0D00,     portLocal_);	// Set GevSCPHostPort
-		reg_write(0x0D04,     1500);		// Set PacketSize
-		reg_write(0x0D08,     0);			// Set PacketDelay
-		reg_write(0x0D18,     addrHost);	// Set GevSCDA
-		reg_write(0xA000,     0x01);		// Start AcquisitionSequence
-		reg_write(0x0938,     0x2710);		// 心跳延时0x2710==10000ms=10s
+		const uint32_t addrInit[] = {
+			0x0A00,		// Set GevCCP
+			0x0D00,		// Set GevSCPHostPort
+			0x0D08,		// Set PacketDelay: 协商数据包长度期间不延时
+			0x0D18		// Set GevSCDA
+		};
+		const uint32_t valInit[] = { 0x03, portLocal_, 0, addrHost };
+		reg_write(addrInit, valInit, 4);
+		packneg_ = negotiate_packet(addrHost);	// Set PacketSize
+		if (stream_->PolicyError().size())
+			_gLog.Write(LOG_WARN, NULL, "GY stream thread policy not applied: %s", stream_->PolicyError().c_str());
+		load_pacing();
+		const uint32_t addrStart[] = {
+			0x0D08,		// Set PacketDelay
+			0xA000,		// Start AcquisitionSequence
+			0x0938		// 心跳延时0x2710==10000ms=10s
+		};
+		const uint32_t valStart[] = { pacedelay_, 0x01, 0x2710 };
+		reg_write(addrStart, valStart, 3);
+		pacewrt_ = pacedelay_;
 		// 初始化监测量
-		uint32_t val;
-		reg_read(0x00020008,  gain_);
-		reg_read(0x0002000C,  shtrmode_);
-		reg_read(0x00020010,  expdur_);
-
-		reg_read(0xA004, val);
-		nfptr_->sensorW = int(val);
-		reg_read(0xA008, val);
-		nfptr_->sensorH = int(val);
+		const uint32_t addrMon[] = { 0x00020008, 0x0002000C, 0x00020010, 0xA004, 0xA008, 0x0D04 };
+		uint32_t valMon[6];
+		reg_read(addrMon, valMon, 6);
+		gain_     = valMon[0];
+		shtrmode_ = valMon[1];
+		expdur_   = valMon[2];
+		nfptr_->sensorW = int(valMon[3]);
+		nfptr_->sensorH = int(valMon[4]);
 		byteimg_ = nfptr_->sensorW * nfptr_->sensorH * 2;
 
-		reg_read(0x0D04,     packsize_);
-		packsize_ -= (20 + 8 + headsize_);
+		packsize_ = (valMon[5] & 0xFFFF) - (20 + 8 + headsize_);	// 高位为测试包标志
 		packcnt_ = int(ceil(double(byteimg_ + 64) / packsize_)); // 最后一包多出64字节
-		packflag_.reset(new uint8_t[packcnt_ + 1]);
+		{// 重新连接后相机的数据块编号可能从头开始, 清空重组表
+			mutex_lock lck(mtx_slot_);
+			for (int i = 0; i < GY_FRAME_SLOTS; ++i) {
+				slots_[i].block = 0;
+				slots_[i].data  = NULL;
+			}
+			cur_ = -1;
+		}
 
 		// 启动心跳机制, 维护与相机间的网络连接
 		thrdhb_.reset(new boost::thread(boost::bind(&CameraGY::thread_heartbeat, this)));
@@ -105,6 +153,8 @@ bool CameraGY::open_camera() {
 bool CameraGY::close_camera() {
 	int_thread(thrdhb_);
 	int_thread(thrdread_);
+	stream_->Stop();
+	unlock_frame();
 	return true;
 }
 
@@ -174,24 +224,40 @@ bool CameraGY::update_adoffset(uint16_t offset) {
 
 bool CameraGY::start_expose(float duration, bool light) {
 	try {
-		// 设置环境参数
-		bytercd_ = 0;
-		idFrame_  = uint16_t(-1);
-		idPack_   = uint32_t(-1);
-		memset(packflag_.get(), 0, packcnt_ + 1);
+		// 设置环境参数: 在启动曝光前分配表项, 先于曝光状态到达的数据包也可接收
+		uint32_t delay;
+		{
+			mutex_lock lck(mtx_slot_);
+			arm_slot();
+			read_drops(dropbase_);
+			delay = pacedelay_;
+		}
 		// 设置曝光参数
-		uint32_t val;
+		uint32_t val, addr[3], vals[3];
+		int n(0);
 		if (shtrmode_ != (val = light ? 0 : 2)) {// 设置快门状态后必须等待一定时间
 			reg_write(0x0002000C, val);
 			boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-			reg_read(0x0002000C, shtrmode_);
 		}
 		if (expdur_ != (val = uint32_t(duration * 1E6))) {
-			reg_write(0x00020010, val);
-			reg_read(0x00020010, expdur_);
+			addr[n] = 0x00020010;
+			vals[n++] = val;
 		}
-		reg_write(0x00020000, 0x01);
-		cv_waitread_.notify_one();
+		if (pacewrt_ != delay) {// 调整后的包间延时
+			addr[n] = 0x0D08;
+			vals[n++] = delay;
+		}
+		addr[n] = 0x00020000;	// 启动曝光: 与曝光时间、包间延时在同一指令中依次写入
+		vals[n++] = 0x01;
+		reg_write(addr, vals, n);
+		pacewrt_ = delay;
+		// 回读快门与曝光时间: 在曝光启动后进行, 不增加启动时延
+		addr[0] = 0x0002000C;
+		addr[1] = 0x00020010;
+		reg_read(addr, vals, 2);
+		shtrmode_ = vals[0];
+		expdur_   = vals[1];
+		lock_frame();	// 曝光期间锁定, 不增加启动时延
 
 		return true;
 	}
@@ -206,13 +272,17 @@ bool CameraGY::stop_expose() {
 	CAMERA_STATUS &state = nfptr_->state;
 
 	if (state >= CAMERA_EXPOSE) {
+		{// 中止后到达的数据包不再写入帧存储区
+			mutex_lock lck(mtx_slot_);
+			retire_slot();
+		}
 		try {// 成功: 状态变为空闲
 			reg_write(0x20050, 0x1);
-			state = CAMERA_IDLE;
+			change_state(CAMERA_IDLE);
 		}
 		catch(std::runtime_error& ex) {// 失败: 状态变为错误
 			nfptr_->errmsg = ex.what();
-			state = CAMERA_ERROR;
+			change_state(CAMERA_ERROR);
 		}
 		cv_imgrdy_.notify_one();
 	}
@@ -223,11 +293,281 @@ CameraBase::CAMERA_STATUS CameraGY::camera_state() {
 	return nfptr_->state;
 }
 
-CameraBase::CAMERA_STATUS CameraGY::download_image() {
-	boost::mutex tmp;
-	mutex_lock lck(tmp);
-	cv_imgrdy_.wait(lck); // 等待图像就绪标志
+CameraBase::CAMERA_STATUS CameraGY::wait_for_completion() {
+	mutex_lock lck(mtx_expend_);
+	CAMERA_STATUS &state = nfptr_->state;
+
+	cv_waitread_.notify_one();	// 曝光状态已生效, 启动读出监测
+	while (state == CAMERA_EXPOSE) {
+		{// 数据包可能在曝光状态生效前到达
+			mutex_lock lcks(mtx_slot_);
+			if (cur_ >= 0 && slots_[cur_].block) state = CAMERA_IMGRDY;
+		}
+		if (state != CAMERA_EXPOSE) break;
+		cv_expend_.wait_for(lck, boost::chrono::milliseconds(progperiod_));
+		if (state == CAMERA_EXPOSE) notify_progress();
+	}
+	return state;
+}
+
+void CameraGY::change_state(CAMERA_STATUS state) {
+	mutex_lock lck(mtx_expend_);
+	nfptr_->state = state;
+	cv_expend_.notify_one();
+}
+
+void CameraGY::SetPacketSize(int bytes) {
+	packreq_ = bytes;
+}
+
+void CameraGY::SetRecvBuffer(int bytes) {
+	rcvbuf_ = bytes;
+}
+
+void CameraGY::SetStreamPolicy(int cpu, int priority, bool lockmem) {
+	stream_->SetSchedule(cpu, priority);
+	lockmem_ = lockmem;
+}
+
+void CameraGY::SetPacing(bool autopace, uint32_t delay, uint32_t maxdelay, uint32_t step, const string &path) {
+	paceauto_  = autopace;
+	pacemax_   = maxdelay > delay ? maxdelay : delay;
+	pacestep_  = step > 0 ? step : 1;
+	pacepath_  = path;
+	pacedelay_ = delay;
+	pacebest_  = delay;
+}
+
+void CameraGY::load_pacing() {
+	char ip[64];
+	unsigned int packet, delay;
+	FILE *fp;
+
+	paceclean_ = 0;
+	if (!paceauto_ || pacepath_.empty() || !(fp = fopen(pacepath_.c_str(), "r"))) return;
+	// 记录格式: 相机IP  数据包长度  GevSCPD
+	while (fscanf(fp, "%63s %u %u", ip, &packet, &delay) == 3) {
+		if (camIP_ == ip && int(packet) == packneg_) {
+			pacedelay_ = pacebest_ = delay < pacemax_ ? delay : pacemax_;
+			break;
+		}
+	}
+	fclose(fp);
+}
+
+void CameraGY::save_pacing() {
+	static boost::mutex mtx;	// 同一进程内的多台相机共用记录文件
+	mutex_lock lck(mtx);
+	std::vector<string> lines;
+	char line[256], ip[64];
+	unsigned int packet, delay;
+	FILE *fp;
+
+	if (pacepath_.empty()) return;
+	// 保留其它相机及其它数据包长度的记录, 替换本相机当前数据包长度的记录
+	if ((fp = fopen(pacepath_.c_str(), "r"))) {
+		while (fgets(line, sizeof(line), fp)) {
+			if (sscanf(line, "%63s %u %u", ip, &packet, &delay) == 3
+					&& camIP_ == ip && int(packet) == packneg_) continue;
+			lines.push_back(line);
+			if (lines.back().empty() || *lines.back().rbegin() != '\n') lines.back() += '\n';
+		}
+		fclose(fp);
+	}
+	// 先写入临时文件再改名, 避免中断时留下不完整的记录文件
+	string tmppath = (boost::format("%s.%d.tmp") % pacepath_ % getpid()).str();
+	if (!(fp = fopen(tmppath.c_str(), "w"))) {
+		_gLog.Write(LOG_WARN, NULL, "GY pacing file<%s> not created: %s", tmppath.c_str(), strerror(errno));
+		return;
+	}
+	for (size_t i = 0; i < lines.size(); ++i) fputs(lines[i].c_str(), fp);
+	fprintf(fp, "%s %d %u\n", camIP_.c_str(), packneg_, pacebest_);
+	if (fclose(fp) || rename(tmppath.c_str(), pacepath_.c_str())) {
+		_gLog.Write(LOG_WARN, NULL, "GY pacing file<%s> not written: %s", pacepath_.c_str(), strerror(errno));
+		remove(tmppath.c_str());
+	}
+}
+
+bool CameraGY::adjust_pacing(uint32_t lost, uint32_t packets) {
+	if (!paceauto_ || !packets) return false;
+	uint32_t best(pacebest_);
+
+	if (lost > packets * GY_PACE_TOLERANCE) {// 拥塞: 迅速增加
+		uint32_t delay = pacedelay_ + (pacedelay_ / 2 > pacestep_ ? pacedelay_ / 2 : pacestep_);
+		paceclean_ = 0;
+		if (delay > pacemax_) delay = pacemax_;
+		if (delay != pacedelay_) {
+			pacedelay_ = delay;
+			++paceup_;
+		}
+	}
+	else if (lost) paceclean_ = 0;	// 少量丢包: 保持
+	else if (++paceclean_ >= GY_PACE_CLEAN) {// 稳定: 记录并缓慢减少
+		paceclean_ = 0;
+		pacebest_  = pacedelay_;
+		if (pacedelay_) {
+			pacedelay_ = pacedelay_ > pacestep_ ? pacedelay_ - pacestep_ : 0;
+			++pacedown_;
+		}
+	}
+	return pacebest_ != best;
+}
+
+void CameraGY::lock_frame() {
+	uint8_t *data = nfptr_->data.get();
+	if (!lockmem_ || !data || data == locked_) return;
+	unlock_frame();
+	if (mlock(data, byteimg_)) {
+		_gLog.Write(LOG_WARN, NULL, "GY frame buffer not locked: %s. memory locking disabled", strerror(errno));
+		lockmem_ = false;
+	}
+	else {
+		locked_    = data;
+		lockbytes_ = byteimg_;
+	}
+}
+
+void CameraGY::unlock_frame() {
+	if (locked_) {
+		munlock(locked_, lockbytes_);
+		locked_ = NULL;
+	}
+}
+
+string CameraGY::get_hostif(uint32_t addr, int &mtu) {
+	ifaddrs *ifaddr, *ifa;
+	struct ifreq ifr;
+	string name;
+	int sock;
+
+	mtu = 0;
+	if (!getifaddrs(&ifaddr)) {
+		for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+			if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET) continue;
+			if (ntohl(((struct sockaddr_in*) ifa->ifa_addr)->sin_addr.s_addr) != addr) continue;
+			name = ifa->ifa_name;
+			if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) >= 0) {
+				memset(&ifr, 0, sizeof(ifr));
+				strncpy(ifr.ifr_name, ifa->ifa_name, IFNAMSIZ - 1);
+				if (!ioctl(sock, SIOCGIFMTU, &ifr)) mtu = ifr.ifr_mtu;
+				close(sock);
+			}
+			break;
+		}
+		freeifaddrs(ifaddr);
+	}
+	return name;
+}
+
+void CameraGY::read_drops(uint64_t drops[3]) {
+	const char *nicstat[] = { "rx_dropped", "rx_missed_errors", "rx_fifo_errors" };
+	char line[1024], path[128];
+	unsigned long long val;
+	FILE *fp;
+
+	drops[0] = stream_->GetMetrics().sockdrops;
+	drops[1] = drops[2] = 0;
+	if ((fp = fopen("/proc/net/snmp", "r"))) {// 首个"Udp:"行为字段名, 第二行为数值
+		char names[1024] = "";
+		while (fgets(line, sizeof(line), fp)) {
+			if (strncmp(line, "Udp:", 4)) continue;
+			if (!names[0]) { strcpy(names, line); continue; }
+			char *pn, *pv, *sn, *sv;
+			char *tn = strtok_r(names, " \n", &sn), *tv = strtok_r(line, " \n", &sv);
+			for (pn = tn, pv = tv; pn && pv; pn = strtok_r(NULL, " \n", &sn), pv = strtok_r(NULL, " \n", &sv)) {
+				if (!strcmp(pn, "RcvbufErrors")) drops[1] = strtoull(pv, NULL, 10);
+			}
+			break;
+		}
+		fclose(fp);
+	}
+	for (int i = 0; i < 3 && ifname_.size(); ++i) {
+		snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", ifname_.c_str(), nicstat[i]);
+		if ((fp = fopen(path, "r"))) {
+			if (fscanf(fp, "%llu", &val) == 1) drops[2] += val;
+			fclose(fp);
+		}
+	}
+}
 
+bool CameraGY::probe_packet(int bytes) {
+	mutex_lock lck(mtx_probe_);
+	probelen_ = 0;
+	probing_  = true;
+	try {// GevSCPS: bit31 - 发送测试包; bit30 - 不分片; bit15~0 - 数据包长度
+		boost::chrono::steady_clock::time_point tmend = boost::chrono::steady_clock::now()
+				+ boost::chrono::milliseconds(GY_PROBE_TIMEOUT);
+		reg_write(0x0D04, 0xC0000000 | uint32_t(bytes));
+		while (probelen_ < bytes && cv_probe_.wait_until(lck, tmend) == boost::cv_status::no_timeout);
+	}
+	catch(std::runtime_error &ex) {// 相机拒绝测试包请求
+	}
+	probing_ = false;
+	return probelen_ >= bytes;
+}
+
+int CameraGY::negotiate_packet(uint32_t addrHost) {
+	int hi = packreq_ > 0 ? packreq_ : GY_PACKET_MAX;
+	int lo = GY_PACKET_MIN, mtu, mid, bytes;
+	ifname_ = get_hostif(addrHost, mtu);
+
+	if (mtu > 0 && hi > mtu) hi = mtu;
+	if (hi > GY_PACKET_MAX) hi = GY_PACKET_MAX;
+	if (hi < lo) lo = hi;
+	if (packreq_ > 0 && hi == packreq_) bytes = hi;	// 指定长度: 不探测
+	else if (probe_packet(hi)) bytes = hi;
+	else if (lo == hi || !probe_packet(lo)) bytes = lo;
+	else {// 二分查找: lo可通过, hi不可通过
+		while (hi - lo > 64) {
+			mid = ((lo + hi) / 2) & ~3;
+			if (probe_packet(mid)) lo = mid;
+			else hi = mid;
+		}
+		bytes = lo;
+	}
+	reg_write(0x0D04, uint32_t(bytes));
+	// 按协商结果重新分配接收存储区
+	stream_->Stop();
+	stream_->SetMaxPacket(bytes - 28);
+	if (!stream_->Start())
+		throw runtime_error(string("failed to restart stream channel: ") + stream_->GetError());
+	return bytes;
+}
+
+CameraBase::CAMERA_STATUS CameraGY::download_image() {
+	mutex_lock lck(mtx_slot_);
+	// 等待当前帧接收完成、中止或超时. 以周期检查代替单次等待, 避免错过通知
+	while (nfptr_->state == CAMERA_IMGRDY && cur_ >= 0 && slots_[cur_].bytes < byteimg_)
+		cv_imgrdy_.wait_for(lck, boost::chrono::milliseconds(100));
+	unlock_frame();
+	if (cur_ < 0) return nfptr_->state;
+
+	FrameTransfer &xfer = slots_[cur_].xfer;
+	bool saving(false);
+	uint64_t drops[3];
+	read_drops(drops);
+	xfer.bytes    = slots_[cur_].bytes;
+	xfer.sockdrop = uint32_t(drops[0] - dropbase_[0]);
+	xfer.udpdrop  = uint32_t(drops[1] - dropbase_[1]);
+	xfer.nicdrop  = uint32_t(drops[2] - dropbase_[2]);
+	if (frmfill_.use_count()) frmfill_->transfer = xfer;
+	if (nfptr_->state == CAMERA_IMGRDY) {
+		++frmxfer_;
+		if (xfer.lost) ++frmlossy_;
+		xfersum_.packets   += xfer.packets;
+		xfersum_.lost      += xfer.lost;
+		xfersum_.recovered += xfer.recovered;
+		xfersum_.resent    += xfer.resent;
+		xfersum_.requests  += xfer.requests;
+		xfersum_.rounds    += xfer.rounds;
+		xfersum_.sockdrop  += xfer.sockdrop;
+		xfersum_.udpdrop   += xfer.udpdrop;
+		xfersum_.nicdrop   += xfer.nicdrop;
+		saving = adjust_pacing(xfer.lost, xfer.packets);
+	}
+	retire_slot();
+	lck.unlock();
+	if (saving) save_pacing();
 	return nfptr_->state;
 }
 
@@ -250,99 +590,229 @@ uint32_t CameraGY::get_hostaddr() {
 	return found ? ntohl(addr) : 0;
 }
 
-uint16_t CameraGY::msg_count() {
-	if (++msgcnt_ == 0) msgcnt_ = 1;
-	return msgcnt_;
+void CameraGY::reg_write(uint32_t addr, uint32_t val) {
+	reg_write(&addr, &val, 1);
 }
 
-void CameraGY::reg_write(uint32_t addr, uint32_t val) {
-	mutex_lock lck(mtx_reg_);
-	boost::array<uint8_t, 16> towrite = {0x42, 0x01, 0x00, 0x82, 0x00, 0x08};
-	const uint8_t *rcvd;
-	int n;
+void CameraGY::reg_read(uint32_t addr, uint32_t &val) {
+	reg_read(&addr, &val, 1);
+}
+
+void CameraGY::reg_write(const uint32_t *addr, const uint32_t *val, int n) {
+	if (!gvcp_->WriteRegs(addr, val, n)) throw runtime_error(gvcp_->GetError());
+}
 
-	((uint16_t*) &towrite)[3] = htons(msg_count());
-	((uint32_t*) &towrite)[2] = htonl(addr);
-	((uint32_t*) &towrite)[3] = htonl(val);
-	udpcmd_->Write(towrite.c_array(), towrite.size());
-	rcvd = (const uint8_t *) udpcmd_->BlockRead(n);
+void CameraGY::reg_read(const uint32_t *addr, uint32_t *val, int n) {
+	if (!gvcp_->ReadRegs(addr, val, n)) throw runtime_error(gvcp_->GetError());
+}
+
+void CameraGY::receive_packets(GVSPPacket *pcks, int n) {
+	if (probing_) {// 测试包: 记录长度
+		mutex_lock lck(mtx_probe_);
+		for (int i = 0; i < n; ++i) {
+			if (pcks[i].length + GVSP_HEADER_SIZE + 28 > probelen_)
+				probelen_ = pcks[i].length + GVSP_HEADER_SIZE + 28;
+		}
+		cv_probe_.notify_one();
+		return;
+	}
 
-	if (n != 12 || rcvd[11] != 0x01) {
-		char txt[200];
-		int i;
-		int n1 = sprintf(txt, "length<%d> of write register<%0X>: ", n, addr);
-		for (i = 0; i < n; ++i) n1 += sprintf(txt + n1, "%02X ", rcvd[i]);
-		throw runtime_error(txt);
+	bool started(false), trailer(false), complete(false);
+	steady_time now = boost::chrono::steady_clock::now();
+	mutex_lock lck(mtx_slot_);
+	for (int i = 0; i < n; ++i) {
+		GVSPPacket &pck = pcks[i];
+		uint32_t idPck = pck.id;
+		FrameSlot *slot = find_slot(pck);	// 仅返回当前帧: 迟到与无对应帧的数据包被丢弃
+
+		if (!slot) continue;
+		started = true;
+		slot->tmlast = now;
+		if (slot->bytes >= byteimg_) continue;
+		if (pck.format == idLeader_) {// 引导帧
+			slot->idPack = idPck;
+		}
+		else if (pck.format == idPayload_) {// 图像数据包
+			if (idPck >= 1 && idPck <= packcnt_ && !slot->flags[idPck]) {// 避免重复接收
+				uint32_t pcksize = pck.length;
+				uint8_t *buf = slot->data + (idPck - 1) * packsize_;
+				// 缓存图像数据
+				if (idPck == packcnt_) pcksize -= 64;	// 最后一包多出64字节校验信息
+				if (pcksize > byteimg_ - (idPck - 1) * packsize_) pcksize = byteimg_ - (idPck - 1) * packsize_;
+				slot->flags[idPck] = 1;
+				if (pck.payload != buf) {// 预测失败, 或帧切换时写入了上一帧的存储区: 复制
+					uint32_t head = uint32_t(pck.head) < pcksize ? pck.head : pcksize;
+					memcpy(buf, pck.payload, head);
+					if (head < pcksize) memcpy(buf + head, pck.rest, pcksize - head);
+				}
+				slot->bytes += pcksize;
+				slot->idPack = idPck;
+				record_packet(*slot, idPck);
+				if (slot->bytes == byteimg_) complete = true;
+			}
+		}
+		else if (pck.format == idTrailer_) {// 收到尾帧时图像数据接收不完整
+			slot->idPack = idPck;
+			trailer = true;
+		}
 	}
+	lck.unlock();
+	if (!started) return;
+
+	// 更新时间戳: 每批次一次
+	tmdata_ = microsec_clock::universal_time().time_of_day().total_milliseconds();
+	if (nfptr_->state == CAMERA_EXPOSE) change_state(CAMERA_IMGRDY);
+	if (complete) cv_imgrdy_.notify_one();
+	else if (trailer) re_transmit();
 }
 
-void CameraGY::reg_read(uint32_t addr, uint32_t &val) {
-	mutex_lock lck(mtx_reg_);
-	boost::array<uint8_t, 12> towrite = {0x42, 0x01, 0x00, 0x80, 0x00, 0x04};
-	const uint8_t *rcvd;
-	int n;
-
-	((uint16_t*) &towrite)[3] = htons(msg_count());
-	((uint32_t*) &towrite)[2] = htonl(addr);
-	udpcmd_->Write(towrite.c_array(), towrite.size());
-	rcvd = (const uint8_t *) udpcmd_->BlockRead(n);
-	if (n == 12) val = ntohl(((uint32_t*)rcvd)[2]);
-	else {
-		char txt[200];
-		int n1 = sprintf(txt, "length<%d> of read register<%0X>: ", n, addr);
-		for (int i = 0; i < n; ++i) n1 += sprintf(txt + n1, "%02X ", rcvd[i]);
-		throw runtime_error(txt);
+void CameraGY::arm_slot() {
+	int i, k(-1);
+
+	retire_slot();	// 上一帧未经读出即结束, 如启动曝光失败
+	for (i = 0; i < GY_FRAME_SLOTS; ++i) {// 选择空闲或最早退役的表项
+		if (!slots_[i].block) {
+			k = i;
+			break;
+		}
+		if (k < 0 || slots_[i].tmlast < slots_[k].tmlast) k = i;
 	}
+
+	FrameSlot &slot = slots_[k];
+	slot.block     = 0;
+	slot.data      = nfptr_->data.get();
+	slot.flags.assign(packcnt_ + 1, 0);
+	slot.bytes     = 0;
+	slot.idPack    = uint32_t(-1);
+	slot.idMax     = 0;
+	slot.holes.clear();
+	slot.xfer.Reset();
+	slot.xfer.packets = packcnt_;
+	slot.xfer.delay   = pacedelay_;
+	slot.rcdresend = 0;
+	slot.backoff   = GY_BACKOFF_MIN;
+	slot.tmresend  = steady_time();
+	slot.tmlast    = boost::chrono::steady_clock::now();
+	cur_ = k;
 }
 
-void CameraGY::receive_data(const long udp, const long len) {
-	CAMERA_STATUS &state = nfptr_->state;
-	if (bytercd_ == byteimg_ || state < CAMERA_EXPOSE) return;
-	if (state == CAMERA_EXPOSE) state = CAMERA_IMGRDY;
-	// 更新时间戳
-	tmdata_ = microsec_clock::universal_time().time_of_day().total_milliseconds();
+void CameraGY::retire_slot() {
+	if (cur_ >= 0) {
+		slots_[cur_].data   = NULL;
+		slots_[cur_].tmlast = boost::chrono::steady_clock::now();
+		cur_ = -1;
+	}
+}
 
-	int n;
-	const uint8_t *pack = (const uint8_t *) udpdata_->Read(n);
-	uint16_t idFrm = (pack[2] << 8) | pack[3];
-	uint8_t  type  = pack[4];
-	uint16_t idPck = (pack[5] << 16) | (pack[6] << 8) | pack[7];
-
-	if (type == idLeader_) {// 引导帧
-		idFrame_ = idFrm;
-		idPack_  = idPck;
-	}
-	else if (type == idPayload_) {// 图像数据包
-		if (!packflag_[idPck]) {// 避免重复接收
-			uint32_t pcksize = len - headsize_; // UDP包长度已减去IP+UDP包头
-			uint8_t *buf = nfptr_->data.get() + (idPck - 1) * packsize_;
-			// 缓存图像数据
-			if (idPck == packcnt_) pcksize -= 64;
-			packflag_[idPck] = 1;
-			memcpy(buf, pack + headsize_, pcksize);
-			bytercd_ += pcksize;
-
-			if (bytercd_ == byteimg_) cv_imgrdy_.notify_one();
-			else {
-				if (idFrame_ == 0xFFFF) idFrame_ = idFrm;
-				idPack_ = idPck;
-			}
+CameraGY::FrameSlot *CameraGY::find_slot(const GVSPPacket &pck) {
+	namespace bc = boost::chrono;
+	uint16_t block = pck.block;
+	if (cur_ >= 0 && slots_[cur_].block == block && block) return &slots_[cur_];
+
+	bool unbound = cur_ >= 0 && !slots_[cur_].block;
+	bc::milliseconds timeout(GY_SLOT_TIMEOUT);
+	int i;
+
+	if (!block) {// 编号0仅用于测试包
+		++pckstray_;
+		return NULL;
+	}
+	for (i = 0; i < GY_FRAME_SLOTS; ++i) {// 退役的帧
+		FrameSlot &slot = slots_[i];
+		if (slot.block != block) continue;
+		if (unbound && bc::steady_clock::now() - slot.tmlast > timeout) {
+			slot.block = 0;	// 退役已久, 编号已被相机复用
+			break;
 		}
+		if (pck.format == idPayload_) ++pcklate_;	// 完成后到达的结尾包不计入
+		return NULL;
 	}
-	else if (type == idTrailer_) {// 收到尾帧时图像数据接收不完整
-		idPack_ = idPck;
-		re_transmit();
+	if (unbound) {// 绑定当前帧: 编号须新于近期退役的帧, 避免更早的迟到数据包占用当前帧
+		bc::steady_clock::time_point now = bc::steady_clock::now();
+		for (i = 0; i < GY_FRAME_SLOTS; ++i) {
+			FrameSlot &slot = slots_[i];
+			if (slot.block && int16_t(block - slot.block) < 0 && now - slot.tmlast <= timeout) break;
+		}
+		if (i == GY_FRAME_SLOTS) {
+			slots_[cur_].block = block;
+			return &slots_[cur_];
+		}
+	}
+	++pckstray_;
+	return NULL;
+}
+
+void CameraGY::record_packet(FrameSlot &slot, uint32_t idPck) {
+	if (idPck > slot.idMax) {
+		if (idPck > slot.idMax + 1) {// 出现新的缺失区间
+			slot.holes[slot.idMax + 1] = idPck - 1;
+			slot.xfer.lost += idPck - slot.idMax - 1;
+		}
+		slot.idMax = idPck;
+	}
+	else {// 重传或乱序到达: 拆分所在区间
+		HoleMap::iterator it = slot.holes.upper_bound(idPck);
+		if (it == slot.holes.begin() || (--it)->second < idPck) return;
+		uint32_t first(it->first), last(it->second);
+		slot.holes.erase(it);
+		if (first < idPck) slot.holes[first] = idPck - 1;
+		if (idPck < last)  slot.holes[idPck + 1] = last;
+		++slot.xfer.recovered;
 	}
 }
 
-void CameraGY::re_transmit(uint32_t iPack0, uint32_t iPack1) {
-	mutex_lock lck(mtx_reg_);
-	boost::array<uint8_t, 20> towrite = {0x42, 0x00, 0x00, 0x40, 0x00, 0x0c};
-	((uint16_t*)&towrite)[3] = htons(msg_count());
-	((uint32_t*)&towrite)[2] = htonl(idFrame_);
-	((uint32_t*)&towrite)[3] = htonl(iPack0);
-	((uint32_t*)&towrite)[4] = htonl(iPack1);
-	udpcmd_->Write(towrite.c_array(), towrite.size());
+int CameraGY::place_packets(GVSPTarget *tgt, int n) {
+	/*
+	 * 按编号顺序预测: 自最近接收的数据包之后, 依次选取尚未接收的数据包.
+	 * 帧切换时iovec可能仍指向上一帧的存储区, 但其写入位置尚未接收数据,
+	 * 且最迟在SO_RCVTIMEO(100毫秒)后重新预测.
+	 * 接收时按实际写入地址核对: 写入地址不是所属帧的对应位置时复制, 不依赖编号命中
+	 */
+	if (probing_) return 0;
+	mutex_lock lck(mtx_slot_);
+	if (cur_ < 0 || slots_[cur_].bytes >= byteimg_) return 0;
+	FrameSlot &slot = slots_[cur_];
+	uint8_t *data = slot.data;
+	uint32_t id = slot.idPack + 1, offset;
+	int i;
+
+	if (id < 1 || id > packcnt_) id = 1;
+	for (i = 0; i < n && id <= packcnt_; ++id) {
+		if (slot.flags[id]) continue;
+		offset = (id - 1) * packsize_;
+		tgt[i].id     = id;
+		tgt[i].dst    = data + offset;
+		tgt[i].length = byteimg_ - offset < packsize_ ? byteimg_ - offset : packsize_;
+		++i;
+	}
+	return i;
+}
+
+string CameraGY::TransportSummary() {
+	mutex_lock lck(mtx_slot_);
+	boost::format fmt("\t packet   : %d bytes, payload = %u bytes%s\n"
+			"\t drops    : socket = %u, UDP rcvbuf = %u, NIC(%s) = %u\n"
+			"\t resend   : frames = %u (lossy = %u), lost = %u, recovered = %u, "
+			"requested = %u packets in %u requests / %u rounds\n"
+			"\t frames   : timed out = %u, late packets = %llu, stray packets = %llu\n"
+			"\t pacing   : GevSCPD = %u (best = %u, max = %u)%s, raised = %u, lowered = %u\n");
+	fmt % packneg_ % packsize_ % (packreq_ > 0 ? "" : " (probed)")
+		% xfersum_.sockdrop % xfersum_.udpdrop % ifname_ % xfersum_.nicdrop
+		% frmxfer_ % frmlossy_ % xfersum_.lost % xfersum_.recovered
+		% xfersum_.resent % xfersum_.requests % xfersum_.rounds
+		% frmtmo_ % pcklate_ % pckstray_
+		% pacedelay_ % pacebest_ % pacemax_ % (paceauto_ ? "" : " (fixed)") % paceup_ % pacedown_;
+	GVCPMetrics gvcp = gvcp_->GetMetrics();
+	boost::format fmtc("\t control  : requests = %llu, retries = %llu, timeouts = %llu, stale = %llu, "
+			"max pending = %u, rtt = %.2f ms (max = %.2f)\n");
+	fmtc % gvcp.requests % gvcp.retries % gvcp.timeouts % gvcp.stale % gvcp.maxpend
+		% (gvcp.requests ? gvcp.rtt / gvcp.requests : 0.0) % gvcp.rttmax;
+	return stream_->Summary() + fmt.str() + fmtc.str();
+}
+
+void CameraGY::re_transmit(uint16_t block, uint32_t iPack0, uint32_t iPack1) {
+	uint32_t payload[] = { htonl(block), htonl(iPack0), htonl(iPack1) };
+	gvcp_->Send(GVCP_PACKETRESEND_CMD, payload, sizeof(payload));
 }
 
 bool CameraGY::update_network(const uint32_t addr, const char *vstr) {
@@ -364,13 +834,74 @@ bool CameraGY::update_network(const uint32_t addr, const char *vstr) {
 }
 
 void CameraGY::re_transmit() {
-	uint32_t i, ipck0, ipck1;
-
-	for (i = 1; i <= packcnt_ && packflag_[i]; ++i);
-	ipck0 = i;
-	for (; i <= packcnt_ && !packflag_[i]; ++i);
-	ipck1 = i - 1;
-	re_transmit(ipck0, ipck1);
+	typedef std::pair<uint32_t, uint32_t> range;
+	namespace bc = boost::chrono;
+	std::vector<range> ranges;
+	uint32_t packets(0), first, last, bytes(0);
+	uint16_t block(0);
+	bool timeout(false);
+	bc::steady_clock::time_point now = bc::steady_clock::now();
+
+	{// 合并缺失区间. idMax之后尚未到达的数据包作为最后一个区间
+		mutex_lock lck(mtx_slot_);
+		if (cur_ < 0 || !slots_[cur_].block || slots_[cur_].bytes >= byteimg_) return;
+		FrameSlot &slot = slots_[cur_];
+		block = slot.block;
+		if (now - slot.tmlast > bc::milliseconds(GY_SLOT_TIMEOUT)) {// 放弃该帧
+			bytes   = slot.bytes;
+			timeout = true;
+			++frmtmo_;
+			adjust_pacing(slot.xfer.packets, slot.xfer.packets);
+		}
+		else {
+			if (now < slot.tmresend) return;
+			HoleMap::iterator it = slot.holes.begin();
+			bool tail(slot.idMax < packcnt_);
+
+			while ((it != slot.holes.end() || tail) && packets < GY_RESEND_PACKETS) {
+				if (it != slot.holes.end()) {
+					first = it->first;
+					last  = it->second;
+					++it;
+				}
+				else {
+					first = slot.idMax + 1;
+					last  = packcnt_;
+					tail  = false;
+				}
+				if (last - first + 1 > GY_RESEND_PACKETS - packets) last = first + GY_RESEND_PACKETS - packets - 1;
+				if (ranges.size() && first - ranges.back().second <= GY_RESEND_GAP + 1) {
+					packets += last - ranges.back().second;
+					ranges.back().second = last;
+				}
+				else if (ranges.size() < GY_RESEND_RANGES) {
+					packets += last - first + 1;
+					ranges.push_back(range(first, last));
+				}
+				else break;
+			}
+			if (ranges.empty()) return;
+			// 退避: 上一轮之后未收到新数据时加倍间隔
+			if (slot.rcdresend == slot.bytes && slot.xfer.rounds)
+				slot.backoff = slot.backoff * 2 > GY_BACKOFF_MAX ? GY_BACKOFF_MAX : slot.backoff * 2;
+			else slot.backoff = GY_BACKOFF_MIN;
+			slot.rcdresend = slot.bytes;
+			slot.tmresend  = now + bc::milliseconds(slot.backoff);
+			++slot.xfer.rounds;
+			slot.xfer.requests += ranges.size();
+			slot.xfer.resent   += packets;
+		}
+	}
+	if (timeout) {// 读出流程以空闲状态结束, 序列曝光继续
+		nfptr_->errmsg = (boost::format("frame<%u> timed out, %u of %u bytes received")
+				% block % bytes % byteimg_).str();
+		_gLog.Write(LOG_WARN, NULL, "GY %s", nfptr_->errmsg.c_str());
+		change_state(CAMERA_IDLE);
+		cv_imgrdy_.notify_one();
+		return;
+	}
+	for (std::vector<range>::iterator it = ranges.begin(); it != ranges.end(); ++it)
+		re_transmit(block, it->first, it->second);
 }
 
 void CameraGY::thread_heartbeat() {
@@ -425,7 +956,7 @@ void CameraGY::thread_readout() {
 				td = microsec_clock::universal_time() - tmobs;
 				if ((td.total_seconds() - expdur) > limit_exp) {
 					nfptr_->errmsg = "long time no data respond";
-					state = CAMERA_ERROR;
+					change_state(CAMERA_ERROR);
 				}
 			}
 		}
@@ -32,11 +32,30 @@
 #define SRC_CAMERAGY_H_
 
 #include "CameraBase.h"
-#include "udpasio.h"
+#include "GVCPClient.h"
+#include "GVSPStream.h"
+#include <map>
+
+#define GY_RESEND_GAP		4		//< 间隔不超过该数量的缺失区间合并为一个重传请求
+#define GY_RESEND_RANGES	16		//< 单轮最多重传请求数量
+#define GY_RESEND_PACKETS	4096	//< 单轮最多申请重传的数据包数量
+#define GY_BACKOFF_MIN		10		//< 重传轮次最小间隔, 量纲: 毫秒
+#define GY_BACKOFF_MAX		320		//< 重传轮次最大间隔, 量纲: 毫秒
+#define GY_PACKET_MIN		1500	//< 数据包最小长度(GevSCPS), 含IP与UDP包头. 标准以太网帧
+#define GY_PACKET_MAX		9000	//< 数据包最大长度(GevSCPS), 含IP与UDP包头. 巨型帧
+#define GY_PROBE_TIMEOUT	200		//< 测试包等待时间, 量纲: 毫秒
+#define GY_FRAME_SLOTS		4		//< 重组表容量: 当前帧及最近退役的帧
+#define GY_SLOT_TIMEOUT		5000	//< 当前帧无数据超时, 量纲: 毫秒. 超时后放弃该帧
+#define GY_PACE_CLEAN		8		//< 连续无丢包帧数达到该值时降低包间延时
+#define GY_PACE_TOLERANCE	0.001	//< 可容忍的单帧丢包率. 超出时增加包间延时
 
 class CameraGY: public CameraBase {
 public:
-	CameraGY(string const camIP);
+	/*!
+	 * @param camIP 相机IP地址
+	 * @param exec  控制通道执行器. 空指针表示共享执行器; 独立执行器使重传请求不受其它连接影响
+	 */
+	CameraGY(string const camIP, const IOExecPtr &exec = IOExecPtr());
 	virtual ~CameraGY();
 
 protected:
@@ -48,8 +67,6 @@ protected:
 	const uint8_t  idPayload_;	//< 数据包标志: 数据
 	const uint32_t headsize_;	//< GWAC相机出厂定义数据包头长度
 
-	boost::mutex mtx_reg_;	//< 互斥锁: 寄存器
-
 	string camIP_;		//< 相机IP地址
 	uint32_t expdur_;	//< 曝光时间, 量纲: 微秒
 	uint32_t shtrmode_;	//< 快门模式. 0: Normal; 1: AlwaysOpen; 2: AlwaysClose
@@ -57,10 +74,12 @@ protected:
 
 	/* 定义: 图像数据包 */
 	boost::condition_variable cv_imgrdy_;	//< 事件: 完成图像据读出
+	boost::condition_variable cv_expend_;	//< 事件: 曝光结束, 开始接收图像数据
+	boost::mutex mtx_expend_;	//< 互斥锁: 曝光结束
 	int64_t		tmdata_;	//< 时间戳: 接收图形数据包
 	/*！
 	 * 图像数据包定义1(相机发送数据包):
-	 * - 相机通过UDP连接(udpdata_)将数字化的图像数据发送给控制机
+	 * - 相机通过UDP连接(stream_)将数字化的图像数据发送给控制机
 	 * - 图像数据有效长度为byteimg_, 即width*height*2
 	 * - 图像数据被分为多个数据包, 每个数据包由包头和包数据组成
 	 * - 数据包头包含: 20字节IP头+8字节UDP头+headsize_(==8, 自定义)字节头
@@ -72,17 +91,81 @@ protected:
 	 * - 每个数据包包含包头和包数据, 包头4字节、记录包数据长度
 	 */
 	uint32_t	byteimg_;	//< 图像数据长度, 量纲: 字节
-	uint32_t	bytercd_;	//< 已接收图像数据长度, 量纲: 字节
 	uint32_t	packcnt_;	//< 图像数据包数量, 对应图像数据长度
 	uint32_t	packsize_;	//< 单个数据包长度, 量纲: 字节
-	uint16_t	idFrame_;	//< 图像帧编号
-	uint32_t	idPack_;	//< 数据包编号, 起始位置: 1
-	boost::shared_array<uint8_t> packflag_;	//< 数据包接收标志
+	int			packreq_;	//< 配置的数据包长度(GevSCPS), 量纲: 字节. 0: 自动探测
+	int			packneg_;	//< 协商结果, 量纲: 字节
+	int			rcvbuf_;	//< 配置的内核接收缓冲区容量, 量纲: 字节. 0: 系统默认
+	string		ifname_;	//< 接收图像数据的本机网卡
+	/*!
+	 * 丢包计数基准: 曝光开始时的累计值, 帧结束时取差值.
+	 * 依次为套接字溢出、系统UDP接收缓冲区错误、网卡丢弃
+	 */
+	uint64_t	dropbase_[3];
+	bool		lockmem_;	//< 采集期间锁定帧存储区, 避免换页
+	uint8_t		*locked_;	//< 已锁定的帧存储区
+	uint32_t	lockbytes_;	//< 已锁定的长度, 量纲: 字节
+	bool		probing_;	//< 正在探测数据包长度
+	int			probelen_;	//< 探测期间收到的最大数据包长度, 含IP与UDP包头
+	boost::mutex mtx_probe_;	//< 互斥锁: 探测
+	boost::condition_variable cv_probe_;	//< 事件: 收到测试包
+	/*!
+	 * 缺失区间: 收到编号大于idMax+1的数据包时记录其间的缺失区间,
+	 * 收到重传数据包时拆分所在区间. idMax之后的编号视为尚未到达
+	 */
+	typedef std::map<uint32_t, uint32_t> HoleMap;	//< 缺失区间: 起始编号-截止编号
+	typedef boost::chrono::steady_clock::time_point steady_time;
+	/*!
+	 * @struct FrameSlot 重组表表项: 接收一个GVSP数据块(图像帧)
+	 * @note
+	 * - 曝光启动前为当前帧分配表项, 首个不属于其它表项的数据包绑定数据块编号
+	 * - 仅当前帧关联帧存储区. 完成、中止或超时后表项退役: 解除帧存储区,
+	 *   保留数据块编号与接收标志, 其后到达的重传或重复数据包被识别并丢弃
+	 * - 退役表项在分配新表项时按退役先后复用
+	 */
+	struct FrameSlot {
+		uint16_t block;		//< 数据块编号. 0: 尚未绑定(GVSP保留编号)
+		uint8_t *data;		//< 帧存储区. NULL: 已退役
+		std::vector<uint8_t> flags;	//< 数据包接收标志, 下标为数据包编号
+		uint32_t bytes;		//< 已接收图像数据长度, 量纲: 字节
+		uint32_t idPack;	//< 最近接收的数据包编号
+		uint32_t idMax;		//< 已接收数据包的最大编号
+		HoleMap holes;		//< 缺失区间
+		FrameTransfer xfer;	//< 传输统计
+		uint32_t rcdresend;	//< 上一轮重传时的已接收数据长度
+		int backoff;		//< 重传轮次间隔, 量纲: 毫秒
+		steady_time tmresend;	//< 允许下一轮重传的时间
+		steady_time tmlast;	//< 最近一次收到数据包的时间; 退役后为退役时间
+	};
+	FrameSlot slots_[GY_FRAME_SLOTS];	//< 重组表
+	int cur_;				//< 当前帧对应的表项. <0: 无
+	boost::mutex mtx_slot_;	//< 互斥锁: 重组表与传输统计
+	FrameTransfer xfersum_;	//< 累计传输统计
+	uint32_t frmxfer_;		//< 累计帧数
+	uint32_t frmlossy_;		//< 存在丢包的帧数
+	uint32_t frmtmo_;		//< 超时放弃的帧数
+	uint64_t pcklate_;		//< 已退役帧的迟到图像数据包数量
+	uint64_t pckstray_;		//< 无对应表项的数据包数量
+	/*!
+	 * 自适应包间延时(GevSCPD, 量纲: 相机时间戳计数):
+	 * 单帧丢包率超过GY_PACE_TOLERANCE时按1.5倍(至少一个步长)增加;
+	 * 连续GY_PACE_CLEAN帧无丢包时记为最佳值并减少一个步长, 以探测更高的吞吐量.
+	 * 最佳值按相机IP与数据包长度保存, 下次连接时作为初值
+	 */
+	bool		paceauto_;	//< 自动调整GevSCPD
+	uint32_t	pacemax_;	//< GevSCPD上限
+	uint32_t	pacestep_;	//< GevSCPD调整步长
+	string		pacepath_;	//< 最佳GevSCPD保存文件. 空字符串: 不保存
+	uint32_t	pacedelay_;	//< 当前GevSCPD
+	uint32_t	pacewrt_;	//< 已写入相机的GevSCPD
+	uint32_t	pacebest_;	//< 最近一次连续无丢包时的GevSCPD
+	int			paceclean_;	//< 连续无丢包的帧数
+	uint32_t	paceup_;	//< 增加次数
+	uint32_t	pacedown_;	//< 减少次数
 
 	/* 定义: 控制指令 */
-	uint16_t msgcnt_;	//< 指令帧序列号
-	UdpPtr udpcmd_;		//< UDP连接: 控制指令
-	UdpPtr udpdata_;	//< UDP连接: 数据
+	GVCPClientPtr gvcp_;	//< 控制通道: 按序列号匹配应答, 允许并发请求
+	GVSPStreamPtr stream_;	//< 图像数据流: 批量接收数据包
 
 	/* 线程 */
 	threadptr thrdhb_;		//< 线程: 心跳机制
@@ -172,9 +255,60 @@ protected:
 	 * - CAMERA_ERROR:  相机错误
 	 */
 	CAMERA_STATUS download_image();
+	/*!
+	 * @brief 等待曝光结束
+	 * @note
+	 * 收到首个图像数据包、中止曝光或出错时唤醒
+	 */
+	CAMERA_STATUS wait_for_completion();
+
+public:
+	/*!
+	 * @brief 生成图像数据流接收统计的文本
+	 */
+	string TransportSummary();
+	/*!
+	 * @brief 设置图像数据包长度
+	 * @param bytes 数据包长度(GevSCPS), 含IP与UDP包头. 0: 在[GY_PACKET_MIN, GY_PACKET_MAX]内自动探测
+	 * @note
+	 * 在Connect()之前调用. 超出本机网卡MTU的长度被截断
+	 */
+	void SetPacketSize(int bytes);
+	/*!
+	 * @brief 设置图像数据套接字的内核接收缓冲区容量
+	 * @param bytes 容量, 量纲: 字节. 0: 系统默认
+	 * @note
+	 * 在Connect()之前调用
+	 */
+	void SetRecvBuffer(int bytes);
+	/*!
+	 * @brief 设置图像数据接收线程的调度策略与内存锁定
+	 * @param cpu      绑定的CPU编号. <0: 不绑定
+	 * @param priority SCHED_FIFO优先级, [1, 99]. 0: 默认调度
+	 * @param lockmem  采集期间是否以mlock()锁定帧存储区
+	 * @note
+	 * 在Connect()之前调用. 策略无法生效时记录警告, 不影响采集
+	 */
+	void SetStreamPolicy(int cpu, int priority, bool lockmem);
+	/*!
+	 * @brief 设置包间延时(GevSCPD)
+	 * @param autopace 是否按丢包自动调整
+	 * @param delay    初值; 不自动调整时为固定值. 量纲: 相机时间戳计数
+	 * @param maxdelay 自动调整的上限
+	 * @param step     自动调整的步长
+	 * @param path     最佳值保存文件. 存在与当前相机及数据包长度匹配的记录时, 以其替代初值
+	 * @note
+	 * 在Connect()之前调用
+	 */
+	void SetPacing(bool autopace, uint32_t delay, uint32_t maxdelay, uint32_t step, const string &path);
 
 protected:
 	// 成员函数
+	/*!
+	 * @brief 改变曝光状态并唤醒wait_for_completion()
+	 * @param state 新的工作状态
+	 */
+	void change_state(CAMERA_STATUS state);
 	/*!
 	 * @brief 查看与相机IP在同一网段的本机IP地址
 	 * @return
@@ -184,13 +318,69 @@ protected:
 	 */
 	uint32_t get_hostaddr();
 	/*!
-	 * @brief 计算帧头序号
+	 * @brief 查看本机地址所属网卡
+	 * @param addr 主机字节排序方式的本机地址
+	 * @param mtu  网卡MTU. 0表示无效
+	 * @return
+	 * 网卡名称. 空字符串表示无效
+	 */
+	string get_hostif(uint32_t addr, int &mtu);
+	/*!
+	 * @brief 读取丢包累计计数
+	 * @param drops 依次为套接字溢出、系统UDP接收缓冲区错误、网卡丢弃
+	 * @note
+	 * 网卡计数来自/sys/class/net/<ifname_>/statistics, UDP计数来自/proc/net/snmp
+	 */
+	void read_drops(uint64_t drops[3]);
+	/*!
+	 * @brief 锁定当前帧存储区
+	 * @note
+	 * 首次失败(如超出RLIMIT_MEMLOCK)时记录警告并停用锁定
+	 */
+	void lock_frame();
+	/*!
+	 * @brief 解除帧存储区锁定
+	 */
+	void unlock_frame();
+	/*!
+	 * @brief 读取保存的最佳包间延时
+	 * @note
+	 * 在数据包长度协商后调用
+	 */
+	void load_pacing();
+	/*!
+	 * @brief 保存最佳包间延时
+	 * @note
+	 * 只替换本相机当前数据包长度的记录, 经临时文件改名写入
+	 */
+	void save_pacing();
+	/*!
+	 * @brief 按单帧丢包调整包间延时
+	 * @param lost    丢失的数据包数量
+	 * @param packets 数据包总数
 	 * @return
-	 * 帧序号
+	 * 最佳值是否改变
 	 * @note
-	 * 帧序号有效区间:[1, 65535], 逐一增加
+	 * 调用者持有mtx_slot_. 新值在下一次启动曝光时写入相机
 	 */
-	uint16_t msg_count();
+	bool adjust_pacing(uint32_t lost, uint32_t packets);
+	/*!
+	 * @brief 请求相机以不分片方式发送测试包
+	 * @param bytes 测试包长度, 含IP与UDP包头
+	 * @return
+	 * 是否收到完整测试包
+	 */
+	bool probe_packet(int bytes);
+	/*!
+	 * @brief 协商数据包长度并写入GevSCPS
+	 * @param addrHost 主机字节排序方式的本机地址
+	 * @return
+	 * 数据包长度, 含IP与UDP包头
+	 * @note
+	 * 先测试上限; 失败时确认相机支持测试包, 再二分查找可通过的最大长度.
+	 * 相机不支持测试包时采用GY_PACKET_MIN
+	 */
+	int negotiate_packet(uint32_t addrHost);
 	/*!
 	 * @brief 更改寄存器对应地址数值
 	 * @param addr 地址
@@ -208,17 +398,83 @@ protected:
 	 */
 	void reg_read(uint32_t addr, uint32_t &val);
 	/*!
-	 * @brief 回调函数, 处理来自相机的数据信息
-	 * @param udp UDP连接指针
-	 * @param len 收到的数据长度, 量纲: 字节
+	 * @brief 以一次往返依次写入多个寄存器
+	 * @param addr 地址
+	 * @param val  数值
+	 * @param n    寄存器数量
+	 * @note
+	 * 操作失败抛出异常
+	 */
+	void reg_write(const uint32_t *addr, const uint32_t *val, int n);
+	/*!
+	 * @brief 以一次往返读取多个寄存器
+	 * @param addr 地址
+	 * @param val  数值
+	 * @param n    寄存器数量
+	 * @note
+	 * 操作失败抛出异常
 	 */
-	void receive_data(const long udp, const long len);
+	void reg_read(const uint32_t *addr, uint32_t *val, int n);
+	/*!
+	 * @brief 回调函数, 处理一批来自相机的图像数据包
+	 * @param pcks 已解析包头的数据包
+	 * @param n    数据包数量
+	 * @note
+	 * 在数据流接收线程中调用
+	 */
+	void receive_packets(GVSPPacket *pcks, int n);
+	/*!
+	 * @brief 回调函数, 预测后续图像数据包在帧存储区中的位置
+	 * @param tgt 预测结果
+	 * @param n   最多预测的数据包数量
+	 * @return
+	 * 预测的数据包数量
+	 * @note
+	 * 在数据流接收线程中调用. 预测命中时包数据由内核直接写入帧存储区, 免除复制
+	 */
+	int place_packets(GVSPTarget *tgt, int n);
+	/*!
+	 * @brief 为即将曝光的帧分配重组表表项, 关联当前帧存储区
+	 * @note
+	 * 调用者持有mtx_slot_
+	 */
+	void arm_slot();
+	/*!
+	 * @brief 退役当前帧表项
+	 * @note
+	 * 调用者持有mtx_slot_
+	 */
+	void retire_slot();
+	/*!
+	 * @brief 查找数据包所属表项
+	 * @param pck 数据包
+	 * @return
+	 * 表项地址. NULL: 迟到或无对应帧的数据包
+	 * @note
+	 * 调用者持有mtx_slot_. 当前帧尚未绑定时, 新于近期退役各帧的数据块绑定到当前帧;
+	 * 退役超过GY_SLOT_TIMEOUT的编号视为相机复用的编号
+	 */
+	FrameSlot *find_slot(const GVSPPacket &pck);
+	/*!
+	 * @brief 登记新接收的图像数据包, 更新缺失区间
+	 * @param slot  所属表项
+	 * @param idPck 数据包编号
+	 */
+	void record_packet(FrameSlot &slot, uint32_t idPck);
 	/*!
 	 * @brief 申请相机重传数据包
+	 * @param block  数据块编号
 	 * @param iPack0 起始帧编号
 	 * @param iPack1 截止帧编号
 	 */
-	void re_transmit(uint32_t iPack0, uint32_t iPack1);
+	void re_transmit(uint16_t block, uint32_t iPack0, uint32_t iPack1);
+	/*!
+	 * @brief 申请重传当前帧的全部缺失区间
+	 * @note
+	 * - 相邻缺失区间合并后一次性发出, 单轮数量受GY_RESEND_RANGES和GY_RESEND_PACKETS限制
+	 * - 轮次间隔自GY_BACKOFF_MIN起, 上一轮后未收到新数据时加倍, 上限GY_BACKOFF_MAX
+	 * - 当前帧超过GY_SLOT_TIMEOUT未收到数据时放弃该帧
+	 */
 	void re_transmit();
 	/*!
 	 * @brief 更新网络配置参数
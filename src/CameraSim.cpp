@@ -0,0 +1,312 @@
+/*!
+ * @file CameraSim.cpp 模拟相机定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 像素值 = 本底 + (信号 + 噪声) / 增益. 噪声 = sqrt(信号 + 读出噪声^2) * N(0, 1),
+ *   即以正态分布近似泊松分布
+ * - 读出噪声与本底按合并后像素计入, 与CCD片上合并一致
+ * - 正态分布随机数取自预先生成的随机数池, 以xorshift序列索引, 避免逐像素调用随机数发生器
+ */
+
+#include <cmath>
+#include <boost/make_shared.hpp>
+#include "CameraSim.h"
+
+namespace bc = boost::chrono;
+
+#define GAUSS_POOL_BITS	16	//< 正态分布随机数池长度, 量纲: 位
+
+/*!
+ * @brief 生成合成图像数据
+ * @param data   图像数据存储区
+ * @param n      像素数
+ * @param light  单位时间的信号. NULL: 本底或暗场
+ * @param dark   单位时间的暗信号
+ * @param gauss  正态分布随机数池
+ * @param seed   随机数种子
+ * @param t      积分时间, 量纲: 秒
+ * @param bias   本底, 量纲: DU
+ * @param rn     读出噪声, 量纲: e-
+ * @param gain   增益, 量纲: e-/DU
+ * @param satur  饱和值, 量纲: DU
+ */
+template <class T>
+void generate_pixels(T *data, int n, const float *light, const float *dark, const float *gauss,
+		uint32_t &seed, float t, float bias, float rn, float gain, float satur) {
+	const uint32_t mask = (1 << GAUSS_POOL_BITS) - 1;
+	float rn2 = rn * rn, kgain = 1.0 / gain;
+	float e, v;
+	uint32_t x = seed;
+
+	for (int i = 0; i < n; ++i) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		e = dark[i] * t;
+		if (light) e += light[i] * t;
+		v = bias + (e + std::sqrt(e + rn2) * gauss[x & mask]) * kgain;
+		if (v < 0.0) v = 0.0;
+		else if (v > satur) v = satur;
+		data[i] = T(v + 0.5);
+	}
+	seed = x;
+}
+
+CameraSim::CameraSim(const SimParameter &param) {
+	param_ = param;
+	if (param_.bitpixel < 8)  param_.bitpixel = 8;
+	if (param_.bitpixel > 16) param_.bitpixel = 16;
+	if (param_.gain <= 0.0)   param_.gain = 1.0;
+	rng_.seed(uint32_t(bc::steady_clock::now().time_since_epoch().count()));
+	seed_ = rng_() | 1;
+	duration_    = 0.0;
+	light_frame_ = true;
+	aborted_sim_ = false;
+	failure_     = false;
+	coolset_     = 20.0;
+}
+
+CameraSim::~CameraSim() {
+}
+
+bool CameraSim::open_camera() {
+	nfptr_->model   = "Simulator";
+	nfptr_->sensorW = param_.sensorW;
+	nfptr_->sensorH = param_.sensorH;
+	nfptr_->pixelX  = param_.pixelsize;
+	nfptr_->pixelY  = param_.pixelsize;
+	nfptr_->EMCCD   = false;
+	create_field();
+	render_roi(1, 1, 1, 1, param_.sensorW, param_.sensorH);
+	return true;
+}
+
+bool CameraSim::close_camera() {
+	light_.reset();
+	dark_.reset();
+	return true;
+}
+
+bool CameraSim::cooler_onoff(bool &onoff, float &coolset) {
+	coolset_ = onoff ? coolset : 20.0;
+	return true;
+}
+
+float CameraSim::sensor_temperature() {
+	return coolset_;
+}
+
+bool CameraSim::update_adchannel(uint16_t &index, uint16_t &bitpix) {
+	index  = 0;
+	bitpix = param_.bitpixel;
+	return true;
+}
+
+bool CameraSim::update_readport(uint16_t &index, string &readport) {
+	index    = 0;
+	readport = "Normal";
+	return true;
+}
+
+bool CameraSim::update_readrate(uint16_t &index, string &readrate) {
+	index    = 0;
+	readrate = (boost::format("%.1fMHz") % param_.readrate).str();
+	return true;
+}
+
+bool CameraSim::update_vsrate(uint16_t &index, float &vsrate) {
+	index  = 0;
+	vsrate = 0.0;
+	return true;
+}
+
+bool CameraSim::update_gain(uint16_t &index, float &gain) {
+	index = 0;
+	gain  = param_.gain;
+	return true;
+}
+
+bool CameraSim::update_adoffset(uint16_t value) {
+	param_.bias = value;
+	return true;
+}
+
+bool CameraSim::update_roi(int &xb, int &yb, int &x, int &y, int &w, int &h) {
+	render_roi(xb, yb, x, y, w, h);
+	return true;
+}
+
+bool CameraSim::start_expose(float duration, bool light) {
+	duration_    = duration;
+	light_frame_ = light;
+	aborted_sim_ = false;
+	failure_     = inject_failure();
+	tmstart_     = bc::steady_clock::now();
+	return true;
+}
+
+bool CameraSim::stop_expose() {
+	aborted_sim_ = true;
+	return true;
+}
+
+CameraBase::CAMERA_STATUS CameraSim::camera_state() {
+	if (aborted_sim_) return CAMERA_IDLE;
+	bc::duration<double> elps = bc::steady_clock::now() - tmstart_;
+	return elps.count() >= duration_ ? CAMERA_IMGRDY : CAMERA_EXPOSE;
+}
+
+CameraBase::CAMERA_STATUS CameraSim::download_image() {
+	steady_time tmread = bc::steady_clock::now();
+	int n = nfptr_->roi.Pixels();
+	float satur = float((1 << nfptr_->bitpixel) - 1);
+	const float *light = light_frame_ ? light_.get() : NULL;
+
+	if (nfptr_->bytepix == 1) {
+		generate_pixels((uint8_t*) nfptr_->data.get(), n, light, dark_.get(), gauss_.get(),
+				seed_, duration_, param_.bias, param_.readnoise, param_.gain, satur);
+	}
+	else {
+		generate_pixels((uint16_t*) nfptr_->data.get(), n, light, dark_.get(), gauss_.get(),
+				seed_, duration_, param_.bias, param_.readnoise, param_.gain, satur);
+	}
+	add_cosmic(nfptr_->data.get(), nfptr_->roi.Width(), nfptr_->roi.Height());
+	/* 模拟读出时间. 生成图像的耗时计入读出时间 */
+	if (param_.readrate > 0.0) {
+		bc::microseconds tread(int64_t(n / param_.readrate));
+		boost::this_thread::sleep_until(tmread + tread);
+	}
+
+	if (aborted_sim_) return CAMERA_IDLE;
+	if (failure_) {
+		if (!param_.fatal) return CAMERA_IDLE;
+		nfptr_->errcode = 1;
+		nfptr_->errmsg  = "simulated readout failure";
+		return CAMERA_ERROR;
+	}
+	return CAMERA_IMGRDY;
+}
+
+void CameraSim::create_field() {
+	namespace br = boost::random;
+	br::uniform_real_distribution<float> ux(0.0, param_.sensorW);
+	br::uniform_real_distribution<float> uy(0.0, param_.sensorH);
+	br::uniform_real_distribution<float> u01(0.0, 1.0);
+	br::normal_distribution<float> norm;
+	int i, n;
+
+	/* 恒星: 位置均匀分布, 流量服从幂律分布 */
+	stars_.resize(param_.stars);
+	for (i = 0; i < param_.stars; ++i) {
+		SimStar &star = stars_[i];
+		star.x    = ux(rng_);
+		star.y    = uy(rng_);
+		star.flux = 50.0 * std::pow(1.0 - u01(rng_), -1.0 / 1.5);
+		if (star.flux > 1E6) star.flux = 1E6;
+	}
+	/* 热像素 */
+	hots_.resize(param_.hotpixels);
+	for (i = 0; i < param_.hotpixels; ++i) {
+		HotPixel &hot = hots_[i];
+		hot.x    = int(ux(rng_));
+		hot.y    = int(uy(rng_));
+		hot.rate = 50.0 + 4950.0 * u01(rng_);
+	}
+	/* 正态分布随机数池 */
+	n = 1 << GAUSS_POOL_BITS;
+	gauss_.reset(new float[n]);
+	for (i = 0; i < n; ++i) gauss_[i] = norm(rng_);
+}
+
+void CameraSim::render_roi(int xb, int yb, int x, int y, int w, int h) {
+	int wb = w / xb, hb = h / yb, n = wb * hb;
+	int x0 = x - 1, y0 = y - 1;	// ROI区在全帧中的边界: [x0, x1), [y0, y1)
+	int x1 = x0 + wb * xb, y1 = y0 + hb * yb;
+	float sky = param_.sky * xb * yb;
+	float dark = param_.dark * xb * yb;
+	double sigma = param_.fwhm / 2.3548;
+	double k = -0.5 / (sigma * sigma);
+	double norm = 1.0 / (2.0 * M_PI * sigma * sigma);
+	int r = int(3.0 * sigma) + 1;
+	int i, px, py, xs, xe, ys, ye;
+	double dx, dy;
+
+	light_.reset(new float[n]);
+	dark_.reset(new float[n]);
+	for (i = 0; i < n; ++i) {
+		light_[i] = sky;
+		dark_[i]  = dark;
+	}
+	/* 恒星: 高斯型点扩散函数, 以像素中心处的值近似 */
+	for (SimStarVec::iterator it = stars_.begin(); it != stars_.end(); ++it) {
+		if ((xs = int(it->x) - r) < x0) xs = x0;
+		if ((xe = int(it->x) + r + 1) > x1) xe = x1;
+		if ((ys = int(it->y) - r) < y0) ys = y0;
+		if ((ye = int(it->y) + r + 1) > y1) ye = y1;
+		for (py = ys; py < ye; ++py) {
+			dy = py + 0.5 - it->y;
+			for (px = xs; px < xe; ++px) {
+				dx = px + 0.5 - it->x;
+				light_[(py - y0) / yb * wb + (px - x0) / xb] += it->flux * norm * std::exp(k * (dx * dx + dy * dy));
+			}
+		}
+	}
+	/* 热像素 */
+	for (HotPixelVec::iterator it = hots_.begin(); it != hots_.end(); ++it) {
+		if (it->x >= x0 && it->x < x1 && it->y >= y0 && it->y < y1)
+			dark_[(it->y - y0) / yb * wb + (it->x - x0) / xb] += it->rate;
+	}
+}
+
+/*
+ * @note 宇宙线:
+ * - 事件数服从泊松分布, 期望值按积分时间和ROI区面积折算
+ * - 每个事件沿随机方向留下长度为1~8像素的径迹
+ */
+void CameraSim::add_cosmic(uint8_t *data, int w, int h) {
+	namespace br = boost::random;
+	ROI &roi = nfptr_->roi;
+	double area = double(roi.width) * roi.height / (double(param_.sensorW) * param_.sensorH);
+	double mean = param_.cosmic * duration_ * area;
+	if (mean <= 0.0) return;
+
+	br::poisson_distribution<int, double> poisson(mean);
+	br::uniform_real_distribution<double> u01(0.0, 1.0);
+	int satur = (1 << nfptr_->bitpixel) - 1;
+	int bytepix = nfptr_->bytepix;
+	int events = poisson(rng_);
+	int len, i, px, py, v;
+	double x, y, theta, cx, cy, adu;
+
+	for (int j = 0; j < events; ++j) {
+		x     = u01(rng_) * w;
+		y     = u01(rng_) * h;
+		theta = u01(rng_) * 2.0 * M_PI;
+		len   = 1 + int(u01(rng_) * 8.0);
+		cx    = std::cos(theta);
+		cy    = std::sin(theta);
+		for (i = 0; i < len; ++i, x += cx, y += cy) {
+			px = int(x);
+			py = int(y);
+			if (px < 0 || px >= w || py < 0 || py >= h) break;
+			adu = (1000.0 + 19000.0 * u01(rng_)) / param_.gain;
+			if (bytepix == 1) {
+				uint8_t *ptr = data + py * w + px;
+				if ((v = *ptr + int(adu)) > satur) v = satur;
+				*ptr = uint8_t(v);
+			}
+			else {
+				uint16_t *ptr = (uint16_t*) data + py * w + px;
+				if ((v = *ptr + int(adu)) > satur) v = satur;
+				*ptr = uint16_t(v);
+			}
+		}
+	}
+}
+
+bool CameraSim::inject_failure() {
+	if (param_.failure <= 0.0) return false;
+	boost::random::uniform_real_distribution<float> u01(0.0, 1.0);
+	return u01(rng_) < param_.failure;
+}
@@ -0,0 +1,210 @@
+/*!
+ * @file CameraSim.h 模拟相机声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 不需要真实相机, 生成合成图像: 本底、读出噪声、恒星、热像素、宇宙线
+ * - 模拟曝光与读出时序, 用于在普通计算机上测试存储、统计、网络与序列曝光的吞吐量
+ * - 支持故障注入: 按概率丢失当前帧或使相机进入错误状态
+ */
+
+#ifndef SRC_CAMERASIM_H_
+#define SRC_CAMERASIM_H_
+
+#include <boost/random.hpp>
+#include <boost/chrono.hpp>
+#include "CameraBase.h"
+
+class CameraSim: public CameraBase {
+public:
+	/*!
+	 * @struct SimParameter 模拟相机参数
+	 */
+	struct SimParameter {
+		int sensorW;		//< 探测器宽度
+		int sensorH;		//< 探测器高度
+		int bitpixel;		//< A/D位数. 有效范围: [8, 16]
+		float pixelsize;	//< 单像素尺寸, 量纲: 微米
+		float readrate;		//< 读出速度, 量纲: 百万像素/秒. <= 0: 不模拟读出时间
+		float bias;			//< 本底, 量纲: DU
+		float readnoise;	//< 读出噪声, 量纲: e-
+		float gain;			//< 增益, 量纲: e-/DU
+		float sky;			//< 天光背景, 量纲: e-/秒/像素
+		float dark;			//< 暗流, 量纲: e-/秒/像素
+		int stars;			//< 视场内恒星数量
+		float fwhm;			//< 星像半高全宽, 量纲: 像素
+		int hotpixels;		//< 热像素数量
+		float cosmic;		//< 宇宙线事件率, 量纲: 次/秒/全帧
+		float failure;		//< 故障概率, 量纲: 次/帧. 有效范围: [0, 1]
+		bool fatal;			//< 故障类型. true: 相机错误; false: 丢失当前帧
+
+	public:
+		SimParameter() {
+			sensorW   = 4096;
+			sensorH   = 4096;
+			bitpixel  = 16;
+			pixelsize = 12.0;
+			readrate  = 10.0;
+			bias      = 1000.0;
+			readnoise = 8.0;
+			gain      = 1.5;
+			sky       = 20.0;
+			dark      = 0.01;
+			stars     = 2000;
+			fwhm      = 2.5;
+			hotpixels = 500;
+			cosmic    = 5.0;
+			failure   = 0.0;
+			fatal     = false;
+		}
+	};
+
+	/*!
+	 * @struct SimStar 模拟恒星
+	 */
+	struct SimStar {
+		float x, y;	//< 全帧中的位置, 起始坐标: [0, 0]
+		float flux;	//< 流量, 量纲: e-/秒
+	};
+	typedef std::vector<SimStar> SimStarVec;
+
+	/*!
+	 * @struct HotPixel 热像素
+	 */
+	struct HotPixel {
+		int x, y;	//< 全帧中的位置, 起始坐标: [0, 0]
+		float rate;	//< 暗流, 量纲: e-/秒
+	};
+	typedef std::vector<HotPixel> HotPixelVec;
+	typedef boost::chrono::steady_clock::time_point steady_time;
+
+public:
+	CameraSim(const SimParameter &param);
+	virtual ~CameraSim();
+
+protected:
+	SimParameter param_;	//< 模拟参数
+	boost::random::mt19937 rng_;	//< 随机数发生器
+	uint32_t seed_;			//< 像素噪声随机数种子
+	SimStarVec stars_;		//< 恒星
+	HotPixelVec hots_;		//< 热像素
+	boost::shared_array<float> light_;	//< ROI区内单位时间的信号, 量纲: e-/秒
+	boost::shared_array<float> dark_;	//< ROI区内单位时间的暗信号, 量纲: e-/秒
+	boost::shared_array<float> gauss_;	//< 标准正态分布随机数池
+	steady_time tmstart_;	//< 曝光起始时间
+	float duration_;		//< 积分时间, 量纲: 秒
+	bool light_frame_;		//< 是否需要外界光源
+	bool aborted_sim_;		//< 已中止曝光
+	bool failure_;			//< 当前帧注入故障
+	float coolset_;			//< 制冷温度
+
+protected:
+	/* 基类定义的虚函数 */
+	/*!
+	 * @brief 继承类实现与相机的真正连接
+	 * @return
+	 * 连接结果
+	 */
+	bool open_camera();
+	/*!
+	 * @brief 继承类实现真正与相机断开连接
+	 */
+	bool close_camera();
+	/*!
+	 * @brief 改变制冷状态
+	 */
+	bool cooler_onoff(bool &onoff, float &coolset);
+	/*!
+	 * @brief 采集探测器芯片温度
+	 */
+	float sensor_temperature();
+	/*!
+	 * @brief 设置AD通道
+	 */
+	bool update_adchannel(uint16_t &index, uint16_t &bitpix);
+	/*!
+	 * @brief 设置读出端口
+	 */
+	bool update_readport(uint16_t &index, string &readport);
+	/*!
+	 * @brief 设置读出速度
+	 */
+	bool update_readrate(uint16_t &index, string &readrate);
+	/*!
+	 * @brief 设置行转移速度
+	 */
+	bool update_vsrate(uint16_t &index, float &vsrate);
+	/*!
+	 * @brief 设置增益
+	 */
+	bool update_gain(uint16_t &index, float &gain);
+	/*!
+	 * @brief 设置A/D基准偏压
+	 */
+	bool update_adoffset(uint16_t value);
+	/*!
+	 * @brief 更新ROI区域
+	 * @param xb  X轴合并因子
+	 * @param yb  Y轴合并因子
+	 * @param x   X轴起始位置, 相对原始图像起始位置
+	 * @param y   Y轴起始位置, 相对原始图像起始位置
+	 * @param w   ROI区宽度
+	 * @param h   ROI区高度
+	 */
+	bool update_roi(int &xb, int &yb, int &x, int &y, int &w, int &h);
+	/*!
+	 * @brief 启动曝光
+	 */
+	bool start_expose(float duration, bool light);
+	/*!
+	 * @brief 中止曝光
+	 */
+	bool stop_expose();
+	/*!
+	 * @brief 检测曝光状态
+	 */
+	CAMERA_STATUS camera_state();
+	/*!
+	 * @brief 从相机读出图像数据到存储区
+	 * @return
+	 * 相机工作状态
+	 * @note
+	 * 返回值对应download_image()的结果:
+	 * - CAMERA_IMGRDY: 读出成功
+	 * - CAMERA_IDLE:   读出失败, 源于中止曝光
+	 * - CAMERA_ERROR:  相机错误
+	 */
+	CAMERA_STATUS download_image();
+
+protected:
+	/*!
+	 * @brief 生成视场: 恒星、热像素与正态分布随机数池
+	 */
+	void create_field();
+	/*!
+	 * @brief 按ROI区计算单位时间的信号与暗信号
+	 * @param xb  X轴合并因子
+	 * @param yb  Y轴合并因子
+	 * @param x   X轴起始位置, 起始坐标: [1, 1]
+	 * @param y   Y轴起始位置, 起始坐标: [1, 1]
+	 * @param w   ROI区宽度
+	 * @param h   ROI区高度
+	 */
+	void render_roi(int xb, int yb, int x, int y, int w, int h);
+	/*!
+	 * @brief 在图像数据中叠加宇宙线
+	 * @param data  图像数据存储区
+	 * @param w     图像宽度, 量纲: 合并后像素
+	 * @param h     图像高度, 量纲: 合并后像素
+	 */
+	void add_cosmic(uint8_t *data, int w, int h);
+	/*!
+	 * @brief 注入故障
+	 * @return
+	 * 本次操作需要失败
+	 */
+	bool inject_failure();
+};
+typedef boost::shared_ptr<CameraSim> CameraSimPtr;
+
+#endif /* SRC_CAMERASIM_H_ */
@@ -47,6 +47,31 @@ struct ConfigParameter {
 	int vsrate;			//< 行转移速度的档位
 	int emgain;			//< EM增益
 	int tsat;			//< 饱和反转值. 饱和反转后的数值
+	int frmslots;		//< 帧缓存区数量
+	string softbin;		//< 软件合并方式: SUM或MEAN
+	int packsize;		//< 网络相机数据包长度, 含IP与UDP包头. 0: 自动探测
+	int rcvbuf;			//< 网络相机数据套接字接收缓冲区容量, 量纲: MB. 0: 系统默认
+	int streamcpu;		//< 网络相机数据接收线程绑定的CPU. <0: 不绑定
+	int streamprio;		//< 网络相机数据接收线程SCHED_FIFO优先级. 0: 默认调度
+	bool lockmem;		//< 采集期间锁定帧存储区
+	bool paceauto;		//< 网络相机按丢包率自动调整包间延时
+	int pacedelay;		//< 网络相机初始包间延时, 量纲: 相机时间戳计数
+	int pacemax;		//< 网络相机包间延时上限
+	int pacestep;		//< 网络相机包间延时调整步长
+	// 模拟相机
+	int simW;			//< 探测器宽度
+	int simH;			//< 探测器高度
+	int simBitpix;		//< A/D位数
+	float simRate;		//< 读出速度, 量纲: 百万像素/秒
+	float simBias;		//< 本底, 量纲: DU
+	float simNoise;		//< 读出噪声, 量纲: e-
+	float simGain;		//< 增益, 量纲: e-/DU
+	float simSky;		//< 天光背景, 量纲: e-/秒/像素
+	int simStars;		//< 恒星数量
+	int simHots;		//< 热像素数量
+	float simCosmic;	//< 宇宙线事件率, 量纲: 次/秒/全帧
+	float simFailure;	//< 故障概率, 量纲: 次/帧
+	bool simFatal;		//< 故障类型. true: 相机错误; false: 丢失当前帧
 	// 相机制冷
 	bool coolalone;		//< 独立控制制冷
 	int coolset;		//< 制冷温度, 量纲: 摄氏度
@@ -64,6 +89,12 @@ struct ConfigParameter {
 	// 本地文件管理
 	string pathroot;	//< 本地文件存储目录名
 	uint fdmin;			//< 最小可用硬盘空间, 量纲: GB
+	int wrthreads;		//< 存储线程数量
+	int wrdepth;		//< 存储队列容量, 量纲: 帧
+	bool wrdirect;		//< 以O_DIRECT方式写入文件
+	string ziptype;		//< 分块压缩算法: NONE, RICE, GZIP2, HCOMPRESS
+	int ziptile;		//< 压缩分块的行数
+	int zipthreads;		//< 压缩线程池的线程数量, 由全部存储线程共享. <= 0: 使用全部处理器核心
 	// 图像是否显示
 	bool imgshow;		//< 图像显示标记
 	// 平场
@@ -78,6 +109,10 @@ struct ConfigParameter {
 	// 总控服务器
 	string gcip;	//< IP地址
 	uint gcport;	//< TCP端口
+	bool gcbinary;	//< 请求二进制帧模式. 服务器不支持时采用ASCII模式
+	// 网络通信
+	int iothreads;		//< 共享执行器线程数
+	bool ioisolate;		//< GY相机控制通道使用独立执行器
 	// NTP服务器
 	bool ntpenable;	//<　启用NTP服务
 	string ntpip;	//< IP地址
@@ -102,6 +137,7 @@ public:
 		node1.add("<xmlcomment>", "Camera Type#2: FLI CCD");
 		node1.add("<xmlcomment>", "Camera Type#3: Apogee CCD");
 		node1.add("<xmlcomment>", "Camera Type#4: GWAC-GY CCD");
+		node1.add("<xmlcomment>", "Camera Type#5: Simulated CCD");
 		node1.add("Camera.<xmlattr>.Type",    4);
 		node1.add("IPAddress",                "172.28.4.11");
 		node1.add("Read.<xmlattr>.ADChannel", 0);
@@ -111,6 +147,39 @@ public:
 		node1.add("VerticalShift.<xmlattr>.Rate", 0);
 		node1.add("EM.<xmlattr>.Gain", 10);
 		node1.add("ReverseSaturation", 600);
+		node1.add("FrameBuffer.<xmlattr>.Slots", 3);
+		node1.add("<xmlcomment>", "Software binning for cameras without hardware ROI: SUM or MEAN");
+		node1.add("SoftBinning.<xmlattr>.Mode", "SUM");
+		node1.add("<xmlcomment>", "Stream packet size of network camera, 1500-9000 bytes. 0: probe the path MTU");
+		node1.add("Stream.<xmlattr>.PacketSize", 0);
+		node1.add("<xmlcomment>", "Kernel receive buffer of stream socket in MB. 0: system default");
+		node1.add("Stream.<xmlattr>.RecvBuffer", 64);
+		node1.add("<xmlcomment>", "Receive thread: CPU -1 = no pinning; Priority 1-99 = SCHED_FIFO, 0 = default");
+		node1.add("Stream.Thread.<xmlattr>.CPU",      -1);
+		node1.add("Stream.Thread.<xmlattr>.Priority", 0);
+		node1.add("Stream.Thread.<xmlattr>.LockMemory", true);
+		node1.add("<xmlcomment>", "Inter-packet delay(GevSCPD) in camera timestamp ticks. Auto: adapt to packet loss");
+		node1.add("Stream.Pacing.<xmlattr>.Auto",  true);
+		node1.add("Stream.Pacing.<xmlattr>.Delay", 0);
+		node1.add("Stream.Pacing.<xmlattr>.Max",   50000);
+		node1.add("Stream.Pacing.<xmlattr>.Step",  500);
+		// 模拟相机
+		node1.add("Simulator.Sensor.<xmlattr>.Width",    4096);
+		node1.add("Simulator.Sensor.<xmlattr>.Height",   4096);
+		node1.add("Simulator.Sensor.<xmlattr>.BitPixel", 16);
+		node1.add("<xmlcomment>", "ReadRate: Mpixel/s. ReadNoise: e-. Gain: e-/DU");
+		node1.add("Simulator.Read.<xmlattr>.Rate",       10.0);
+		node1.add("Simulator.Read.<xmlattr>.Bias",       1000);
+		node1.add("Simulator.Read.<xmlattr>.Noise",      8.0);
+		node1.add("Simulator.Read.<xmlattr>.Gain",       1.5);
+		node1.add("<xmlcomment>", "Sky: e-/s/pixel. Cosmic: events/s per full frame");
+		node1.add("Simulator.Field.<xmlattr>.Sky",       20.0);
+		node1.add("Simulator.Field.<xmlattr>.Stars",     2000);
+		node1.add("Simulator.Field.<xmlattr>.HotPixels", 500);
+		node1.add("Simulator.Field.<xmlattr>.Cosmic",    5.0);
+		node1.add("<xmlcomment>", "Failure: probability per frame. Fatal: camera error or lost frame");
+		node1.add("Simulator.Failure.<xmlattr>.Rate",    0.0);
+		node1.add("Simulator.Failure.<xmlattr>.Fatal",   false);
 		// 相机制冷
 		pt.add("Cooler.<xmlattr>.Set", -40.0);
 		pt.add("AloneCooler.<xmlattr>.enable", false);
@@ -135,6 +204,13 @@ public:
 		proptree::ptree &node4 = pt.add("LocalStorage", "");
 		node4.add("PathRoot",         "/data");
 		node4.add("FreeDiskCapacity", 100);
+		node4.add("Writer.<xmlattr>.Threads",    2);
+		node4.add("Writer.<xmlattr>.QueueDepth", 4);
+		node4.add("Writer.<xmlattr>.Direct",     true);
+		node4.add("<xmlcomment>", "Compress Type: NONE, RICE, GZIP2 or HCOMPRESS");
+		node4.add("Compress.<xmlattr>.Type",     "NONE");
+		node4.add("Compress.<xmlattr>.TileRows", 1);
+		node4.add("Compress.<xmlattr>.Threads",  0);
 		// 图像是否显示
 		pt.add("ShowImage.<xmlattr>.Enable", false);
 		// 平场
@@ -150,6 +226,12 @@ public:
 		// 总控服务器
 		pt.add("GeneralControl.<xmlattr>.IP",   "172.28.1.11");
 		pt.add("GeneralControl.<xmlattr>.Port", 4013);
+		pt.add("<xmlcomment>", "BinaryFrame: request length-prefixed binary frames, fall back to ASCII lines");
+		pt.add("GeneralControl.<xmlattr>.BinaryFrame", false);
+		// 网络通信
+		pt.add("<xmlcomment>", "Threads: I/O threads shared by network connections; IsolateGY: dedicated thread for GY control channel");
+		pt.add("NetworkIO.<xmlattr>.Threads",   2);
+		pt.add("NetworkIO.<xmlattr>.IsolateGY", true);
 		// NTP服务器
 		pt.add("NTP.<xmlattr>.Enable",       true);
 		pt.add("NTP.<xmlattr>.IP",           "172.28.1.3");
@@ -169,6 +251,8 @@ public:
 			proptree::ptree pt;
 			read_xml(filepath, pt, proptree::xml_parser::trim_whitespace);
 
+			iothreads = 2;
+			ioisolate = true;
 			BOOST_FOREACH(proptree::ptree::value_type const &child, pt.get_child("")) {
 				if (boost::iequals(child.first, "Camera")) {
 					termType  = child.second.get("Terminal.<xmlattr>.Type",      "JFoV");
@@ -181,6 +265,30 @@ public:
 					vsrate    = child.second.get("VerticalShift.<xmlattr>.Rate", 0);
 					emgain    = child.second.get("EM.<xmlattr>.Gain",            10);
 					tsat      = child.second.get("ReverseSaturation",            600);
+					frmslots  = child.second.get("FrameBuffer.<xmlattr>.Slots",  3);
+					softbin   = child.second.get("SoftBinning.<xmlattr>.Mode",   "SUM");
+					packsize  = child.second.get("Stream.<xmlattr>.PacketSize",  0);
+					rcvbuf    = child.second.get("Stream.<xmlattr>.RecvBuffer",  64);
+					streamcpu  = child.second.get("Stream.Thread.<xmlattr>.CPU",        -1);
+					streamprio = child.second.get("Stream.Thread.<xmlattr>.Priority",   0);
+					lockmem    = child.second.get("Stream.Thread.<xmlattr>.LockMemory", true);
+					paceauto   = child.second.get("Stream.Pacing.<xmlattr>.Auto",       true);
+					pacedelay  = child.second.get("Stream.Pacing.<xmlattr>.Delay",      0);
+					pacemax    = child.second.get("Stream.Pacing.<xmlattr>.Max",        50000);
+					pacestep   = child.second.get("Stream.Pacing.<xmlattr>.Step",       500);
+					simW       = child.second.get("Simulator.Sensor.<xmlattr>.Width",    4096);
+					simH       = child.second.get("Simulator.Sensor.<xmlattr>.Height",   4096);
+					simBitpix  = child.second.get("Simulator.Sensor.<xmlattr>.BitPixel", 16);
+					simRate    = child.second.get("Simulator.Read.<xmlattr>.Rate",       10.0);
+					simBias    = child.second.get("Simulator.Read.<xmlattr>.Bias",       1000.0);
+					simNoise   = child.second.get("Simulator.Read.<xmlattr>.Noise",      8.0);
+					simGain    = child.second.get("Simulator.Read.<xmlattr>.Gain",       1.5);
+					simSky     = child.second.get("Simulator.Field.<xmlattr>.Sky",       20.0);
+					simStars   = child.second.get("Simulator.Field.<xmlattr>.Stars",     2000);
+					simHots    = child.second.get("Simulator.Field.<xmlattr>.HotPixels", 500);
+					simCosmic  = child.second.get("Simulator.Field.<xmlattr>.Cosmic",    5.0);
+					simFailure = child.second.get("Simulator.Failure.<xmlattr>.Rate",    0.0);
+					simFatal   = child.second.get("Simulator.Failure.<xmlattr>.Fatal",   false);
 				}
 				else if (boost::iequals(child.first, "Cooler")) { // 相机制冷
 					coolset   = child.second.get("<xmlattr>.Set",   -40.0);
@@ -209,6 +317,12 @@ public:
 				else if (boost::iequals(child.first, "LocalStorage")) {
 					pathroot = child.second.get("PathRoot", "/data");
 					fdmin = child.second.get("FreeDiskCapacity", 100);
+					wrthreads = child.second.get("Writer.<xmlattr>.Threads",    2);
+					wrdepth   = child.second.get("Writer.<xmlattr>.QueueDepth", 4);
+					wrdirect  = child.second.get("Writer.<xmlattr>.Direct",     true);
+					ziptype    = child.second.get("Compress.<xmlattr>.Type",     "NONE");
+					ziptile    = child.second.get("Compress.<xmlattr>.TileRows", 1);
+					zipthreads = child.second.get("Compress.<xmlattr>.Threads",  0);
 				}
 				else if (boost::iequals(child.first, "FlatField")) {
 					ffminv = child.second.get("StatADU.<xmlattr>.Min", 20000);
@@ -224,6 +338,11 @@ public:
 				else if (boost::iequals(child.first, "GeneralControl")) {
 					gcip   = child.second.get("<xmlattr>.IP",   "172.28.1.11");
 					gcport = child.second.get("<xmlattr>.Port", 4013);
+					gcbinary = child.second.get("<xmlattr>.BinaryFrame", false);
+				}
+				else if (boost::iequals(child.first, "NetworkIO")) {
+					iothreads = child.second.get("<xmlattr>.Threads",   2);
+					ioisolate = child.second.get("<xmlattr>.IsolateGY", true);
 				}
 				else if (boost::iequals(child.first, "NTP")) {
 					ntpenable = child.second.get("<xmlattr>.Enable",       true);
@@ -2,13 +2,49 @@
  * @brief FitsHandler.cpp 基于cfitsio的FITS文件访问接口
  */
 #include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
 #include "FitsHandler.h"
 
 namespace AstroUtil {
 //////////////////////////////////////////////////////////////////////////////
+#define RICE_BLOCKSIZE	32	//< RICE_1压缩的块长度
+#define GZIP_LEVEL		1	//< GZIP_2的压缩级别: 优先保证速度
+
+CompressPool::CompressPool(int threads)
+	: work_(ios_) {
+	if (threads <= 0 && (threads = boost::thread::hardware_concurrency()) <= 0) threads = 1;
+	count_ = threads;
+	for (int i = 0; i < threads; ++i)
+		threads_.create_thread(boost::bind(&boost::asio::io_service::run, &ios_));
+}
+
+CompressPool::~CompressPool() {
+	ios_.stop();
+	threads_.join_all();
+}
+
+void CompressPool::Post(const boost::function<void ()> &task) {
+	ios_.post(task);
+}
+
+int CompressPool::Threads() {
+	return count_;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 FitsHandler::FitsHandler() {
 	fileptr_ = NULL;
 	rows_ = cols_ = 0;
+	compress_ = FITS_COMPRESS_NONE;
+	bytepix_  = 0;
+	tilerows_ = 1;
+	errmsg[0] = 0;
 }
 
 FitsHandler::~FitsHandler() {
@@ -155,5 +191,264 @@ bool FitsHandler::WriteImage(float *data, int datatype) {
 	fill_errmsg(status);
 	return status == 0;
 }
+
+/*
+ * @note 文件结构与fpack一致:
+ * - 主HDU: NAXIS = 0
+ * - 扩展: 二进制表, 每行对应一个分块, 单列COMPRESSED_DATA(1PB)存储压缩后的字节流
+ */
+bool FitsHandler::CreateCompressed(const char *filepath, int bytepix, int width, int height,
+		int method, int tilerows) {
+	close();
+	if (!(bytepix == 1 || bytepix == 2 || bytepix == 4)
+			|| method <= FITS_COMPRESS_NONE || method > FITS_COMPRESS_HCOMPRESS) {
+		strcpy(errmsg, "unsupported compression parameters");
+		return false;
+	}
+	int status(0);
+	int bitpix = bytepix * 8;
+	if (tilerows <= 0 || tilerows > height) tilerows = height;
+	if (method == FITS_COMPRESS_HCOMPRESS && tilerows < 16) tilerows = height < 16 ? height : 16;
+
+	fits_create_file(&fileptr_, filepath, &status);
+	if (method == FITS_COMPRESS_HCOMPRESS) {// 由cfitsio生成压缩HDU
+		int imgtype = bytepix == 1 ? BYTE_IMG : (bytepix == 2 ? USHORT_IMG : ULONG_IMG);
+		long naxes[] = { width, height };
+		long tile[]  = { width, tilerows };
+		fits_set_compression_type(fileptr_, HCOMPRESS_1, &status);
+		fits_set_tile_dim(fileptr_, 2, tile, &status);
+		fits_create_img(fileptr_, imgtype, 2, naxes, &status);
+	}
+	else {
+		char ttype[] = "COMPRESSED_DATA", tform[] = "1PB";
+		char *ttypes[] = { ttype }, *tforms[] = { tform };
+		int ztrue(1), naxis(2), blocksize(RICE_BLOCKSIZE);
+		char cmptype[16];
+
+		strcpy(cmptype, method == FITS_COMPRESS_RICE ? "RICE_1" : "GZIP_2");
+		fits_create_img(fileptr_, bitpix, 0, NULL, &status);
+		fits_create_tbl(fileptr_, BINARY_TBL, 0, 1, ttypes, tforms, NULL, "COMPRESSED_IMAGE", &status);
+		fits_write_key(fileptr_, TLOGICAL, "ZIMAGE",   &ztrue,    "extension contains compressed image", &status);
+		fits_write_key(fileptr_, TINT,     "ZBITPIX",  &bitpix,   "data type of original image", &status);
+		fits_write_key(fileptr_, TINT,     "ZNAXIS",   &naxis,    "dimension of original image", &status);
+		fits_write_key(fileptr_, TINT,     "ZNAXIS1",  &width,    "length of original image axis", &status);
+		fits_write_key(fileptr_, TINT,     "ZNAXIS2",  &height,   "length of original image axis", &status);
+		fits_write_key(fileptr_, TINT,     "ZTILE1",   &width,    "size of tiles to be compressed", &status);
+		fits_write_key(fileptr_, TINT,     "ZTILE2",   &tilerows, "size of tiles to be compressed", &status);
+		fits_write_key(fileptr_, TSTRING,  "ZCMPTYPE", cmptype,   "compression algorithm", &status);
+		if (method == FITS_COMPRESS_RICE) {
+			char name1[] = "BLOCKSIZE", name2[] = "BYTEPIX";
+			fits_write_key(fileptr_, TSTRING, "ZNAME1", name1,      "compression block size", &status);
+			fits_write_key(fileptr_, TINT,    "ZVAL1",  &blocksize, "pixels per block", &status);
+			fits_write_key(fileptr_, TSTRING, "ZNAME2", name2,      "bytes per pixel (1, 2, 4, or 8)", &status);
+			fits_write_key(fileptr_, TINT,    "ZVAL2",  &bytepix,   "bytes per pixel (1, 2, 4, or 8)", &status);
+		}
+		if (bytepix > 1) {
+			double bzero = bytepix == 2 ? 32768.0 : 2147483648.0, bscale(1.0);
+			fits_write_key(fileptr_, TDOUBLE, "BZERO",  &bzero,  "offset data range to that of unsigned integer", &status);
+			fits_write_key(fileptr_, TDOUBLE, "BSCALE", &bscale, "default scaling factor", &status);
+		}
+	}
+	if (!status) {
+		filepath_ = filepath[0] == '!' ? filepath + 1 : filepath;
+		compress_ = method;
+		bytepix_  = bytepix;
+		tilerows_ = tilerows;
+		cols_ = width;
+		rows_ = height;
+	}
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::WriteCompressed(const void *data, CompressInfo &info, CompressPool *pool) {
+	namespace bc = boost::chrono;
+	if (!fileptr_ || compress_ == FITS_COMPRESS_NONE) return false;
+	bc::steady_clock::time_point tm0 = bc::steady_clock::now();
+	int status(0), i, n;
+
+	memset(&info, 0, sizeof(info));
+	info.rawbytes = size_t(rows_) * cols_ * bytepix_;
+	if (compress_ == FITS_COMPRESS_HCOMPRESS) {
+		int datatype = bytepix_ == 1 ? TBYTE : (bytepix_ == 2 ? TUSHORT : TUINT);
+		fits_write_img(fileptr_, datatype, 1, LONGLONG(rows_) * cols_, (void*) data, &status);
+		fits_flush_file(fileptr_, &status);
+		if (!status) {
+			boost::system::error_code ec;
+			info.zipbytes = boost::filesystem::file_size(filepath_, ec);
+		}
+	}
+	else {
+		tiles_.resize((rows_ + tilerows_ - 1) / tilerows_);
+		TileBatchPtr batch = boost::make_shared<TileBatch>((const uint8_t*) data, int(tiles_.size()));
+		int helpers = pool ? pool->Threads() : 0;
+
+		if (helpers > batch->ntile - 1) helpers = batch->ntile - 1;
+		for (i = 0; i < helpers; ++i)
+			pool->Post(boost::bind(&FitsHandler::compress_tiles, this, batch));
+		compress_tiles(this, batch);
+		{// 等待线程池完成已领取的分块
+			boost::unique_lock<boost::mutex> lck(batch->mtx);
+			while (batch->done < batch->ntile) batch->cv.wait(lck);
+		}
+		if (batch->error) {
+			sprintf(errmsg, "failed to compress %d tiles", int(batch->error));
+			return false;
+		}
+		/* 分块按顺序写入表中, 每行一块 */
+		for (i = 0, n = tiles_.size(); i < n && !status; ++i) {
+			fits_write_col(fileptr_, TBYTE, 1, i + 1, 1, tiles_[i].size(), &tiles_[i][0], &status);
+			info.zipbytes += tiles_[i].size();
+		}
+	}
+	info.seconds = bc::duration<double>(bc::steady_clock::now() - tm0).count();
+	if (info.zipbytes) info.ratio = double(info.rawbytes) / info.zipbytes;
+	if (info.seconds > 0.0) info.mbps = info.rawbytes / info.seconds / 1048576.0;
+
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::SetKey(const char *key, const string &value, const char *comment) {
+	return SetKey(key, value.c_str(), comment);
+}
+
+bool FitsHandler::SetKey(const char *key, const char *value, const char *comment) {
+	if (!fileptr_) return false;
+	int status(0);
+	fits_update_key(fileptr_, TSTRING, key, (void*) value, comment, &status);
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::SetKey(const char *key, int value, const char *comment) {
+	if (!fileptr_) return false;
+	int status(0);
+	fits_update_key(fileptr_, TINT, key, &value, comment, &status);
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::SetKey(const char *key, double value, const char *comment) {
+	if (!fileptr_) return false;
+	int status(0);
+	fits_update_key(fileptr_, TDOUBLE, key, &value, comment, &status);
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::SetKey(const char *key, bool value, const char *comment) {
+	if (!fileptr_) return false;
+	int status(0), x(value);
+	fits_update_key(fileptr_, TLOGICAL, key, &x, comment, &status);
+	fill_errmsg(status);
+	return status == 0;
+}
+
+bool FitsHandler::Close() {
+	if (!fileptr_) return false;
+	int status(0);
+	fits_close_file(fileptr_, &status);
+	fileptr_  = NULL;
+	compress_ = FITS_COMPRESS_NONE;
+	fill_errmsg(status);
+	return status == 0;
+}
+
+const char *FitsHandler::GetError() {
+	return errmsg;
+}
+
+int FitsHandler::CompressMethod(const string &name) {
+	if (boost::iequals(name, "RICE"))      return FITS_COMPRESS_RICE;
+	if (boost::iequals(name, "GZIP2"))     return FITS_COMPRESS_GZIP2;
+	if (boost::iequals(name, "HCOMPRESS")) return FITS_COMPRESS_HCOMPRESS;
+	return FITS_COMPRESS_NONE;
+}
+
+void FitsHandler::compress_tiles(FitsHandler *handler, const TileBatchPtr &batch) {
+	bytevec scratch;
+	int ntile = batch->ntile, i;
+
+	while ((i = batch->next++) < ntile) {
+		int rows = handler->tilerows_;
+		int pixels = handler->cols_ * (i == ntile - 1 ? handler->rows_ - i * rows : rows);
+		size_t offset = size_t(i) * handler->cols_ * rows * handler->bytepix_;
+		if (!handler->compress_tile(batch->data + offset, pixels, scratch, handler->tiles_[i])) ++batch->error;
+
+		boost::unique_lock<boost::mutex> lck(batch->mtx);
+		if (++batch->done == ntile) batch->cv.notify_one();
+	}
+}
+
+/*
+ * @note 数据转换:
+ * - 无符号整数减去BZERO, 即翻转最高位, 得到存储值
+ * - RICE_1: 压缩存储值
+ * - GZIP_2: 存储值按大端字节序拆分为字节平面(最高字节在前)后压缩
+ */
+bool FitsHandler::compress_tile(const uint8_t *data, int pixels, bytevec &scratch, bytevec &tile) {
+	int i, len(-1);
+
+	if (compress_ == FITS_COMPRESS_RICE) {
+		tile.resize(size_t(pixels) * bytepix_ + pixels / 16 + 64);
+		if (bytepix_ == 1) {
+			len = fits_rcomp_byte((signed char*) data, pixels, &tile[0], tile.size(), RICE_BLOCKSIZE);
+		}
+		else if (bytepix_ == 2) {
+			const uint16_t *src = (const uint16_t*) data;
+			scratch.resize(size_t(pixels) * 2);
+			short *dst = (short*) &scratch[0];
+			for (i = 0; i < pixels; ++i) dst[i] = short(src[i] ^ 0x8000);
+			len = fits_rcomp_short(dst, pixels, &tile[0], tile.size(), RICE_BLOCKSIZE);
+		}
+		else {
+			const uint32_t *src = (const uint32_t*) data;
+			scratch.resize(size_t(pixels) * 4);
+			int *dst = (int*) &scratch[0];
+			for (i = 0; i < pixels; ++i) dst[i] = int(src[i] ^ 0x80000000);
+			len = fits_rcomp(dst, pixels, &tile[0], tile.size(), RICE_BLOCKSIZE);
+		}
+	}
+	else {
+		const uint8_t *plane = data;
+		if (bytepix_ == 2) {
+			const uint16_t *src = (const uint16_t*) data;
+			scratch.resize(size_t(pixels) * 2);
+			uint8_t *hi = &scratch[0], *lo = hi + pixels;
+			for (i = 0; i < pixels; ++i) {
+				hi[i] = uint8_t((src[i] >> 8) ^ 0x80);
+				lo[i] = uint8_t(src[i]);
+			}
+			plane = &scratch[0];
+		}
+		else if (bytepix_ == 4) {
+			const uint32_t *src = (const uint32_t*) data;
+			scratch.resize(size_t(pixels) * 4);
+			uint8_t *b0 = &scratch[0], *b1 = b0 + pixels, *b2 = b1 + pixels, *b3 = b2 + pixels;
+			for (i = 0; i < pixels; ++i) {
+				b0[i] = uint8_t((src[i] >> 24) ^ 0x80);
+				b1[i] = uint8_t(src[i] >> 16);
+				b2[i] = uint8_t(src[i] >> 8);
+				b3[i] = uint8_t(src[i]);
+			}
+			plane = &scratch[0];
+		}
+
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+		tile.resize(deflateBound(&zs, size_t(pixels) * bytepix_) + 32);
+		zs.next_in   = (Bytef*) plane;
+		zs.avail_in  = size_t(pixels) * bytepix_;
+		zs.next_out  = &tile[0];
+		zs.avail_out = tile.size();
+		if (deflate(&zs, Z_FINISH) == Z_STREAM_END) len = zs.total_out;
+		deflateEnd(&zs);
+	}
+	if (len < 0) return false;
+	tile.resize(len);
+	return true;
+}
 //////////////////////////////////////////////////////////////////////////////
 } /* namespace AstroUtil */
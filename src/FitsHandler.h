@@ -11,21 +11,108 @@
 
 #include <longnam.h>
 #include <fitsio.h>
+#include <stdint.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
 #include <string>
+#include <vector>
 
 using std::string;
 
 namespace AstroUtil {
 //////////////////////////////////////////////////////////////////////////////
+enum FITS_COMPRESS {// 分块压缩算法
+	FITS_COMPRESS_NONE,		//< 不压缩
+	FITS_COMPRESS_RICE,		//< RICE_1
+	FITS_COMPRESS_GZIP2,	//< GZIP_2: 按字节重排后GZIP压缩
+	FITS_COMPRESS_HCOMPRESS	//< HCOMPRESS_1, 无损
+};
+
+/*!
+ * @struct CompressInfo 单帧压缩结果
+ */
+struct CompressInfo {
+	size_t rawbytes;	//< 原始数据量, 量纲: 字节
+	size_t zipbytes;	//< 压缩后数据量, 量纲: 字节
+	double ratio;		//< 压缩比
+	double seconds;		//< 压缩耗时, 量纲: 秒
+	double mbps;		//< 压缩速度, 量纲: MB/秒
+};
+
+/*!
+ * @class CompressPool 分块压缩线程池
+ * @note
+ * - 线程在线程池的生命周期内常驻, 由多个FitsHandler共享, 避免逐帧创建线程
+ * - 调用WriteCompressed()的线程同时参与压缩. 并发压缩的线程总数不超过:
+ *   线程池线程数 + 调用线程数
+ */
+class CompressPool {
+public:
+	/*!
+	 * @param threads 线程数量. <= 0: 使用全部处理器核心
+	 */
+	CompressPool(int threads = 0);
+	virtual ~CompressPool();
+
+protected:
+	boost::asio::io_service ios_;	//< 任务队列
+	boost::asio::io_service::work work_;	//< 维持线程运行
+	boost::thread_group threads_;	//< 压缩线程
+	int count_;		//< 线程数量
+
+public:
+	/*!
+	 * @brief 提交任务
+	 */
+	void Post(const boost::function<void ()> &task);
+	/*!
+	 * @brief 查看线程数量
+	 */
+	int Threads();
+};
+
 class FitsHandler {
 public:
 	FitsHandler();
 	virtual ~FitsHandler();
 
+protected:
+	typedef std::vector<uint8_t> bytevec;
+	typedef std::vector<bytevec> tilevec;
+
+	/*!
+	 * @struct TileBatch 单帧分块压缩任务, 由参与压缩的线程共享
+	 * @note
+	 * 线程池中的任务可能在调用线程返回后才开始执行, 此时已无待压缩分块, 不访问FitsHandler
+	 */
+	struct TileBatch {
+		const uint8_t *data;		//< 图像数据
+		int ntile;					//< 分块数量
+		boost::atomic<int> next;	//< 下一个待压缩分块的索引
+		boost::atomic<int> error;	//< 压缩失败的分块数量
+		int done;					//< 已完成分块数量
+		boost::mutex mtx;			//< 互斥锁: 已完成分块数量
+		boost::condition_variable cv;	//< 事件: 完成全部分块
+
+	public:
+		TileBatch(const uint8_t *_data, int _ntile)
+			: data(_data), ntile(_ntile), next(0), error(0), done(0) {}
+	};
+	typedef boost::shared_ptr<TileBatch> TileBatchPtr;
+
 protected:
 	fitsfile *fileptr_;	//< 文件访问指针
 	int rows_, cols_;	//< 行列数
 	char errmsg[100];	//< 错误提示
+	/* 分块压缩 */
+	string filepath_;	//< 文件路径
+	int compress_;		//< 压缩算法
+	int bytepix_;		//< 单像素字节数
+	int tilerows_;		//< 每个分块的行数
+	tilevec tiles_;		//< 压缩后的分块数据
 
 protected:
 	/*!
@@ -37,6 +124,22 @@ protected:
 	 * @param code cfitsio错误代码
 	 */
 	void fill_errmsg(int code);
+	/*!
+	 * @brief 压缩分块, 直至无待压缩分块
+	 * @param handler  分块所属对象. 仅在领取到分块时访问
+	 * @param batch    压缩任务
+	 */
+	static void compress_tiles(FitsHandler *handler, const TileBatchPtr &batch);
+	/*!
+	 * @brief 压缩单个分块
+	 * @param data     分块在图像中的起始地址
+	 * @param pixels   分块像素数
+	 * @param scratch  数据转换暂存区
+	 * @param tile     压缩后的数据
+	 * @return
+	 * 操作结果
+	 */
+	bool compress_tile(const uint8_t *data, int pixels, bytevec &scratch, bytevec &tile);
 
 public:
 	/*!
@@ -110,6 +213,63 @@ public:
 	 * @return
 	 */
 	bool WriteImage(float *data, int datatype);
+	/*!
+	 * @brief 创建分块压缩的图像型FITS文件, 格式与fpack兼容
+	 * @param filepath  文件路径
+	 * @param bytepix   单像素字节数: 1, 2或4. 数据为无符号整数
+	 * @param width     图像宽度
+	 * @param height    图像高度
+	 * @param method    压缩算法, FITS_COMPRESS
+	 * @param tilerows  每个分块的行数. HCOMPRESS至少16行
+	 * @return
+	 * 操作结果
+	 * @note
+	 * 主HDU不含数据, 压缩图像存储在名为COMPRESSED_IMAGE的二进制表扩展中
+	 */
+	bool CreateCompressed(const char *filepath, int bytepix, int width, int height,
+			int method, int tilerows = 1);
+	/*!
+	 * @brief 压缩并写入图像数据
+	 * @param data     图像数据, 主机字节序的无符号整数
+	 * @param info     压缩结果
+	 * @param pool     压缩线程池. NULL: 仅在调用线程中压缩
+	 * @return
+	 * 操作结果
+	 * @note
+	 * - RICE_1与GZIP_2: 各分块由调用线程与线程池并行压缩后顺序写入
+	 * - HCOMPRESS_1: cfitsio的压缩函数不可重入, 由cfitsio顺序压缩
+	 */
+	bool WriteCompressed(const void *data, CompressInfo &info, CompressPool *pool = NULL);
+	/*!
+	 * @brief 写入或更新当前HDU的关键字
+	 * @param key      关键字
+	 * @param value    数值
+	 * @param comment  注释
+	 * @return
+	 * 操作结果
+	 */
+	bool SetKey(const char *key, const string &value, const char *comment = NULL);
+	bool SetKey(const char *key, const char *value, const char *comment = NULL);
+	bool SetKey(const char *key, int value, const char *comment = NULL);
+	bool SetKey(const char *key, double value, const char *comment = NULL);
+	bool SetKey(const char *key, bool value, const char *comment = NULL);
+	/*!
+	 * @brief 关闭文件
+	 * @return
+	 * 操作结果
+	 */
+	bool Close();
+	/*!
+	 * @brief 查看错误提示
+	 */
+	const char *GetError();
+	/*!
+	 * @brief 由名称查找压缩算法
+	 * @param name 名称: NONE, RICE, GZIP2, HCOMPRESS. 不区分大小写
+	 * @return
+	 * 压缩算法, FITS_COMPRESS. 未定义名称返回FITS_COMPRESS_NONE
+	 */
+	static int CompressMethod(const string &name);
 };
 //////////////////////////////////////////////////////////////////////////////
 } /* namespace AstroUtil */
@@ -0,0 +1,294 @@
+/*!
+ * @file FitsRawWriter.cpp 整型图像数据直接写入FITS文件的接口
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * 文件结构:
+ * - 文件头: 关键字卡片 + END, 以空格填充至2880字节的整数倍
+ * - 数据区: 大端有符号整数, 以0填充至2880字节的整数倍
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "FitsRawWriter.h"
+
+#define FITS_BLOCK	2880	//< FITS逻辑记录长度
+#define FITS_CARD	80		//< 关键字卡片长度
+#define FITS_STRLEN	68		//< 字符串型数值最大长度, 不含引号: 卡片长度 - 关键字与"= "(10) - 引号(2)
+#define IO_ALIGN	4096	//< O_DIRECT对齐长度
+
+namespace AstroUtil {
+//////////////////////////////////////////////////////////////////////////////
+/*!
+ * @brief 写入完整的数据, 处理pwritev()仅写入部分数据的情况
+ */
+static bool write_iov(int fd, struct iovec *iov, int n, off_t offset) {
+	ssize_t rslt;
+
+	while (n > 0) {
+		if ((rslt = pwritev(fd, iov, n, offset)) < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		offset += rslt;
+		while (n > 0 && size_t(rslt) >= iov->iov_len) {
+			rslt -= iov->iov_len;
+			++iov, --n;
+		}
+		if (n > 0) {
+			iov->iov_base = (uint8_t*) iov->iov_base + rslt;
+			iov->iov_len -= rslt;
+		}
+	}
+	return true;
+}
+
+FitsRawWriter::FitsRawWriter() {
+	dirty_    = true;
+	bytepix_  = 0;
+	width_    = height_ = 0;
+	staging_  = NULL;
+	capacity_ = 0;
+	direct_   = true;
+	errmsg_[0] = 0;
+}
+
+FitsRawWriter::~FitsRawWriter() {
+	free(staging_);
+}
+
+bool FitsRawWriter::Create(int bytepix, int width, int height) {
+	if (!(bytepix == 1 || bytepix == 2 || bytepix == 4) || width <= 0 || height <= 0) {
+		snprintf(errmsg_, sizeof(errmsg_), "unsupported image format: %d bytes/pixel, %d x %d",
+				bytepix, width, height);
+		return false;
+	}
+	bytepix_ = bytepix;
+	width_   = width;
+	height_  = height;
+	cards_.clear();
+	SetKey("SIMPLE", true,        "file does conform to FITS standard");
+	SetKey("BITPIX", bytepix * 8, "number of bits per data pixel");
+	SetKey("NAXIS",  2,           "number of data axes");
+	SetKey("NAXIS1", width,       "length of data axis 1");
+	SetKey("NAXIS2", height,      "length of data axis 2");
+	if (bytepix == 2) {
+		SetKey("BZERO",  32768, "offset data range to that of unsigned short");
+		SetKey("BSCALE", 1,     "default scaling factor");
+	}
+	else if (bytepix == 4) {
+		SetKey("BZERO",  int64_t(2147483648LL), "offset data range to that of unsigned long");
+		SetKey("BSCALE", 1,                     "default scaling factor");
+	}
+	return true;
+}
+
+void FitsRawWriter::SetKey(const char *key, const string &value, const char *comment) {
+	string text;
+	for (string::const_iterator it = value.begin(); it != value.end(); ++it) {
+		// 字符串中的单引号需写两次. 超出长度时截断, 保证结尾引号位于卡片内
+		if (text.size() + (*it == '\'' ? 2 : 1) > FITS_STRLEN) break;
+		text += *it;
+		if (*it == '\'') text += '\'';
+	}
+	if (text.size() < 8) text.append(8 - text.size(), ' ');
+	set_card(key, text, true, comment);
+}
+
+void FitsRawWriter::SetKey(const char *key, const char *value, const char *comment) {
+	SetKey(key, string(value), comment);
+}
+
+void FitsRawWriter::SetKey(const char *key, int value, const char *comment) {
+	SetKey(key, int64_t(value), comment);
+}
+
+void FitsRawWriter::SetKey(const char *key, int64_t value, const char *comment) {
+	char text[32];
+	snprintf(text, sizeof(text), "%lld", (long long) value);
+	set_card(key, text, false, comment);
+}
+
+void FitsRawWriter::SetKey(const char *key, double value, const char *comment) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.15G", value);
+	if (!strpbrk(text, ".EN")) strcat(text, ".");	// 区分整数与浮点数
+	set_card(key, text, false, comment);
+}
+
+void FitsRawWriter::SetKey(const char *key, bool value, const char *comment) {
+	set_card(key, value ? "T" : "F", false, comment);
+}
+
+void FitsRawWriter::SetDirect(bool direct) {
+	direct_ = direct;
+}
+
+/*
+ * @note 写入流程:
+ * - 在暂存区中完成字节序转换与填充, 不修改相机数据
+ * - O_DIRECT: 文件头复制到暂存区起始位置, 以页对齐长度一次写入, 再截断至FITS文件长度
+ * - 缓冲写入: 文件头与暂存区数据以pwritev()一次提交
+ */
+bool FitsRawWriter::Write(const char *filepath, const void *data) {
+	if (!bytepix_) {
+		strcpy(errmsg_, "image format was not defined");
+		return false;
+	}
+	if (dirty_) render_header();
+
+	size_t hdrbytes  = header_.size();
+	size_t pixels    = size_t(width_) * height_;
+	size_t databytes = pixels * bytepix_;
+	size_t filebytes = hdrbytes + (databytes + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+	size_t iobytes   = (filebytes + IO_ALIGN - 1) / IO_ALIGN * IO_ALIGN;
+	if (!reserve(iobytes)) return false;
+
+	uint8_t *pdata = staging_ + hdrbytes;
+	ToBigEndian(data, pdata, pixels, bytepix_);
+	memset(pdata + databytes, 0, iobytes - hdrbytes - databytes);
+
+	int fd(-1);
+	bool direct(false), rslt(false);
+	if (direct_ && (fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644)) >= 0)
+		direct = true;
+	else if ((fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return fail("open", filepath);
+
+	if (direct) {
+		struct iovec iov = { staging_, iobytes };
+		memcpy(staging_, header_.data(), hdrbytes);
+		if (write_iov(fd, &iov, 1, 0)) rslt = ftruncate(fd, filebytes) == 0;
+		else if (errno == EINVAL) {// 文件系统不支持O_DIRECT
+			direct_ = false;
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			direct  = false;
+		}
+	}
+	if (!direct) {
+		struct iovec iov[2] = {
+			{ (void*) header_.data(), hdrbytes },
+			{ pdata, filebytes - hdrbytes }
+		};
+		rslt = write_iov(fd, iov, 2, 0);
+	}
+	if (!rslt) fail("write", filepath);
+	if (close(fd) && rslt) rslt = fail("close", filepath);
+	return rslt;
+}
+
+const char *FitsRawWriter::GetError() {
+	return errmsg_;
+}
+
+void FitsRawWriter::ToBigEndian(const void *src, void *dst, size_t pixels, int bytepix) {
+	size_t i(0);
+
+	if (bytepix == 1) {
+		if (src != dst) memcpy(dst, src, pixels);
+	}
+	else if (bytepix == 2) {
+		const uint16_t *s = (const uint16_t*) src;
+		uint16_t *d = (uint16_t*) dst;
+#if defined(__AVX2__)
+		const __m256i bz = _mm256_set1_epi16(short(0x8000));
+		for (; i + 16 <= pixels; i += 16) {
+			__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (s + i)), bz);
+			v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+			_mm256_storeu_si256((__m256i*) (d + i), v);
+		}
+#elif defined(__SSE2__)
+		const __m128i bz = _mm_set1_epi16(short(0x8000));
+		for (; i + 8 <= pixels; i += 8) {
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s + i)), bz);
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			_mm_storeu_si128((__m128i*) (d + i), v);
+		}
+#endif
+		for (; i < pixels; ++i) {
+			uint16_t v = s[i] ^ 0x8000;
+			d[i] = uint16_t((v << 8) | (v >> 8));
+		}
+	}
+	else if (bytepix == 4) {
+		const uint32_t *s = (const uint32_t*) src;
+		uint32_t *d = (uint32_t*) dst;
+#if defined(__SSE2__)
+		const __m128i bz = _mm_set1_epi32(int(0x80000000));
+		for (; i + 4 <= pixels; i += 4) {
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (s + i)), bz);
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));	// 交换16位字中的字节
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);	// 交换32位字中的16位字
+			_mm_storeu_si128((__m128i*) (d + i), v);
+		}
+#endif
+		for (; i < pixels; ++i) d[i] = __builtin_bswap32(s[i] ^ 0x80000000);
+	}
+}
+
+void FitsRawWriter::set_card(const char *key, const string &value, bool quoted, const char *comment) {
+	char name[9];
+	string card;
+	int i;
+
+	for (i = 0; i < 8 && key[i]; ++i) name[i] = toupper(key[i]);
+	for (; i < 8; ++i) name[i] = ' ';
+	name[8] = 0;
+	card = name;
+	card += "= ";
+	if (quoted) card += "'" + value + "'";
+	else {
+		if (value.size() < 20) card.append(20 - value.size(), ' ');	// 数值右对齐至第30列
+		card += value;
+	}
+	if (comment && comment[0]) {
+		card += " / ";
+		card += comment;
+	}
+	card.resize(FITS_CARD, ' ');	// 仅截断注释: 字符串型数值已限制在FITS_STRLEN以内
+
+	cardvec::iterator it;
+	for (it = cards_.begin(); it != cards_.end() && it->compare(0, 8, name) != 0; ++it);
+	if (it != cards_.end()) *it = card;
+	else cards_.push_back(card);
+	dirty_ = true;
+}
+
+void FitsRawWriter::render_header() {
+	header_.clear();
+	for (cardvec::iterator it = cards_.begin(); it != cards_.end(); ++it) header_ += *it;
+	header_ += "END";
+	header_.resize((header_.size() + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK, ' ');
+	dirty_ = false;
+}
+
+bool FitsRawWriter::reserve(size_t bytes) {
+	if (bytes <= capacity_) return true;
+	void *ptr;
+	if (posix_memalign(&ptr, IO_ALIGN, bytes)) {
+		strcpy(errmsg_, "failed to allocate staging buffer");
+		return false;
+	}
+	free(staging_);
+	staging_  = (uint8_t*) ptr;
+	capacity_ = bytes;
+	return true;
+}
+
+bool FitsRawWriter::fail(const char *what, const char *filepath) {
+	snprintf(errmsg_, sizeof(errmsg_), "%s <%s>: %s", what, filepath, strerror(errno));
+	return false;
+}
+//////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
@@ -0,0 +1,129 @@
+/*!
+ * @file FitsRawWriter.h 整型图像数据直接写入FITS文件的接口
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 不经过cfitsio的缓冲区与类型转换, 用于高帧频、大幅面图像的存储
+ * - 文件头以80字节关键字卡片预先生成, 修改关键字时仅替换对应卡片
+ * - 字节序转换与BZERO偏置在一次遍历中完成(SSE2/AVX2), 结果写入对齐的暂存区
+ * - 优先以O_DIRECT写入, 文件系统不支持时改用pwritev()
+ * - 生成的文件符合FITS标准, 可由cfitsio读取
+ */
+
+#ifndef FITSRAWWRITER_H_
+#define FITSRAWWRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace AstroUtil {
+//////////////////////////////////////////////////////////////////////////////
+class FitsRawWriter {
+public:
+	FitsRawWriter();
+	virtual ~FitsRawWriter();
+
+protected:
+	typedef std::vector<string> cardvec;
+
+protected:
+	cardvec cards_;		//< 关键字卡片, 每张卡片80字节, 不含END
+	string header_;		//< 文件头, 长度为2880字节的整数倍
+	bool dirty_;		//< 关键字已修改, 需重新生成文件头
+	int bytepix_;		//< 单像素字节数
+	int width_, height_;	//< 图像尺寸
+	uint8_t *staging_;	//< 暂存区, 按页对齐: 文件头 + 数据 + 填充
+	size_t capacity_;	//< 暂存区容量, 量纲: 字节
+	bool direct_;		//< 尝试以O_DIRECT写入
+	char errmsg_[128];	//< 错误提示
+
+public:
+	/*!
+	 * @brief 定义图像格式, 生成基本关键字
+	 * @param bytepix 单像素字节数. 1: BITPIX=8; 2: BITPIX=16, BZERO=32768; 4: BITPIX=32, BZERO=2147483648
+	 * @param width   图像宽度
+	 * @param height  图像高度
+	 * @return
+	 * 图像格式有效性
+	 * @note
+	 * 清除已有的其它关键字
+	 */
+	bool Create(int bytepix, int width, int height);
+	/*!
+	 * @brief 添加或修改字符串型关键字
+	 * @param key      关键字, 长度不超过8字符
+	 * @param value    数值. 单引号转义后超出68字符时截断
+	 * @param comment  注释. 超出卡片长度的部分被截断
+	 */
+	void SetKey(const char *key, const string &value, const char *comment = NULL);
+	void SetKey(const char *key, const char *value, const char *comment = NULL);
+	/*!
+	 * @brief 添加或修改整数型关键字
+	 */
+	void SetKey(const char *key, int64_t value, const char *comment = NULL);
+	void SetKey(const char *key, int value, const char *comment = NULL);
+	/*!
+	 * @brief 添加或修改浮点型关键字
+	 */
+	void SetKey(const char *key, double value, const char *comment = NULL);
+	/*!
+	 * @brief 添加或修改逻辑型关键字
+	 */
+	void SetKey(const char *key, bool value, const char *comment = NULL);
+	/*!
+	 * @brief 设置是否尝试以O_DIRECT写入
+	 */
+	void SetDirect(bool direct);
+	/*!
+	 * @brief 将图像数据写入文件
+	 * @param filepath  文件路径. 文件已存在时覆盖
+	 * @param data      图像数据, 主机字节序的无符号整数
+	 * @return
+	 * 操作结果
+	 */
+	bool Write(const char *filepath, const void *data);
+	/*!
+	 * @brief 查看错误提示
+	 */
+	const char *GetError();
+	/*!
+	 * @brief 将主机字节序的无符号整数转换为带BZERO偏置的大端有符号整数
+	 * @param src      源数据
+	 * @param dst      目标数据. 可与src相同
+	 * @param pixels   像素数
+	 * @param bytepix  单像素字节数
+	 */
+	static void ToBigEndian(const void *src, void *dst, size_t pixels, int bytepix);
+
+protected:
+	/*!
+	 * @brief 以固定格式生成关键字卡片, 并替换同名卡片或添加至末尾
+	 * @param key      关键字
+	 * @param value    已格式化的数值
+	 * @param quoted   数值是否为字符串
+	 * @param comment  注释
+	 */
+	void set_card(const char *key, const string &value, bool quoted, const char *comment);
+	/*!
+	 * @brief 由关键字卡片生成文件头
+	 */
+	void render_header();
+	/*!
+	 * @brief 检查并扩充暂存区
+	 * @param bytes 所需容量
+	 * @return
+	 * 操作结果
+	 */
+	bool reserve(size_t bytes);
+	/*!
+	 * @brief 记录系统调用错误
+	 */
+	bool fail(const char *what, const char *filepath);
+};
+//////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
+
+#endif /* FITSRAWWRITER_H_ */
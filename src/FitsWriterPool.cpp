@@ -0,0 +1,213 @@
+/*!
+ * @file FitsWriterPool.cpp 异步FITS文件存储线程池定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ */
+
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include "FitsWriterPool.h"
+
+FitsWriterPool::FitsWriterPool() {
+	running_ = false;
+	depth_   = 0;
+	direct_  = true;
+	zipmethod_  = AstroUtil::FITS_COMPRESS_NONE;
+	ziptile_    = 1;
+	zipthreads_ = 0;
+	memset(&metrics_, 0, sizeof(metrics_));
+}
+
+FitsWriterPool::~FitsWriterPool() {
+	Stop();
+}
+
+bool FitsWriterPool::Start(int threads, int depth, bool direct) {
+	if (running_ || threads <= 0 || depth <= 0) return false;
+	depth_   = depth;
+	direct_  = direct;
+	running_ = true;
+	if (IsCompressed() && zipmethod_ != AstroUtil::FITS_COMPRESS_HCOMPRESS)
+		zippool_ = boost::make_shared<AstroUtil::CompressPool>(zipthreads_);
+	for (int i = 0; i < threads; ++i)
+		workers_.create_thread(boost::bind(&FitsWriterPool::thread_write, this));
+	return true;
+}
+
+void FitsWriterPool::SetCompress(int method, int tilerows, int threads) {
+	if (running_) return;
+	zipmethod_  = method;
+	ziptile_    = tilerows;
+	zipthreads_ = threads;
+}
+
+bool FitsWriterPool::IsCompressed() {
+	return zipmethod_ != AstroUtil::FITS_COMPRESS_NONE;
+}
+
+void FitsWriterPool::Stop() {
+	{
+		mutex_lock lck(mtxjob_);
+		if (!running_) return;
+		running_ = false;
+		cvjob_.notify_all();
+		cvspace_.notify_all();
+	}
+	workers_.join_all();
+	zippool_.reset();
+}
+
+bool FitsWriterPool::Submit(const CameraBase::ImgFrmPtr &frame, const string &filepath) {
+	mutex_lock lck(mtxjob_);
+	if (running_ && int(jobs_.size()) >= depth_) {
+		++metrics_.stalls;
+		while (running_ && int(jobs_.size()) >= depth_) cvspace_.wait(lck);
+	}
+	if (!running_) return false;
+
+	WriteJob job;
+	job.frame    = frame;
+	job.filepath = filepath;
+	jobs_.push_back(job);
+	metrics_.depth = jobs_.size();
+	if (metrics_.depth > metrics_.maxdepth) metrics_.maxdepth = metrics_.depth;
+	cvjob_.notify_one();
+	return true;
+}
+
+void FitsWriterPool::SetKey(const string &key, const string &value) {
+	mutex_lock lck(mtxkey_);
+	keyvec::iterator it;
+	for (it = keys_.begin(); it != keys_.end() && it->first != key; ++it);
+	if (it != keys_.end()) it->second = value;
+	else keys_.push_back(keypair(key, value));
+}
+
+void FitsWriterPool::RegisterWriteProc(const WrtProcSlot &slot) {
+	cbwrt_.connect(slot);
+}
+
+FitsWriterPool::WriterMetrics FitsWriterPool::GetMetrics() {
+	mutex_lock lck(mtxjob_);
+	return metrics_;
+}
+
+string FitsWriterPool::Summary() {
+	WriterMetrics metrics = GetMetrics();
+	LatencyInfo info;
+	boost::format fmt("\t queue    : depth = %d, max = %d, writing = %d, stalls = %llu\n"
+			"\t files    : written = %llu, failed = %llu, %.1f MB\n");
+	fmt % metrics.depth % metrics.maxdepth % metrics.inflight % metrics.stalls
+		% metrics.written % metrics.failed % metrics.mbytes;
+	string text = fmt.str();
+	if (IsCompressed() && metrics.written) {
+		boost::format fmt2("\t compress : ratio = %.2f (%.2f), speed = %.1f MB/s, %.1f MB\n");
+		fmt2 % metrics.ratio % (metrics.zipmbytes > 0.0 ? metrics.mbytes / metrics.zipmbytes : 0.0)
+			% metrics.mbps % metrics.zipmbytes;
+		text += fmt2.str();
+	}
+	if (latency_.Query(LATI_WRITE, info)) {
+		boost::format fmt1("\t latency  : p50 = %.2f, p99 = %.2f, max = %.2f (%.2f) ms\n");
+		fmt1 % info.p50 % info.p99 % info.max % info.maxall;
+		text += fmt1.str();
+	}
+	return text;
+}
+
+void FitsWriterPool::thread_write() {
+	namespace bc = boost::chrono;
+	AstroUtil::FitsRawWriter writer;	// 每个线程独立的暂存区
+	AstroUtil::FitsHandler fits;
+	AstroUtil::CompressInfo info;
+	WriteJob job;
+	string errmsg;
+	bool rslt;
+
+	writer.SetDirect(direct_);
+	while (1) {
+		{// 等待任务
+			mutex_lock lck(mtxjob_);
+			while (running_ && jobs_.empty()) cvjob_.wait(lck);
+			if (jobs_.empty()) break;	// 已停止且队列已清空
+			job = jobs_.front();
+			jobs_.pop_front();
+			metrics_.depth = jobs_.size();
+			++metrics_.inflight;
+			cvspace_.notify_one();
+		}
+
+		bc::steady_clock::time_point tm0 = bc::steady_clock::now();
+		errmsg.clear();
+		if (IsCompressed()) rslt = write_compressed(fits, job, info, errmsg);
+		else rslt = write_frame(writer, job, errmsg);
+		if (rslt) job.frame->timeline.Mark(LAT_WRITTEN);
+		bc::duration<double, boost::milli> dt = bc::steady_clock::now() - tm0;
+		latency_.Record(LATI_WRITE, dt.count());
+		{
+			mutex_lock lck(mtxjob_);
+			--metrics_.inflight;
+			if (rslt) {
+				++metrics_.written;
+				metrics_.mbytes += job.frame->Bytes() / 1048576.0;
+				if (IsCompressed()) {
+					metrics_.zipmbytes += info.zipbytes / 1048576.0;
+					metrics_.ratio = info.ratio;
+					metrics_.mbps  = info.mbps;
+				}
+			}
+			else ++metrics_.failed;
+		}
+		cbwrt_(job.frame, job.filepath, errmsg);
+		job.frame.reset();	// 释放引用, 以使该帧可用于后续读出
+	}
+}
+
+bool FitsWriterPool::create_directory(WriteJob &job, string &errmsg) {
+	namespace fs = boost::filesystem;
+	boost::system::error_code ec;
+	fs::path parent = fs::path(job.filepath).parent_path();
+
+	if (!parent.empty() && !fs::exists(parent, ec) && !fs::create_directories(parent, ec)) {
+		errmsg = "failed to create directory <" + parent.string() + ">: " + ec.message();
+		return false;
+	}
+	return true;
+}
+
+bool FitsWriterPool::write_frame(AstroUtil::FitsRawWriter &writer, WriteJob &job, string &errmsg) {
+	CameraBase::ImageFrame &frame = *job.frame;
+
+	if (!create_directory(job, errmsg)) return false;
+	if (!writer.Create(frame.bytepix, frame.roi.Width(), frame.roi.Height())) {
+		errmsg = writer.GetError();
+		return false;
+	}
+	add_keys(writer, frame);
+	if (!writer.Write(job.filepath.c_str(), frame.data.get())) {
+		errmsg = writer.GetError();
+		return false;
+	}
+	return true;
+}
+
+bool FitsWriterPool::write_compressed(AstroUtil::FitsHandler &fits, WriteJob &job,
+		AstroUtil::CompressInfo &info, string &errmsg) {
+	CameraBase::ImageFrame &frame = *job.frame;
+	string filepath = "!" + job.filepath;	// cfitsio: 覆盖同名文件
+
+	if (!create_directory(job, errmsg)) return false;
+	if (!fits.CreateCompressed(filepath.c_str(), frame.bytepix, frame.roi.Width(), frame.roi.Height(),
+			zipmethod_, ziptile_)) {
+		errmsg = fits.GetError();
+		fits.Close();
+		return false;
+	}
+	add_keys(fits, frame);
+	bool rslt = fits.WriteCompressed(frame.data.get(), info, zippool_.get());
+	if (!rslt) errmsg = fits.GetError();
+	if (!fits.Close() && rslt) {
+		errmsg = fits.GetError();
+		rslt = false;
+	}
+	return rslt;
+}
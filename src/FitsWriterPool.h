@@ -0,0 +1,217 @@
+/*!
+ * @file FitsWriterPool.h 异步FITS文件存储线程池声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 已完成读出的帧进入有界队列, 由多个存储线程写入FITS文件
+ * - 队列满时Submit()阻塞, 使用者持有的帧不被释放, 序列曝光因无空闲帧而等待, 不丢弃图像
+ * - 统计队列深度、队列满次数与单帧存储耗时
+ * - 可选分块压缩(RICE_1/GZIP_2/HCOMPRESS_1), 由FitsHandler生成文件, 统计压缩比与速度
+ */
+
+#ifndef SRC_FITSWRITERPOOL_H_
+#define SRC_FITSWRITERPOOL_H_
+
+#include <boost/noncopyable.hpp>
+#include <utility>
+#include "CameraBase.h"
+#include "LatencyStat.h"
+#include "FitsRawWriter.h"
+#include "FitsHandler.h"
+
+class FitsWriterPool : private boost::noncopyable {
+public:
+	FitsWriterPool();
+	virtual ~FitsWriterPool();
+
+public:
+	/* 声明数据类型 */
+	/*!
+	 * @struct WriteJob 存储任务
+	 */
+	struct WriteJob {
+		CameraBase::ImgFrmPtr frame;	//< 帧
+		string filepath;				//< 文件路径
+	};
+	typedef std::deque<WriteJob> WriteJobQue;
+
+	/*!
+	 * @struct WriterMetrics 存储统计
+	 */
+	struct WriterMetrics {
+		int depth;			//< 当前队列深度
+		int maxdepth;		//< 最大队列深度
+		int inflight;		//< 正在存储的帧数
+		uint64_t written;	//< 已存储帧数
+		uint64_t failed;	//< 存储失败帧数
+		uint64_t stalls;	//< 队列满导致Submit()等待的次数
+		double mbytes;		//< 已存储数据量, 量纲: MB
+		double zipmbytes;	//< 压缩后数据量, 量纲: MB
+		double ratio;		//< 最近一帧的压缩比
+		double mbps;		//< 最近一帧的压缩速度, 量纲: MB/秒
+	};
+
+	/*!
+	 * @brief 声明存储完成插槽函数
+	 * @param <1> 帧
+	 * @param <2> 文件路径
+	 * @param <3> 错误提示. 空字符串表示存储成功
+	 * @note
+	 * 在存储线程中调用
+	 */
+	typedef boost::signals2::signal<void (const CameraBase::ImgFrmPtr&, const string&, const string&)> WriteProcess;
+	typedef WriteProcess::slot_type WrtProcSlot;
+	typedef std::pair<string, string> keypair;
+	typedef std::vector<keypair> keyvec;
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	/* 成员变量 */
+	bool running_;		//< 线程池运行标志
+	int depth_;			//< 队列容量
+	bool direct_;		//< 尝试以O_DIRECT写入
+	int zipmethod_;		//< 压缩算法, AstroUtil::FITS_COMPRESS
+	int ziptile_;		//< 压缩分块的行数
+	int zipthreads_;	//< 压缩线程池的线程数量
+	boost::shared_ptr<AstroUtil::CompressPool> zippool_;	//< 压缩线程池, 由全部存储线程共享
+	WriteJobQue jobs_;	//< 存储任务队列
+	WriterMetrics metrics_;	//< 存储统计
+	LatencyStat latency_;	//< 单帧存储耗时
+	keyvec keys_;		//< 附加的FITS关键字
+	WriteProcess cbwrt_;	//< 存储完成插槽函数
+	boost::thread_group workers_;	//< 存储线程
+	boost::mutex mtxjob_;	//< 互斥锁: 任务队列
+	boost::mutex mtxkey_;	//< 互斥锁: 附加关键字
+	boost::condition_variable cvjob_;	//< 事件: 队列中加入任务
+	boost::condition_variable cvspace_;	//< 事件: 队列中出现空位
+
+public:
+	/*!
+	 * @brief 启动存储线程
+	 * @param threads  线程数量
+	 * @param depth    队列容量
+	 * @param direct   尝试以O_DIRECT写入
+	 * @return
+	 * 操作结果
+	 */
+	bool Start(int threads, int depth, bool direct = true);
+	/*!
+	 * @brief 设置分块压缩参数
+	 * @param method   压缩算法, AstroUtil::FITS_COMPRESS
+	 * @param tilerows 每个分块的行数
+	 * @param threads  压缩线程池的线程数量, 由全部存储线程共享. <= 0: 使用全部处理器核心
+	 * @note
+	 * 在Start()之前调用
+	 */
+	void SetCompress(int method, int tilerows = 1, int threads = 0);
+	/*!
+	 * @brief 检查是否压缩存储
+	 */
+	bool IsCompressed();
+	/*!
+	 * @brief 完成队列中的任务后停止存储线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 提交存储任务
+	 * @param frame     帧
+	 * @param filepath  文件路径. 目录不存在时自动创建
+	 * @return
+	 * 任务加入队列标志. 线程池未运行时返回false
+	 * @note
+	 * 队列满时阻塞, 直至出现空位
+	 */
+	bool Submit(const CameraBase::ImgFrmPtr &frame, const string &filepath);
+	/*!
+	 * @brief 设置附加的字符串型FITS关键字, 写入后续所有文件
+	 * @param key    关键字
+	 * @param value  数值
+	 */
+	void SetKey(const string &key, const string &value);
+	/*!
+	 * @brief 注册存储完成回调函数
+	 * @param slot 函数插槽
+	 */
+	void RegisterWriteProc(const WrtProcSlot &slot);
+	/*!
+	 * @brief 查看存储统计
+	 */
+	WriterMetrics GetMetrics();
+	/*!
+	 * @brief 生成存储统计的文本
+	 */
+	string Summary();
+
+protected:
+	/*!
+	 * @brief 线程: 从队列中取出任务并存储
+	 */
+	void thread_write();
+	/*!
+	 * @brief 检查并创建文件所在目录
+	 */
+	bool create_directory(WriteJob &job, string &errmsg);
+	/*!
+	 * @brief 将帧写入FITS文件
+	 * @param writer  FITS文件写入接口
+	 * @param job     存储任务
+	 * @param errmsg  错误提示
+	 * @return
+	 * 操作结果
+	 */
+	bool write_frame(AstroUtil::FitsRawWriter &writer, WriteJob &job, string &errmsg);
+	/*!
+	 * @brief 将帧压缩后写入FITS文件
+	 * @param fits    FITS文件访问接口
+	 * @param job     存储任务
+	 * @param info    压缩结果
+	 * @param errmsg  错误提示
+	 * @return
+	 * 操作结果
+	 */
+	bool write_compressed(AstroUtil::FitsHandler &fits, WriteJob &job, AstroUtil::CompressInfo &info, string &errmsg);
+	/*!
+	 * @brief 写入帧的观测信息与附加关键字
+	 * @param writer  FitsRawWriter或FitsHandler
+	 * @param frame   帧
+	 */
+	template <class Writer>
+	void add_keys(Writer &writer, CameraBase::ImageFrame &frame) {
+		string dateobs = to_iso_extended_string(frame.tmobs.date());
+		writer.SetKey("DATE-OBS", dateobs, "UTC date of begin observation");
+		writer.SetKey("TIME-OBS", to_simple_string(frame.tmobs.time_of_day()), "UTC time of begin observation");
+		writer.SetKey("TIME-END", to_simple_string(frame.tmend.time_of_day()), "UTC time of end observation");
+		writer.SetKey("EXPTIME",  double(frame.exptm), "exposure duration in seconds");
+		writer.SetKey("FRAMENO",  int(frame.id),       "frame number");
+		if (frame.seqno) writer.SetKey("SEQNO", frame.seqno, "frame number in sequence");
+		writer.SetKey("XBINNING", frame.roi.binX,   "binning factor along X");
+		writer.SetKey("YBINNING", frame.roi.binY,   "binning factor along Y");
+		writer.SetKey("XORGSUBF", frame.roi.startX, "subframe origin along X");
+		writer.SetKey("YORGSUBF", frame.roi.startY, "subframe origin along Y");
+		if (frame.stat.valid) {
+			FrameStat &stat = frame.stat;
+			writer.SetKey("DATAMIN",  double(stat.minv),     "minimum pixel value");
+			writer.SetKey("DATAMAX",  double(stat.maxv),     "maximum pixel value");
+			writer.SetKey("DATAMEAN", stat.mean,             "mean pixel value");
+			writer.SetKey("DATAMED",  double(stat.median),   "median pixel value");
+			writer.SetKey("DATASIG",  stat.sigma,            "standard deviation of pixel values");
+			writer.SetKey("SATURATE", double(stat.satlevel), "saturation level");
+			writer.SetKey("NSATPIX",  int(stat.saturated),   "number of saturated pixels");
+		}
+		if (frame.transfer.packets) {
+			CameraBase::FrameTransfer &xfer = frame.transfer;
+			writer.SetKey("PKTLOST",  int(xfer.lost),      "packets lost in first transmission");
+			writer.SetKey("PKTRECOV", int(xfer.recovered), "packets recovered by resend");
+			writer.SetKey("PKTRSND",  int(xfer.requests),  "packet resend requests");
+			writer.SetKey("PKTDELAY", int(xfer.delay),     "inter-packet delay(GevSCPD) in ticks");
+		}
+
+		mutex_lock lck(mtxkey_);
+		for (keyvec::iterator it = keys_.begin(); it != keys_.end(); ++it)
+			writer.SetKey(it->first.c_str(), it->second);
+	}
+};
+typedef boost::shared_ptr<FitsWriterPool> FitsWriterPoolPtr;
+
+#endif /* SRC_FITSWRITERPOOL_H_ */
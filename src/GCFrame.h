@@ -0,0 +1,77 @@
+/*!
+ * @file GCFrame.h 与总控服务器(gtoaes)通信的二进制帧格式
+ * @version 0.1
+ * @date 2026-10-17
+ * @note
+ * - 连接建立后默认采用ASCII模式: 每条信息以换行符结束
+ * - 客户端发送GC_HELLO请求二进制模式. 支持该模式的服务器以同样内容应答, 并在应答的换行符后
+ *   改用二进制帧; 其它应答或无应答时保持ASCII模式, 兼容旧版服务器
+ * - 二进制帧: 固定长度帧头 + 负载. 帧头字段采用网络字节序:
+ *   [0, 1]  : 标识符 GC_FRAME_MAGIC
+ *   [2, 3]  : 帧类型 GC_FRAME_TYPE
+ *   [4, 7]  : 序列号, 双方各自从0开始递增
+ *   [8, 11] : 负载长度, 量纲: 字节
+ * - 负载直接在接收缓冲区中就地解析, 不拷贝
+ */
+
+#ifndef SRC_GCFRAME_H_
+#define SRC_GCFRAME_H_
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <string.h>
+#include "tcpasio.h"
+
+#define GC_HELLO			"hello framing=binary, version=1\n"	//< 二进制模式协商信息
+#define GC_FRAME_MAGIC		0x4743		//< 帧标识符: "GC"
+#define GC_HEADER_SIZE		12			//< 帧头长度, 量纲: 字节
+#define GC_FRAME_MAX		(1 << 20)	//< 最大负载长度, 量纲: 字节
+#define GC_BUFF_SIZE		(GC_FRAME_MAX + GC_HEADER_SIZE + TCP_PACK_SIZE)	//< 二进制模式收发缓冲区容量
+
+enum GC_FRAME_TYPE {// 帧类型
+	GC_FRAME_TEXT = 1,	//< 文本协议, 语法与ASCII模式相同, 不含换行符
+	GC_FRAME_PLAN,		//< 观测计划
+	GC_FRAME_TARGET,	//< 目标列表
+	GC_FRAME_ROI		//< 感兴趣区集合
+};
+
+/*!
+ * @struct GCFrameHeader 帧头
+ */
+struct GCFrameHeader {
+	uint16_t magic;		//< 标识符
+	uint16_t type;		//< 帧类型
+	uint32_t seq;		//< 序列号
+	uint32_t length;	//< 负载长度
+
+public:
+	/*!
+	 * @brief 从接收缓冲区解析帧头
+	 * @param buff 帧头首地址, 不要求对齐
+	 * @return
+	 * 标识符与负载长度是否有效
+	 */
+	bool Decode(const char* buff) {
+		uint16_t v16[2];
+		uint32_t v32[2];
+		memcpy(v16, buff, 4);
+		memcpy(v32, buff + 4, 8);
+		magic  = ntohs(v16[0]);
+		type   = ntohs(v16[1]);
+		seq    = ntohl(v32[0]);
+		length = ntohl(v32[1]);
+		return magic == GC_FRAME_MAGIC && length <= GC_FRAME_MAX;
+	}
+	/*!
+	 * @brief 生成帧头
+	 * @param buff 输出存储区, 长度不小于GC_HEADER_SIZE
+	 */
+	void Encode(char* buff) const {
+		uint16_t v16[] = { htons(GC_FRAME_MAGIC), htons(type) };
+		uint32_t v32[] = { htonl(seq), htonl(length) };
+		memcpy(buff, v16, 4);
+		memcpy(buff + 4, v32, 8);
+	}
+};
+
+#endif /* SRC_GCFRAME_H_ */
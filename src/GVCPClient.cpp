@@ -0,0 +1,299 @@
+/*!
+ * @file GVCPClient.cpp GigE-Vision控制协议(GVCP)客户端定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * GVCP指令帧包头(8字节, 网络字节序):
+ * - [0]   : 0x42
+ * - [1]   : 标志. 0x01: 需要应答
+ * - [2, 3]: 指令
+ * - [4, 5]: 数据长度
+ * - [6, 7]: 序列号
+ * 应答帧包头:
+ * - [0, 1]: 状态
+ * - [2, 3]: 应答指令
+ * - [4, 5]: 数据长度
+ * - [6, 7]: 对应指令的序列号
+ */
+
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/make_shared.hpp>
+#include <string.h>
+#include "GVCPClient.h"
+
+namespace bc = boost::chrono;
+
+GVCPClient::GVCPClient() {
+	msgcnt_ = 0;
+	window_ = GVCP_WINDOW;
+	memset(&metrics_, 0, sizeof(metrics_));
+}
+
+GVCPClient::~GVCPClient() {
+	Close();
+}
+
+void GVCPClient::Open(const string &ip, uint16_t port, const IOExecPtr &exec) {
+	remote_ = udp::endpoint(boost::asio::ip::address_v4::from_string(ip), port);
+
+	mutex_lock lck(mtxpend_);
+	udp_ = makeudp_session(0, exec);
+	udp_->RegisterRead(boost::bind(&GVCPClient::handle_read, this, _1, _2));
+	udp_->Connect(ip.c_str(), port);
+}
+
+void GVCPClient::Close() {
+	UdpPtr udp;
+	{
+		mutex_lock lck(mtxpend_);
+		udp.swap(udp_);
+		cvack_.notify_all();
+		cvslot_.notify_all();
+	}
+	if (udp.use_count()) udp->Close();
+}
+
+void GVCPClient::SetWindow(int window) {
+	mutex_lock lck(mtxpend_);
+	window_ = window > 0 ? window : 1;
+}
+
+bool GVCPClient::Transact(uint16_t cmd, uint16_t ack, const void *payload, int len, bytevec &reply,
+		int timeout, int retries) {
+	std::vector<ReqPtr> reqs(1, make_request(cmd, ack, payload, len, true));
+	ReqPtr req = reqs[0];
+	if (!submit(reqs, timeout * (retries + 1))) return false;
+	if (!wait(req, timeout, retries)) {
+		set_error((boost::format("command<%04X> timed out") % cmd).str());
+		return false;
+	}
+	reply.swap(req->reply);
+	return true;
+}
+
+void GVCPClient::Send(uint16_t cmd, const void *payload, int len) {
+	std::vector<ReqPtr> reqs(1, make_request(cmd, 0, payload, len, false));
+	submit(reqs, 0);
+}
+
+bool GVCPClient::ReadRegs(const uint32_t *addr, uint32_t *val, int n, int timeout, int retries) {
+	const int maxcnt = GVCP_MAX_PAYLOAD / 4;
+	std::vector<ReqPtr> reqs;
+	int i, j, k, group, cnt;
+	uint32_t buff[maxcnt];
+
+	// 按窗口分组: 组内请求并行发出, 再依次等待
+	for (i = 0; i < n; i += group) {
+		reqs.clear();
+		for (group = 0, j = i; j < n && int(reqs.size()) < window_; j += cnt, group += cnt) {
+			cnt = n - j < maxcnt ? n - j : maxcnt;
+			for (k = 0; k < cnt; ++k) buff[k] = htonl(addr[j + k]);
+			reqs.push_back(make_request(GVCP_READREG_CMD, GVCP_READREG_ACK, buff, cnt * 4, true));
+		}
+		if (!submit(reqs, timeout * (retries + 1))) return false;
+		for (j = i, k = 0; k < int(reqs.size()); ++k) {
+			ReqPtr req = reqs[k];
+			cnt = (req->packet.size() - GVCP_HEADER_SIZE) / 4;
+			if (!wait(req, timeout, retries)) {
+				set_error((boost::format("read register<%0X>: timed out") % addr[j]).str());
+				release(reqs);
+				return false;
+			}
+			if (req->reply.size() != size_t(cnt * 4)) {
+				set_error((boost::format("read register<%0X>: status<%04X>, length<%d>")
+						% addr[j] % req->status % req->reply.size()).str());
+				release(reqs);
+				return false;
+			}
+			for (int m = 0; m < cnt; ++m, ++j)
+				val[j] = ntohl(((const uint32_t*) &req->reply[0])[m]);
+		}
+	}
+	return true;
+}
+
+bool GVCPClient::WriteRegs(const uint32_t *addr, const uint32_t *val, int n, int timeout, int retries) {
+	const int maxcnt = GVCP_MAX_PAYLOAD / 8;
+	std::vector<ReqPtr> reqs;
+	int i, j, k, group, cnt, index;
+	uint32_t buff[maxcnt * 2];
+
+	for (i = 0; i < n; i += group) {
+		reqs.clear();
+		for (group = 0, j = i; j < n && int(reqs.size()) < window_; j += cnt, group += cnt) {
+			cnt = n - j < maxcnt ? n - j : maxcnt;
+			for (k = 0; k < cnt; ++k) {
+				buff[2 * k]     = htonl(addr[j + k]);
+				buff[2 * k + 1] = htonl(val[j + k]);
+			}
+			reqs.push_back(make_request(GVCP_WRITEREG_CMD, GVCP_WRITEREG_ACK, buff, cnt * 8, true));
+		}
+		if (!submit(reqs, timeout * (retries + 1))) return false;
+		for (j = i, k = 0; k < int(reqs.size()); ++k, j += cnt) {
+			ReqPtr req = reqs[k];
+			cnt = (req->packet.size() - GVCP_HEADER_SIZE) / 8;
+			if (!wait(req, timeout, retries)) {
+				set_error((boost::format("write register<%0X>: timed out") % addr[j]).str());
+				release(reqs);
+				return false;
+			}
+			// 应答数据: [0, 1]保留; [2, 3]成功写入的寄存器数量
+			index = req->reply.size() == 4 ? (req->reply[2] << 8) | req->reply[3] : -1;
+			if (index != cnt) {
+				set_error((boost::format("write register<%0X>: status<%04X>, index<%d> of %d")
+						% addr[j + (index > 0 && index < cnt ? index : 0)] % req->status % index % cnt).str());
+				release(reqs);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+GVCPMetrics GVCPClient::GetMetrics() {
+	mutex_lock lck(mtxpend_);
+	return metrics_;
+}
+
+string GVCPClient::GetError() {
+	mutex_lock lck(mtxpend_);
+	return errmsg_;
+}
+
+GVCPClient::ReqPtr GVCPClient::make_request(uint16_t cmd, uint16_t ack, const void *payload, int len, bool ackreq) {
+	ReqPtr req = boost::make_shared<Request>();
+	bytevec &packet = req->packet;
+
+	packet.resize(GVCP_HEADER_SIZE + len);
+	packet[0] = 0x42;
+	packet[1] = ackreq ? 0x01 : 0x00;
+	packet[2] = cmd >> 8;
+	packet[3] = cmd & 0xFF;
+	packet[4] = len >> 8;
+	packet[5] = len & 0xFF;
+	if (len) memcpy(&packet[GVCP_HEADER_SIZE], payload, len);
+	req->id     = 0;
+	req->ack    = ack;
+	req->status = 0;
+	req->ackreq = ackreq;
+	req->done   = false;
+	req->extend = 0;
+	return req;
+}
+
+bool GVCPClient::submit(std::vector<ReqPtr> &reqs, int timeout) {
+	bc::steady_clock::time_point tmend = bc::steady_clock::now() + bc::milliseconds(timeout);
+	int n(0);
+	for (size_t i = 0; i < reqs.size(); ++i) n += reqs[i]->ackreq;
+
+	mutex_lock lck(mtxpend_);
+	while (n && udp_.use_count() && int(pending_.size()) + n > window_ && pending_.size()) {
+		if (cvslot_.wait_until(lck, tmend) == boost::cv_status::timeout
+				&& int(pending_.size()) + n > window_ && pending_.size()) {
+			errmsg_ = "GVCP window is full";
+			return false;
+		}
+	}
+	if (!udp_.use_count()) {
+		errmsg_ = "GVCP channel is closed";
+		return false;
+	}
+	for (size_t i = 0; i < reqs.size(); ++i) {
+		Request &req = *reqs[i];
+		// 序列号有效区间: [1, 65535], 跳过仍未完成的序列号
+		do {
+			if (++msgcnt_ == 0) msgcnt_ = 1;
+		} while (pending_.count(msgcnt_));
+		req.id = msgcnt_;
+		req.packet[6] = msgcnt_ >> 8;
+		req.packet[7] = msgcnt_ & 0xFF;
+		if (req.ackreq) {
+			pending_[req.id] = reqs[i];
+			++metrics_.requests;
+		}
+		send_packet(req.packet);
+	}
+	if (pending_.size() > metrics_.maxpend) metrics_.maxpend = pending_.size();
+	return true;
+}
+
+bool GVCPClient::wait(ReqPtr req, int timeout, int retries) {
+	bc::steady_clock::time_point tm0 = bc::steady_clock::now(), tmend;
+	mutex_lock lck(mtxpend_);
+	int i;
+
+	for (i = 0; ; ++i) {
+		tmend = bc::steady_clock::now() + bc::milliseconds(timeout);
+		while (!req->done && udp_.use_count()) {
+			bool expired = cvack_.wait_until(lck, tmend) == boost::cv_status::timeout;
+			if (req->extend) {// PENDING_ACK: 相机需要更长处理时间
+				tmend  = bc::steady_clock::now() + bc::milliseconds(req->extend);
+				req->extend = 0;
+			}
+			else if (expired) break;
+		}
+		if (req->done || i >= retries || !udp_.use_count()) break;
+		++metrics_.retries;
+		send_packet(req->packet);
+	}
+	pending_.erase(req->id);
+	cvslot_.notify_one();
+	if (req->done) {
+		double ms = bc::duration<double, boost::milli>(bc::steady_clock::now() - tm0).count();
+		metrics_.rtt += ms;
+		if (ms > metrics_.rttmax) metrics_.rttmax = ms;
+	}
+	else ++metrics_.timeouts;
+	return req->done;
+}
+
+void GVCPClient::release(const std::vector<ReqPtr> &reqs) {
+	mutex_lock lck(mtxpend_);
+	for (size_t i = 0; i < reqs.size(); ++i) {
+		ReqMap::iterator it = pending_.find(reqs[i]->id);
+		if (it != pending_.end() && it->second == reqs[i]) pending_.erase(it);
+	}
+	cvslot_.notify_all();
+}
+
+void GVCPClient::handle_read(const long, const long) {
+	const uint8_t *buff;
+	int n;
+
+	mutex_lock lck(mtxpend_);
+	if (!udp_.use_count() || !(buff = (const uint8_t*) udp_->Read(n)) || n < GVCP_HEADER_SIZE) return;
+
+	uint16_t status = (buff[0] << 8) | buff[1];
+	uint16_t ack    = (buff[2] << 8) | buff[3];
+	uint16_t length = (buff[4] << 8) | buff[5];
+	uint16_t id     = (buff[6] << 8) | buff[7];
+	ReqMap::iterator it = pending_.find(id);
+
+	if (length > n - GVCP_HEADER_SIZE) length = n - GVCP_HEADER_SIZE;
+	if (it == pending_.end() || it->second->done) ++metrics_.stale;
+	else if (ack == GVCP_PENDING_ACK) {// 数据: [0, 1]保留; [2, 3]预计完成时间, 量纲: 毫秒
+		if (length >= 4) it->second->extend = ((buff[10] << 8) | buff[11]) + 1;
+		cvack_.notify_all();
+	}
+	else if (ack != it->second->ack) ++metrics_.stale;
+	else {
+		Request &req = *it->second;
+		req.status = status;
+		req.reply.assign(buff + GVCP_HEADER_SIZE, buff + GVCP_HEADER_SIZE + length);
+		req.done = true;
+		cvack_.notify_all();
+	}
+}
+
+void GVCPClient::send_packet(const bytevec &packet) {
+	boost::system::error_code ec;
+	if (udp_.use_count()) udp_->GetSocket().send_to(boost::asio::buffer(packet), remote_, 0, ec);
+	if (ec) errmsg_ = ec.message();
+}
+
+void GVCPClient::set_error(const string &msg) {
+	mutex_lock lck(mtxpend_);
+	errmsg_ = msg;
+}
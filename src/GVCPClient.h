@@ -0,0 +1,207 @@
+/*!
+ * @file GVCPClient.h GigE-Vision控制协议(GVCP)客户端声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 指令帧序列号由客户端统一分配, 应答按序列号匹配对应请求. 迟到的应答被丢弃,
+ *   不会被误认为后续请求的应答
+ * - 多个线程可同时发出请求, 未完成请求数量受窗口限制
+ * - READREG/WRITEREG支持单次请求访问多个地址; 超出单个指令容量时拆分为多个请求并行发出
+ * - 每个请求有独立的超时与重试次数. 重试沿用原序列号; 收到PENDING_ACK时按相机给出的时间延长等待
+ */
+
+#ifndef SRC_GVCPCLIENT_H_
+#define SRC_GVCPCLIENT_H_
+
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include "udpasio.h"
+
+using std::string;
+
+#define GVCP_PORT			3956	//< 相机GVCP服务端口
+#define GVCP_HEADER_SIZE	8		//< GVCP包头长度
+#define GVCP_MAX_PAYLOAD	540		//< 单个指令最大数据长度, 量纲: 字节
+#define GVCP_TIMEOUT		100		//< 默认应答超时, 量纲: 毫秒
+#define GVCP_RETRIES		2		//< 默认重试次数
+#define GVCP_WINDOW			4		//< 默认最大未完成请求数量
+
+enum GVCP_COMMAND {// GVCP指令
+	GVCP_DISCOVERY_CMD    = 0x0002,
+	GVCP_DISCOVERY_ACK    = 0x0003,
+	GVCP_PACKETRESEND_CMD = 0x0040,
+	GVCP_READREG_CMD      = 0x0080,
+	GVCP_READREG_ACK      = 0x0081,
+	GVCP_WRITEREG_CMD     = 0x0082,
+	GVCP_WRITEREG_ACK     = 0x0083,
+	GVCP_PENDING_ACK      = 0x0089
+};
+
+/*!
+ * @struct GVCPMetrics 请求统计
+ */
+struct GVCPMetrics {
+	uint64_t requests;	//< 请求数量
+	uint64_t retries;	//< 重发次数
+	uint64_t timeouts;	//< 超时失败的请求数量
+	uint64_t stale;		//< 无对应请求的应答数量: 迟到或重复
+	uint32_t maxpend;	//< 最大同时未完成请求数量
+	double rtt;			//< 累计往返时间, 量纲: 毫秒
+	double rttmax;		//< 最长往返时间, 量纲: 毫秒
+};
+
+class GVCPClient : private boost::noncopyable {
+public:
+	GVCPClient();
+	virtual ~GVCPClient();
+
+public:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+	typedef std::vector<uint8_t> bytevec;
+
+protected:
+	/*!
+	 * @struct Request 未完成请求
+	 */
+	struct Request {
+		uint16_t id;		//< 序列号
+		uint16_t ack;		//< 期待的应答指令
+		bytevec packet;		//< 指令帧, 用于重发
+		bytevec reply;		//< 应答数据, 不含包头
+		uint16_t status;	//< 应答状态
+		bool ackreq;		//< 需要应答
+		bool done;			//< 已收到应答
+		int extend;			//< 相机要求延长的等待时间, 量纲: 毫秒
+	};
+	typedef boost::shared_ptr<Request> ReqPtr;
+	typedef std::map<uint16_t, ReqPtr> ReqMap;
+
+protected:
+	/* 成员变量 */
+	UdpPtr udp_;			//< UDP连接. 仅用于接收, 发送采用同步方式
+	udp::endpoint remote_;	//< 相机地址
+	uint16_t msgcnt_;		//< 指令帧序列号
+	int window_;			//< 最大未完成请求数量
+	ReqMap pending_;		//< 未完成请求
+	boost::mutex mtxpend_;	//< 互斥锁: 未完成请求
+	boost::condition_variable cvack_;	//< 事件: 收到应答
+	boost::condition_variable cvslot_;	//< 事件: 窗口出现空位
+	GVCPMetrics metrics_;	//< 请求统计
+	string errmsg_;			//< 最近一次错误提示
+
+public:
+	/*!
+	 * @brief 连接相机
+	 * @param ip   相机IP地址
+	 * @param port 相机GVCP端口
+	 * @param exec 执行器. 空指针表示共享执行器
+	 */
+	void Open(const string &ip, uint16_t port = GVCP_PORT, const IOExecPtr &exec = IOExecPtr());
+	/*!
+	 * @brief 断开连接
+	 * @note
+	 * 未完成请求立即以失败返回
+	 */
+	void Close();
+	/*!
+	 * @brief 设置最大未完成请求数量
+	 * @note
+	 * 不支持并发指令的相机设置为1
+	 */
+	void SetWindow(int window);
+	/*!
+	 * @brief 发送指令并等待应答
+	 * @param cmd      指令
+	 * @param ack      期待的应答指令
+	 * @param payload  指令数据
+	 * @param len      指令数据长度, 量纲: 字节
+	 * @param reply    应答数据, 不含包头
+	 * @param timeout  单次等待应答时间, 量纲: 毫秒
+	 * @param retries  重试次数
+	 * @return
+	 * 是否收到应答. 应答状态与内容由调用者检查
+	 */
+	bool Transact(uint16_t cmd, uint16_t ack, const void *payload, int len, bytevec &reply,
+			int timeout = GVCP_TIMEOUT, int retries = GVCP_RETRIES);
+	/*!
+	 * @brief 发送无需应答的指令, 如PACKETRESEND
+	 */
+	void Send(uint16_t cmd, const void *payload, int len);
+	/*!
+	 * @brief 读取多个寄存器
+	 * @param addr  地址
+	 * @param val   数值
+	 * @param n     寄存器数量
+	 * @return
+	 * 操作结果. 失败时由GetError()查看原因
+	 */
+	bool ReadRegs(const uint32_t *addr, uint32_t *val, int n,
+			int timeout = GVCP_TIMEOUT, int retries = GVCP_RETRIES);
+	/*!
+	 * @brief 依次写入多个寄存器
+	 * @param addr  地址
+	 * @param val   数值
+	 * @param n     寄存器数量
+	 * @return
+	 * 操作结果. 失败时由GetError()查看原因
+	 */
+	bool WriteRegs(const uint32_t *addr, const uint32_t *val, int n,
+			int timeout = GVCP_TIMEOUT, int retries = GVCP_RETRIES);
+	/*!
+	 * @brief 查看请求统计
+	 */
+	GVCPMetrics GetMetrics();
+	/*!
+	 * @brief 查看最近一次错误提示
+	 */
+	string GetError();
+
+protected:
+	/*!
+	 * @brief 生成请求
+	 * @param ackreq 是否需要应答
+	 */
+	ReqPtr make_request(uint16_t cmd, uint16_t ack, const void *payload, int len, bool ackreq);
+	/*!
+	 * @brief 分配序列号, 登记一组请求并发出指令
+	 * @param timeout 等待窗口空位的最长时间, 量纲: 毫秒
+	 * @return
+	 * 操作结果. 通道关闭或等待空位超时时返回false
+	 * @note
+	 * 一组请求同时占用窗口: 空位不足时等待. 调用者等待完本组请求后再提交下一组,
+	 * 因此不会在持有未完成请求时等待空位
+	 */
+	bool submit(std::vector<ReqPtr> &reqs, int timeout);
+	/*!
+	 * @brief 等待应答, 超时后重发
+	 * @return
+	 * 是否收到应答
+	 */
+	bool wait(ReqPtr req, int timeout, int retries);
+	/*!
+	 * @brief 撤销一组请求中仍未完成的请求, 释放其占用的窗口
+	 * @note
+	 * 组内某一请求失败而提前返回时调用, 避免其余请求长期占用窗口
+	 */
+	void release(const std::vector<ReqPtr> &reqs);
+	/*!
+	 * @brief 回调函数: 处理UDP应答
+	 */
+	void handle_read(const long, const long);
+	/*!
+	 * @brief 发出指令帧
+	 */
+	void send_packet(const bytevec &packet);
+	/*!
+	 * @brief 记录错误提示
+	 */
+	void set_error(const string &msg);
+};
+typedef boost::shared_ptr<GVCPClient> GVCPClientPtr;
+
+#endif /* SRC_GVCPCLIENT_H_ */
@@ -0,0 +1,296 @@
+/*!
+ * @file GVSPStream.cpp GigE-Vision图像数据流(GVSP)接收接口定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * GVSP包头(8字节, 网络字节序):
+ * - [0, 1]: 状态
+ * - [2, 3]: 数据块编号
+ * - [4]   : 数据包类型
+ * - [5, 7]: 数据包编号
+ * 每条消息的存储区为bufs_中maxpack_字节: 包头位于起始位置, 未预测时包数据紧随其后.
+ * 预测时包数据写入预测位置, 超出容量的部分写入存储区中对应的偏移处, 因此移回后仍连续
+ */
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include "GVSPStream.h"
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL	40
+#endif
+#define GVSP_CTRL_SIZE	CMSG_SPACE(sizeof(uint32_t))	//< 单条消息的辅助数据容量
+
+GVSPStream::GVSPStream() {
+	sock_    = -1;
+	batch_   = GVSP_BATCH_SIZE;
+	maxpack_ = 0;
+	ntgt_    = 0;
+	cpu_     = -1;
+	priority_ = 0;
+	running_ = false;
+	memset(&metrics_, 0, sizeof(metrics_));
+	errmsg_[0] = 0;
+}
+
+GVSPStream::~GVSPStream() {
+	Close();
+}
+
+bool GVSPStream::Open(uint16_t port, int maxpack, int batch) {
+	if (sock_ >= 0) return true;
+	if ((sock_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		snprintf(errmsg_, sizeof(errmsg_), "socket: %s", strerror(errno));
+		return false;
+	}
+
+	int reuse(1);
+	struct timeval tv = { 0, 100000 };	// 周期性检查停止标志
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	setsockopt(sock_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(sock_, SOL_SOCKET, SO_RXQ_OVFL, &reuse, sizeof(reuse));
+	if (bind(sock_, (struct sockaddr*) &addr, sizeof(addr))) {
+		snprintf(errmsg_, sizeof(errmsg_), "bind port<%u>: %s", port, strerror(errno));
+		close(sock_);
+		sock_ = -1;
+		return false;
+	}
+
+	batch_   = batch > 0 ? batch : GVSP_BATCH_SIZE;
+	SetMaxPacket(maxpack);
+	msgs_.resize(batch_);
+	iovs_.resize(batch_ * 3);
+	ctrls_.resize(batch_ * GVSP_CTRL_SIZE);
+	pcks_.resize(batch_);
+	tgts_.resize(batch_);
+	SetRecvBuffer(0);
+	return true;
+}
+
+void GVSPStream::Close() {
+	Stop();
+	if (sock_ >= 0) {
+		close(sock_);
+		sock_ = -1;
+	}
+}
+
+int GVSPStream::SetRecvBuffer(int bytes) {
+	int size(0);
+	socklen_t len = sizeof(size);
+
+	if (sock_ < 0) return 0;
+	if (bytes > 0 && setsockopt(sock_, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)))
+		setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+	getsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &size, &len);
+	mutex_lock lck(mtxmet_);
+	return (metrics_.rcvbuf = size);
+}
+
+bool GVSPStream::SetMaxPacket(int maxpack) {
+	if (running_ || maxpack <= GVSP_HEADER_SIZE) return false;
+	maxpack_ = maxpack;
+	std::vector<uint8_t>(size_t(batch_) * maxpack_).swap(bufs_);	// 缩小时同时释放多余容量
+	return true;
+}
+
+int GVSPStream::MaxPacket() {
+	return maxpack_;
+}
+
+void GVSPStream::RegisterBatch(const BatchHandler &handler) {
+	handler_ = handler;
+}
+
+void GVSPStream::RegisterPlace(const PlaceHandler &handler) {
+	placer_ = handler;
+}
+
+void GVSPStream::SetSchedule(int cpu, int priority) {
+	cpu_      = cpu;
+	priority_ = priority;
+}
+
+string GVSPStream::PolicyError() {
+	return policyerr_;
+}
+
+bool GVSPStream::Start() {
+	if (sock_ < 0 || running_) return running_;
+	running_ = true;
+	thrdrcv_.reset(new boost::thread(boost::bind(&GVSPStream::thread_receive, this)));
+	apply_schedule();
+	return true;
+}
+
+void GVSPStream::Stop() {
+	if (running_) {
+		running_ = false;
+		thrdrcv_->join();
+		thrdrcv_.reset();
+	}
+}
+
+StreamMetrics GVSPStream::GetMetrics() {
+	mutex_lock lck(mtxmet_);
+	return metrics_;
+}
+
+string GVSPStream::Summary() {
+	StreamMetrics metrics = GetMetrics();
+	boost::format fmt("\t stream   : packets = %llu, batches = %llu (avg = %.1f, max = %d), malformed = %llu, %.1f MB\n"
+			"\t socket   : rcvbuf = %d KB, overflow drops = %u\n"
+			"\t place    : direct = %llu, missed = %llu\n"
+			"\t thread   : CPU = %d, SCHED_FIFO = %d%s\n"
+			"\t process  : %.3f us/packet, max = %.1f us/batch\n");
+	fmt % metrics.packets % metrics.batches
+		% (metrics.batches ? double(metrics.packets) / metrics.batches : 0.0) % metrics.maxbatch
+		% metrics.malformed % metrics.mbytes
+		% (metrics.rcvbuf / 1024) % metrics.sockdrops
+		% metrics.placed % metrics.missed
+		% cpu_ % priority_ % (policyerr_.size() ? " (failed)" : "")
+		% (metrics.packets ? metrics.proctm / metrics.packets : 0.0) % metrics.procmax;
+	return fmt.str();
+}
+
+const char *GVSPStream::GetError() {
+	return errmsg_;
+}
+
+void GVSPStream::apply_schedule() {
+	pthread_t thrd = thrdrcv_->native_handle();
+	int rslt;
+
+	policyerr_.clear();
+	if (cpu_ >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu_, &cpuset);
+		if ((rslt = pthread_setaffinity_np(thrd, sizeof(cpuset), &cpuset)))
+			policyerr_ += (boost::format("CPU%d affinity: %s. ") % cpu_ % strerror(rslt)).str();
+	}
+	if (priority_ > 0) {
+		struct sched_param param;
+		param.sched_priority = priority_;
+		if ((rslt = pthread_setschedparam(thrd, SCHED_FIFO, &param)))
+			policyerr_ += (boost::format("SCHED_FIFO priority %d: %s. ") % priority_ % strerror(rslt)).str();
+	}
+}
+
+void GVSPStream::thread_receive() {
+	namespace bc = boost::chrono;
+	int n, valid, i;
+	uint64_t bytes, placed;
+	uint32_t drops;
+	cmsghdr *cmsg;
+
+	while (running_) {
+		prepare_batch();
+		// MSG_WAITFORONE: 收到首个数据包后不再阻塞, 返回已到达的全部数据包
+		if ((n = recvmmsg(sock_, &msgs_[0], batch_, MSG_WAITFORONE, NULL)) <= 0) continue;
+
+		bc::steady_clock::time_point tm0 = bc::steady_clock::now();
+		valid = parse_batch(n);
+		if (valid && handler_) handler_(&pcks_[0], valid);
+		double us = bc::duration<double, boost::micro>(bc::steady_clock::now() - tm0).count();
+
+		for (i = 0, bytes = 0; i < n; ++i) bytes += msgs_[i].msg_len;
+		for (i = 0, placed = 0; i < valid; ++i) placed += pcks_[i].placed;
+		for (i = 0, drops = 0; i < n; ++i) {// 辅助数据携带溢出丢包累计数量, 取最新值
+			for (cmsg = CMSG_FIRSTHDR(&msgs_[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs_[i].msg_hdr, cmsg)) {
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+					memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+			}
+		}
+		mutex_lock lck(mtxmet_);
+		if (drops > metrics_.sockdrops) metrics_.sockdrops = drops;
+		metrics_.placed    += placed;
+		metrics_.missed    += (n < ntgt_ ? n : ntgt_) - placed;
+		metrics_.packets   += n;
+		metrics_.malformed += n - valid;
+		metrics_.mbytes    += bytes / 1048576.0;
+		metrics_.proctm    += us;
+		++metrics_.batches;
+		if (n > metrics_.maxbatch) metrics_.maxbatch = n;
+		if (us > metrics_.procmax) metrics_.procmax = us;
+	}
+}
+
+void GVSPStream::prepare_batch() {
+	int i, room = maxpack_ - GVSP_HEADER_SIZE;
+
+	ntgt_ = placer_ ? placer_(&tgts_[0], batch_) : 0;
+	for (i = 0; i < batch_; ++i) {
+		uint8_t *buf = &bufs_[size_t(i) * maxpack_];
+		iovec *iov = &iovs_[i * 3];
+		msghdr &hdr = msgs_[i].msg_hdr;
+
+		memset(&hdr, 0, sizeof(msghdr));
+		hdr.msg_iov = iov;
+		hdr.msg_control    = &ctrls_[i * GVSP_CTRL_SIZE];
+		hdr.msg_controllen = GVSP_CTRL_SIZE;
+		iov[0].iov_base = buf;
+		iov[0].iov_len  = GVSP_HEADER_SIZE;
+		if (i < ntgt_ && tgts_[i].length > 0 && tgts_[i].length <= room) {// 包数据直接写入预测位置
+			GVSPTarget &tgt = tgts_[i];
+			iov[1].iov_base = tgt.dst;
+			iov[1].iov_len  = tgt.length;
+			iov[2].iov_base = buf + GVSP_HEADER_SIZE + tgt.length;
+			iov[2].iov_len  = room - tgt.length;
+			hdr.msg_iovlen  = iov[2].iov_len ? 3 : 2;
+		}
+		else {
+			iov[1].iov_base = buf + GVSP_HEADER_SIZE;
+			iov[1].iov_len  = room;
+			hdr.msg_iovlen  = 2;
+		}
+	}
+}
+
+int GVSPStream::parse_batch(int n) {
+	int i, valid, len;
+
+	for (i = valid = 0; i < n; ++i) {
+		uint8_t *head = (uint8_t*) iovs_[i * 3].iov_base;
+		if ((len = msgs_[i].msg_len) < GVSP_HEADER_SIZE) continue;
+
+		GVSPPacket &pck = pcks_[valid++];
+		pck.status  = (head[0] << 8) | head[1];
+		pck.block   = (head[2] << 8) | head[3];
+		pck.format  = head[4];
+		pck.id      = (uint32_t(head[5]) << 16) | (head[6] << 8) | head[7];
+		pck.payload = head + GVSP_HEADER_SIZE;
+		pck.length  = len - GVSP_HEADER_SIZE;
+		pck.placed  = false;
+		pck.head    = pck.length;
+		pck.rest    = NULL;
+		if (msgs_[i].msg_hdr.msg_iov[1].iov_base != pck.payload) {// 已写入预测位置
+			int bytes = pck.length < tgts_[i].length ? pck.length : tgts_[i].length;
+			if (pck.format == GVSP_PAYLOAD && pck.id == tgts_[i].id) {
+				// 编号命中. 所属数据块与存储区由使用者核对
+				pck.placed  = true;
+				pck.rest    = pck.payload + bytes;
+				pck.payload = tgts_[i].dst;
+				pck.head    = bytes;
+			}
+			else {// 预测失败: 移回存储区, 与溢出部分连续
+				memcpy(pck.payload, tgts_[i].dst, bytes);
+			}
+		}
+	}
+	return valid;
+}
@@ -0,0 +1,235 @@
+/*!
+ * @file GVSPStream.h GigE-Vision图像数据流(GVSP)接收接口声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 独立线程以recvmmsg()批量接收数据包, 每次系统调用最多接收batch个数据包
+ * - 同一批数据包的GVSP包头集中解析后, 一次性交由使用者处理
+ * - 统计数据包数量、批次大小与处理耗时
+ * - 使用者可预测后续数据包的存储位置: 包头存入暂存区, 包数据经iovec直接写入帧缓存区;
+ *   实际编号与预测不符时, 数据移回暂存区, 由使用者复制
+ * - 接收线程可绑定CPU并采用SCHED_FIFO实时调度, 避免被压缩、日志等线程抢占
+ * - 启用SO_RXQ_OVFL, 从辅助数据中读取内核因接收缓冲区溢出而丢弃的数据包累计数量
+ */
+
+#ifndef SRC_GVSPSTREAM_H_
+#define SRC_GVSPSTREAM_H_
+
+#include <sys/socket.h>
+#include <stdint.h>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+using std::string;
+
+#define GVSP_HEADER_SIZE	8		//< GVSP包头长度
+#define GVSP_BATCH_SIZE		64		//< 单次系统调用接收的最大数据包数量
+
+enum GVSP_FORMAT {// GVSP数据包类型
+	GVSP_LEADER  = 1,	//< 引导
+	GVSP_TRAILER = 2,	//< 结尾
+	GVSP_PAYLOAD = 3	//< 数据
+};
+
+/*!
+ * @struct GVSPPacket 已解析的数据包
+ */
+struct GVSPPacket {
+	uint16_t status;	//< 状态
+	uint16_t block;		//< 数据块编号, 即帧编号
+	uint8_t  format;	//< 数据包类型, GVSP_FORMAT
+	uint32_t id;		//< 数据包编号, 24位
+	uint8_t *payload;	//< 包数据首地址: placed为true时为预测位置, 否则位于暂存区
+	int length;			//< 包数据长度, 量纲: 字节
+	bool placed;		//< 包数据的前head字节已直接写入预测位置
+	int head;			//< 位于payload的连续字节数. 其余length - head字节位于rest
+	uint8_t *rest;		//< 超出预测容量的包数据, 位于暂存区
+};
+
+/*!
+ * @struct GVSPTarget 预测的数据包存储位置
+ */
+struct GVSPTarget {
+	uint32_t id;	//< 预测的数据包编号
+	uint8_t *dst;	//< 包数据存储地址
+	int length;		//< 存储容量, 量纲: 字节. 超出部分写入暂存区
+};
+
+/*!
+ * @struct StreamMetrics 接收统计
+ */
+struct StreamMetrics {
+	uint64_t packets;	//< 数据包数量
+	uint64_t batches;	//< 批次数量, 即recvmmsg()有效返回次数
+	uint64_t malformed;	//< 长度不足包头的数据包数量
+	double mbytes;		//< 数据量, 量纲: MB
+	uint64_t placed;	//< 直接写入预测位置的数据包数量
+	uint64_t missed;	//< 预测位置与实际编号不符的数据包数量
+	uint32_t sockdrops;	//< 内核接收缓冲区溢出丢弃的数据包累计数量(SO_RXQ_OVFL)
+	int rcvbuf;			//< 内核接收缓冲区容量, 量纲: 字节
+	int maxbatch;		//< 最大批次大小
+	double proctm;		//< 累计处理耗时, 量纲: 微秒
+	double procmax;		//< 单批次最长处理耗时, 量纲: 微秒
+};
+
+class GVSPStream : private boost::noncopyable {
+public:
+	GVSPStream();
+	virtual ~GVSPStream();
+
+public:
+	/*!
+	 * @brief 声明批处理函数
+	 * @param <1> 数据包
+	 * @param <2> 数据包数量
+	 * @note
+	 * 在接收线程中调用. 数据包存储区在函数返回后被复用
+	 */
+	typedef boost::function<void (GVSPPacket*, int)> BatchHandler;
+	/*!
+	 * @brief 声明存储位置预测函数
+	 * @param <1> 预测结果
+	 * @param <2> 最多预测的数据包数量
+	 * @return
+	 * 预测的数据包数量. 0: 全部接收至暂存区
+	 * @note
+	 * 在接收线程中、每次recvmmsg()之前调用. 各预测位置不可重叠, 且在下一次调用前保持有效
+	 */
+	typedef boost::function<int (GVSPTarget*, int)> PlaceHandler;
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	/* 成员变量 */
+	int sock_;			//< 套接字
+	int batch_;			//< 单批次最大数据包数量
+	int maxpack_;		//< 单个数据包最大长度, 量纲: 字节
+	bool running_;		//< 接收线程运行标志
+	std::vector<uint8_t> bufs_;		//< 数据包存储区
+	std::vector<mmsghdr> msgs_;		//< recvmmsg()消息
+	std::vector<iovec> iovs_;		//< 消息存储区: 每条消息3段, 包头/包数据/溢出
+	std::vector<uint8_t> ctrls_;	//< 辅助数据存储区
+	std::vector<GVSPPacket> pcks_;	//< 已解析的数据包
+	std::vector<GVSPTarget> tgts_;	//< 预测的存储位置
+	int ntgt_;				//< 本批次预测的数据包数量
+	int cpu_;				//< 接收线程绑定的CPU. <0: 不绑定
+	int priority_;			//< 接收线程SCHED_FIFO优先级. 0: 默认调度
+	string policyerr_;		//< 调度策略错误提示. 空字符串表示成功或未配置
+	BatchHandler handler_;	//< 批处理函数
+	PlaceHandler placer_;	//< 存储位置预测函数
+	StreamMetrics metrics_;	//< 接收统计
+	boost::mutex mtxmet_;	//< 互斥锁: 接收统计
+	threadptr thrdrcv_;		//< 线程: 接收数据包
+	char errmsg_[128];		//< 错误提示
+
+public:
+	/*!
+	 * @brief 创建套接字并绑定本地端口
+	 * @param port     本地UDP端口
+	 * @param maxpack  单个数据包最大长度, 量纲: 字节. 不含IP与UDP包头
+	 * @param batch    单次系统调用接收的最大数据包数量
+	 * @return
+	 * 操作结果
+	 */
+	bool Open(uint16_t port, int maxpack, int batch = GVSP_BATCH_SIZE);
+	/*!
+	 * @brief 停止接收并关闭套接字
+	 */
+	void Close();
+	/*!
+	 * @brief 设置内核接收缓冲区容量
+	 * @param bytes 容量, 量纲: 字节
+	 * @return
+	 * 内核实际分配的容量
+	 * @note
+	 * 优先使用SO_RCVBUFFORCE(需CAP_NET_ADMIN), 不受net.core.rmem_max限制; 失败时使用SO_RCVBUF
+	 */
+	int SetRecvBuffer(int bytes);
+	/*!
+	 * @brief 按协商的数据包长度重新分配存储区
+	 * @param maxpack  单个数据包最大长度, 量纲: 字节. 不含IP与UDP包头
+	 * @return
+	 * 操作结果. 接收线程运行时不可调整
+	 */
+	bool SetMaxPacket(int maxpack);
+	/*!
+	 * @brief 查看单个数据包最大长度
+	 */
+	int MaxPacket();
+	/*!
+	 * @brief 注册批处理函数
+	 * @note
+	 * 在Start()之前调用
+	 */
+	void RegisterBatch(const BatchHandler &handler);
+	/*!
+	 * @brief 注册存储位置预测函数
+	 * @note
+	 * 在Start()之前调用. 未注册时数据包全部接收至暂存区
+	 */
+	void RegisterPlace(const PlaceHandler &handler);
+	/*!
+	 * @brief 设置接收线程调度策略
+	 * @param cpu      绑定的CPU编号. <0: 不绑定
+	 * @param priority SCHED_FIFO优先级, [1, 99]. 0: 默认调度
+	 * @note
+	 * 在Start()之前调用, 每次启动线程时生效
+	 */
+	void SetSchedule(int cpu, int priority);
+	/*!
+	 * @brief 查看调度策略错误提示
+	 * @return
+	 * 空字符串表示已生效或未配置
+	 */
+	string PolicyError();
+	/*!
+	 * @brief 启动接收线程
+	 * @note
+	 * 调度策略失败时线程仍以默认调度运行, 错误由PolicyError()查看
+	 */
+	bool Start();
+	/*!
+	 * @brief 停止接收线程
+	 */
+	void Stop();
+	/*!
+	 * @brief 查看接收统计
+	 */
+	StreamMetrics GetMetrics();
+	/*!
+	 * @brief 生成接收统计的文本
+	 */
+	string Summary();
+	/*!
+	 * @brief 查看错误提示
+	 */
+	const char *GetError();
+
+protected:
+	/*!
+	 * @brief 为接收线程应用CPU绑定与实时调度
+	 */
+	void apply_schedule();
+	/*!
+	 * @brief 线程: 批量接收数据包
+	 */
+	void thread_receive();
+	/*!
+	 * @brief 预测存储位置并设置各消息的iovec
+	 */
+	void prepare_batch();
+	/*!
+	 * @brief 解析一批数据包的包头
+	 * @param n 数据包数量
+	 * @return
+	 * 有效数据包数量
+	 */
+	int parse_batch(int n);
+};
+typedef boost::shared_ptr<GVSPStream> GVSPStreamPtr;
+
+#endif /* SRC_GVSPSTREAM_H_ */
@@ -0,0 +1,502 @@
+/*!
+ * @file GYEmulator.cpp GWAC-GY相机GigE-Vision协议仿真器定义文件
+ * @version 0.1
+ * @date 2026-10-17
+ * @note
+ * GVSP引导包数据(36字节): 保留(2), 负载类型(2), 时间戳(8), 像素格式(4), 宽度(4), 高度(4),
+ * X偏移(4), Y偏移(4), X填充(2), Y填充(2)
+ * GVSP结尾包数据(8字节): 保留(2), 负载类型(2), 高度(4)
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include "GYEmulator.h"
+#include "GVCPClient.h"
+#include "GVSPStream.h"
+
+namespace bc = boost::chrono;
+
+#define GEV_STATUS_SUCCESS			0x0000
+#define GEV_STATUS_NOT_IMPLEMENTED	0x8001
+#define GEV_DISCOVERY_SIZE			248		//< DISCOVERY应答数据长度
+#define GEV_SCPS_FIRE_TEST			0x80000000	//< GevSCPS: 发送测试包
+#define GEV_SCPS_DONT_FRAGMENT		0x40000000	//< GevSCPS: 禁止IP分片
+#define EMU_RESEND_BURST			64		//< 发送图像时, 每发出该数量的数据包检查一次重传队列
+
+GYEmulator::GYEmulator(const GYEmuParameter &param)
+	: param_(param), rng_(param.seed) {
+	sockcmd_  = -1;
+	sockdata_ = -1;
+	running_  = false;
+	block_    = 0;
+	expose_   = false;
+	abort_    = false;
+	memset(&metrics_, 0, sizeof(metrics_));
+	init_registers();
+}
+
+GYEmulator::~GYEmulator() {
+	Stop();
+}
+
+bool GYEmulator::Start() {
+	if (running_) return true;
+
+	struct timeval tv = { 0, 100000 };	// 周期性检查停止标志与心跳
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(param_.port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if ((sockcmd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+			|| (sockdata_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		fprintf(stderr, "socket: %s\n", strerror(errno));
+		Stop();
+		return false;
+	}
+	setsockopt(sockcmd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (bind(sockcmd_, (struct sockaddr*) &addr, sizeof(addr))) {
+		fprintf(stderr, "bind port<%u>: %s\n", param_.port, strerror(errno));
+		Stop();
+		return false;
+	}
+
+	running_ = true;
+	tmlast_  = bc::steady_clock::now();
+	thrdcmd_.reset(new boost::thread(boost::bind(&GYEmulator::thread_command, this)));
+	thrdexp_.reset(new boost::thread(boost::bind(&GYEmulator::thread_expose, this)));
+	return true;
+}
+
+void GYEmulator::Stop() {
+	if (running_) {
+		{
+			mutex_lock lck(mtxreg_);
+			running_ = false;
+			cvexp_.notify_all();
+		}
+		thrdcmd_->join();
+		thrdexp_->join();
+		thrdcmd_.reset();
+		thrdexp_.reset();
+	}
+	if (sockcmd_ >= 0) {
+		close(sockcmd_);
+		sockcmd_ = -1;
+	}
+	if (sockdata_ >= 0) {
+		close(sockdata_);
+		sockdata_ = -1;
+	}
+}
+
+GYEmuMetrics GYEmulator::GetMetrics() {
+	mutex_lock lck(mtxmet_);
+	return metrics_;
+}
+
+string GYEmulator::Summary() {
+	GYEmuMetrics metrics = GetMetrics();
+	boost::format fmt("\t control  : commands = %llu, resend requests = %llu, heartbeat timeouts = %llu\n"
+			"\t stream   : frames = %llu, packets = %llu (resent = %llu)\n"
+			"\t impair   : dropped = %llu, reordered = %llu, duplicated = %llu, congested = %llu\n");
+	fmt % metrics.commands % metrics.resends % metrics.heartbeat
+		% metrics.frames % metrics.packets % metrics.resent
+		% metrics.dropped % metrics.reordered % metrics.duplicated % metrics.congested;
+	return fmt.str();
+}
+
+void GYEmulator::init_registers() {
+	uint32_t ip = ntohl(inet_addr(param_.ip.c_str()));
+
+	regs_[0x064C]  = ip;			// 当前IP地址
+	regs_[0x065C]  = 0xFFFFFF00;	// 子网掩码
+	regs_[0x066C]  = (ip & 0xFFFFFF00) | 0x01;	// 网关
+	regs_[0x0938]  = 3000;			// 心跳超时, 量纲: 毫秒
+	regs_[0x093C]  = 0;				// 时间戳频率高32位
+	regs_[0x0940]  = 1000000000;	// 时间戳频率低32位
+	regs_[0x0A00]  = 0;				// GevCCP
+	regs_[0x0D00]  = 0;				// GevSCPHostPort
+	regs_[0x0D04]  = 1500;			// GevSCPS
+	regs_[0x0D08]  = 0;				// GevSCPD
+	regs_[0x0D18]  = 0;				// GevSCDA
+	regs_[0xA000]  = 0;				// 启动采集序列
+	regs_[0xA004]  = param_.width;
+	regs_[0xA008]  = param_.height;
+	regs_[0x20000] = 0;				// 启动曝光
+	regs_[0x20008] = 0;				// 增益档位
+	regs_[0x2000C] = 0;				// 快门: 0, 常规; 2, 常闭
+	regs_[0x20010] = 0;				// 曝光时间, 量纲: 微秒
+	regs_[0x20050] = 0;				// 中止曝光
+}
+
+uint32_t GYEmulator::reg_get(uint32_t addr) {
+	mutex_lock lck(mtxreg_);
+	RegMap::iterator it = regs_.find(addr);
+	return it == regs_.end() ? 0 : it->second;
+}
+
+void GYEmulator::reg_set(uint32_t addr, uint32_t val) {
+	if (addr == 0x0D04 && (val & GEV_SCPS_FIRE_TEST)) send_test(val);
+
+	mutex_lock lck(mtxreg_);
+	if (addr == 0x0D04) val &= ~GEV_SCPS_FIRE_TEST;
+	else if (addr == 0x20000 && (val & 0x01)) {
+		expose_ = true;
+		abort_  = false;
+		cvexp_.notify_all();
+		val = 0;	// 自清零
+	}
+	else if (addr == 0x20050 && (val & 0x01)) {
+		abort_ = true;
+		cvexp_.notify_all();
+		val = 0;
+	}
+	regs_[addr] = val;
+}
+
+int GYEmulator::process_command(const uint8_t *buff, int n, uint8_t *reply) {
+	if (n < GVCP_HEADER_SIZE || buff[0] != 0x42) return 0;
+
+	bool ackreq     = buff[1] & 0x01;
+	uint16_t cmd    = (buff[2] << 8) | buff[3];
+	uint16_t length = (buff[4] << 8) | buff[5];
+	uint16_t status(GEV_STATUS_SUCCESS), len(0);
+	const uint8_t *payload = buff + GVCP_HEADER_SIZE;
+	uint8_t *data = reply + GVCP_HEADER_SIZE;
+	uint32_t addr, val;
+	int i, cnt;
+
+	if (length > n - GVCP_HEADER_SIZE) length = n - GVCP_HEADER_SIZE;
+	{
+		mutex_lock lck(mtxmet_);
+		++metrics_.commands;
+	}
+
+	switch (cmd) {
+	case GVCP_DISCOVERY_CMD:// 应答数据[36, 39]为当前IP地址
+		len = GEV_DISCOVERY_SIZE;
+		memset(data, 0, len);
+		data[1] = 0x02;	// 协议版本2.0
+		val = htonl(reg_get(0x064C));
+		memcpy(data + 36, &val, 4);
+		strcpy((char*) data + 72, "GWAC");
+		strcpy((char*) data + 104, "GY emulator");
+		break;
+	case GVCP_READREG_CMD:
+		cnt = length / 4;
+		for (i = 0; i < cnt; ++i) {
+			memcpy(&addr, payload + i * 4, 4);
+			val = htonl(reg_get(ntohl(addr)));
+			memcpy(data + i * 4, &val, 4);
+		}
+		len = cnt * 4;
+		break;
+	case GVCP_WRITEREG_CMD:// 应答数据: [0, 1]保留; [2, 3]成功写入的寄存器数量
+		cnt = length / 8;
+		for (i = 0; i < cnt; ++i) {
+			memcpy(&addr, payload + i * 8, 4);
+			memcpy(&val, payload + i * 8 + 4, 4);
+			reg_set(ntohl(addr), ntohl(val));
+		}
+		len = 4;
+		data[0] = data[1] = 0;
+		data[2] = cnt >> 8;
+		data[3] = cnt & 0xFF;
+		break;
+	case GVCP_PACKETRESEND_CMD:// 数据: 数据块编号, 首个数据包编号, 最后一个数据包编号
+		if (length >= 12) {
+			uint32_t block, first, last;
+			memcpy(&block, payload, 4);
+			memcpy(&first, payload + 4, 4);
+			memcpy(&last,  payload + 8, 4);
+			block = ntohl(block);
+			first = ntohl(first);
+			last  = ntohl(last);
+			if (first >= 1 && first <= last) {// 交由图像发送线程处理
+				mutex_lock lck(mtxreg_);
+				if (block == block_) {
+					ResendRange range = { block_, first, last };
+					resend_.push_back(range);
+					cvexp_.notify_all();
+					mutex_lock lck1(mtxmet_);
+					++metrics_.resends;
+				}
+			}
+		}
+		return 0;	// 无应答
+	default:
+		status = GEV_STATUS_NOT_IMPLEMENTED;
+		break;
+	}
+	if (!ackreq) return 0;
+
+	uint16_t ack = cmd + 1;
+	reply[0] = status >> 8;
+	reply[1] = status & 0xFF;
+	reply[2] = ack >> 8;
+	reply[3] = ack & 0xFF;
+	reply[4] = len >> 8;
+	reply[5] = len & 0xFF;
+	reply[6] = buff[6];
+	reply[7] = buff[7];
+	return GVCP_HEADER_SIZE + len;
+}
+
+void GYEmulator::make_image() {
+	int w = int(reg_get(0xA004)), h = int(reg_get(0xA008));
+	size_t bytes = size_t(w) * h * 2;
+	int x, y;
+
+	mutex_lock lck(mtxdata_);
+	image_.resize(bytes + 64);
+	uint16_t *data = (uint16_t*) &image_[0];
+	for (y = 0; y < h; ++y) {
+		for (x = 0; x < w; ++x, ++data) *data = uint16_t(x + y + block_);
+	}
+	memset(&image_[bytes], 0, 64);
+}
+
+void GYEmulator::send_test(uint32_t scps) {
+	int bytes = int(scps & 0xFFFF);
+	if (bytes - 28 < GVSP_HEADER_SIZE || bytes - 28 > 65507) return;
+	// 置DF标志时, 超出MTU的测试包在链路上被丢弃
+	if ((scps & GEV_SCPS_DONT_FRAGMENT) && bytes > param_.mtu) return;
+
+	std::vector<uint8_t> packet(bytes - 28, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(uint16_t(reg_get(0x0D00)));
+	addr.sin_addr.s_addr = htonl(reg_get(0x0D18));
+	if (addr.sin_addr.s_addr) sendto(sockdata_, &packet[0], packet.size(), 0, (struct sockaddr*) &addr, sizeof(addr));
+}
+
+bool GYEmulator::send_packet(uint8_t format, uint32_t id) {
+	uint32_t scps = reg_get(0x0D04);
+	int bytes = int(scps & 0xFFFF), room = payload_size(), len(0);
+	uint8_t buff[65536], *data = buff + GVSP_HEADER_SIZE;
+	uint32_t w = reg_get(0xA004), h = reg_get(0xA008);
+
+	if (room <= 0 || ((scps & GEV_SCPS_DONT_FRAGMENT) && bytes > param_.mtu)) return false;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(uint16_t(reg_get(0x0D00)));
+	addr.sin_addr.s_addr = htonl(reg_get(0x0D18));
+	if (!addr.sin_addr.s_addr) return false;
+
+	buff[0] = buff[1] = 0;
+	buff[2] = block_ >> 8;
+	buff[3] = block_ & 0xFF;
+	buff[4] = format;
+	buff[5] = (id >> 16) & 0xFF;
+	buff[6] = (id >> 8) & 0xFF;
+	buff[7] = id & 0xFF;
+	if (format == GVSP_LEADER) {
+		uint64_t ts = bc::duration_cast<bc::nanoseconds>(bc::steady_clock::now().time_since_epoch()).count();
+		len = 36;
+		memset(data, 0, len);
+		data[3] = 0x01;	// 负载类型: 图像
+		for (int i = 0; i < 8; ++i) data[4 + i] = (ts >> (56 - 8 * i)) & 0xFF;
+		uint32_t vals[] = { htonl(0x01100007), htonl(w), htonl(h) };	// Mono16
+		memcpy(data + 12, vals, sizeof(vals));
+	}
+	else if (format == GVSP_TRAILER) {
+		len = 8;
+		memset(data, 0, len);
+		data[3] = 0x01;
+		uint32_t val = htonl(h);
+		memcpy(data + 4, &val, 4);
+	}
+	else {
+		size_t offset = size_t(id - 1) * room;
+		if (offset >= image_.size()) return false;
+		len = image_.size() - offset < size_t(room) ? int(image_.size() - offset) : room;
+		memcpy(data, &image_[offset], len);
+	}
+
+	packet_delay();
+	if (congest(GVSP_HEADER_SIZE + len + 28)) return true;	// 已发出, 在链路中丢失
+	if (sendto(sockdata_, buff, GVSP_HEADER_SIZE + len, 0, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+		return false;
+	mutex_lock lck(mtxmet_);
+	++metrics_.packets;
+	return true;
+}
+
+int GYEmulator::send_range(uint32_t first, uint32_t last) {
+	mutex_lock lck(mtxdata_);
+	int n(0);
+
+	for (uint32_t id = first; id <= last && running_; ++id) {
+		if (id < last && uni_(rng_) < param_.reorder) {// 与下一个数据包交换顺序
+			n += impair_packet(id + 1);
+			n += impair_packet(id);
+			++id;
+			mutex_lock lck1(mtxmet_);
+			++metrics_.reordered;
+		}
+		else n += impair_packet(id);
+	}
+	return n;
+}
+
+void GYEmulator::flush_resend() {
+	ResendQueue ranges;
+	{
+		mutex_lock lck(mtxreg_);
+		ranges.swap(resend_);
+	}
+	if (ranges.empty()) return;
+
+	uint32_t count = packet_count();
+	int n(0);
+	for (; !ranges.empty() && running_; ranges.pop_front()) {
+		ResendRange &range = ranges.front();
+		if (range.block != block_ || range.first > count) continue;
+		n += send_range(range.first, range.last < count ? range.last : count);
+	}
+	mutex_lock lck(mtxmet_);
+	metrics_.resent += n;
+}
+
+int GYEmulator::impair_packet(uint32_t id) {
+	if (uni_(rng_) < param_.loss) {
+		mutex_lock lck(mtxmet_);
+		++metrics_.dropped;
+		return 0;
+	}
+	int n = send_packet(GVSP_PAYLOAD, id) ? 1 : 0;
+	if (n && uni_(rng_) < param_.duplicate && send_packet(GVSP_PAYLOAD, id)) {
+		mutex_lock lck(mtxmet_);
+		++metrics_.duplicated;
+		++n;
+	}
+	return n;
+}
+
+void GYEmulator::packet_delay() {
+	int64_t ns = int64_t(reg_get(0x0D08));
+	if (ns < int64_t(param_.delay) * 1000) ns = int64_t(param_.delay) * 1000;
+	if (!ns) return;
+
+	// 按计划时间发送, 避免累积sleep误差. 短延时忙等待
+	bc::steady_clock::time_point now = bc::steady_clock::now();
+	if (tmnext_ < now) tmnext_ = now;
+	if (tmnext_ - now > bc::microseconds(100)) boost::this_thread::sleep_until(tmnext_);
+	else while (bc::steady_clock::now() < tmnext_);
+	tmnext_ += bc::nanoseconds(ns);
+}
+
+bool GYEmulator::congest(int bytes) {
+	if (param_.bandwidth <= 0) return false;
+
+	// 队列按带宽匀速排空; 排队时长超出队列容量时溢出
+	bc::steady_clock::time_point now = bc::steady_clock::now();
+	bc::nanoseconds txtm(int64_t(bytes) * 8000 / param_.bandwidth);
+	if (tmdrain_ < now) tmdrain_ = now;
+	if (tmdrain_ - now >= txtm * param_.queue) {
+		mutex_lock lck(mtxmet_);
+		++metrics_.congested;
+		return true;
+	}
+	tmdrain_ += txtm;
+	return false;
+}
+
+int GYEmulator::payload_size() {
+	// GevSCPS包含IP(20)、UDP(8)与GVSP(8)包头
+	return int(reg_get(0x0D04) & 0xFFFF) - 36;
+}
+
+uint32_t GYEmulator::packet_count() {
+	int room = payload_size();
+	size_t bytes = size_t(reg_get(0xA004)) * reg_get(0xA008) * 2 + 64;	// 最后一包多出64字节
+	return room > 0 ? uint32_t((bytes + room - 1) / room) : 0;
+}
+
+void GYEmulator::thread_command() {
+	uint8_t buff[1500], reply[1500];
+	struct sockaddr_in peer;
+	socklen_t len;
+	int n;
+
+	while (running_) {
+		len = sizeof(peer);
+		if ((n = recvfrom(sockcmd_, buff, sizeof(buff), 0, (struct sockaddr*) &peer, &len)) > 0) {
+			tmlast_ = bc::steady_clock::now();
+			if ((n = process_command(buff, n, reply)) > 0)
+				sendto(sockcmd_, reply, n, 0, (struct sockaddr*) &peer, len);
+		}
+		// 心跳超时: 释放控制权
+		if (reg_get(0x0A00) && bc::steady_clock::now() - tmlast_ > bc::milliseconds(reg_get(0x0938))) {
+			mutex_lock lck(mtxreg_);
+			regs_[0x0A00] = 0;
+			mutex_lock lck1(mtxmet_);
+			++metrics_.heartbeat;
+		}
+	}
+}
+
+void GYEmulator::thread_expose() {
+	mutex_lock lck(mtxreg_);
+
+	while (running_) {
+		if (!resend_.empty()) {
+			lck.unlock();
+			flush_resend();
+			lck.lock();
+			continue;
+		}
+		if (!expose_) {
+			cvexp_.wait(lck);
+			continue;
+		}
+		expose_ = false;
+		// 曝光: 可被中止. 曝光期间继续处理上一帧的重传
+		bc::steady_clock::time_point tmend = bc::steady_clock::now() + bc::microseconds(regs_[0x20010]);
+		while (running_ && !abort_) {
+			if (!resend_.empty()) {
+				lck.unlock();
+				flush_resend();
+				lck.lock();
+			}
+			else if (cvexp_.wait_until(lck, tmend) == boost::cv_status::timeout) break;
+		}
+		if (!running_ || abort_) {
+			abort_ = false;
+			continue;
+		}
+		if (++block_ == 0) block_ = 1;	// 数据块编号0保留
+		lck.unlock();
+
+		make_image();
+		uint32_t count = packet_count();
+		{
+			mutex_lock lck1(mtxdata_);
+			send_packet(GVSP_LEADER, 0);
+		}
+		for (uint32_t first = 1; first <= count && running_; first += EMU_RESEND_BURST) {
+			uint32_t last = count - first < EMU_RESEND_BURST ? count : first + EMU_RESEND_BURST - 1;
+			send_range(first, last);
+			flush_resend();	// 重传穿插在图像数据之间
+		}
+		{
+			mutex_lock lck1(mtxdata_);
+			send_packet(GVSP_TRAILER, count + 1);
+		}
+		{
+			mutex_lock lck1(mtxmet_);
+			++metrics_.frames;
+		}
+		lck.lock();
+	}
+}
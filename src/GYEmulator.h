@@ -0,0 +1,235 @@
+/*!
+ * @file GYEmulator.h GWAC-GY相机GigE-Vision协议仿真器声明文件
+ * @version 0.1
+ * @date 2026-10-17
+ * @note
+ * 实现CameraGY使用的GVCP/GVSP子集, 用于无相机时的功能与负载测试:
+ * - GVCP: DISCOVERY, READREG/WRITEREG(多地址), PACKETRESEND; 心跳超时后释放GevCCP
+ * - 寄存器: 网络配置、GevCCP、GevSCPHostPort、GevSCPS(含测试包与DF标志)、GevSCPD、GevSCDA、
+ *   图像尺寸、增益、快门、曝光时间、启动/中止曝光
+ * - GVSP: 引导/数据/结尾包, 最后一个数据包附加64字节校验信息
+ * - 传输损伤: 丢包、乱序、重复与包间延时, 对首次发送与重传均生效
+ * - PACKETRESEND只登记重传区间, 由图像发送线程在图像数据之间穿插发送, 不阻塞GVCP服务
+ * - 瓶颈链路: 按带宽与队列长度模拟交换机缓存溢出, 发送速率超出带宽时丢包
+ * - GevSCPD以时间戳计数为单位, 时间戳频率1GHz, 即1纳秒
+ */
+
+#ifndef SRC_GYEMULATOR_H_
+#define SRC_GYEMULATOR_H_
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include <boost/random.hpp>
+#include <boost/chrono.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::string;
+
+/*!
+ * @struct GYEmuParameter 仿真参数
+ */
+struct GYEmuParameter {
+	uint16_t port;		//< GVCP服务端口
+	string ip;			//< 相机IP地址, 用于DISCOVERY应答
+	int width;			//< 图像宽度
+	int height;			//< 图像高度
+	int mtu;			//< 网络MTU. GevSCPS置DF标志时, 超出该长度的数据包不发送
+	int delay;			//< 包间延时下限, 量纲: 微秒. 与GevSCPD取大者
+	double loss;		//< 丢包概率
+	double reorder;		//< 与下一个数据包交换顺序的概率
+	double duplicate;	//< 重复发送的概率
+	int bandwidth;		//< 瓶颈链路带宽, 量纲: Mbps. 0: 不限制
+	int queue;			//< 瓶颈链路队列长度, 量纲: 数据包
+	uint32_t seed;		//< 随机数种子
+
+public:
+	GYEmuParameter() {
+		port      = 3956;
+		ip        = "127.0.0.1";
+		width     = 4096;
+		height    = 4096;
+		mtu       = 9000;
+		delay     = 0;
+		loss      = 0.0;
+		reorder   = 0.0;
+		duplicate = 0.0;
+		bandwidth = 0;
+		queue     = 64;
+		seed      = 1;
+	}
+};
+
+/*!
+ * @struct GYEmuMetrics 仿真统计
+ */
+struct GYEmuMetrics {
+	uint64_t commands;	//< GVCP指令数量
+	uint64_t frames;	//< 已发送帧数
+	uint64_t packets;	//< 已发送GVSP数据包数量, 含重传与重复
+	uint64_t dropped;	//< 模拟丢弃的数据包数量
+	uint64_t reordered;	//< 模拟乱序的数据包数量
+	uint64_t duplicated;//< 模拟重复的数据包数量
+	uint64_t congested;	//< 瓶颈链路队列溢出丢弃的数据包数量
+	uint64_t resends;	//< PACKETRESEND请求数量
+	uint64_t resent;	//< 重传的数据包数量
+	uint64_t heartbeat;	//< 心跳超时次数
+};
+
+class GYEmulator : private boost::noncopyable {
+public:
+	GYEmulator(const GYEmuParameter &param);
+	virtual ~GYEmulator();
+
+public:
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+	typedef boost::shared_ptr<boost::thread> threadptr;
+	typedef std::map<uint32_t, uint32_t> RegMap;
+
+	struct ResendRange {// 重传区间
+		uint16_t block;		//< 数据块编号
+		uint32_t first;		//< 首个数据包编号
+		uint32_t last;		//< 最后一个数据包编号
+	};
+	typedef std::deque<ResendRange> ResendQueue;
+
+protected:
+	/* 成员变量 */
+	GYEmuParameter param_;	//< 仿真参数
+	int sockcmd_;			//< 套接字: GVCP
+	int sockdata_;			//< 套接字: GVSP
+	bool running_;			//< 运行标志
+	RegMap regs_;			//< 寄存器
+	boost::mutex mtxreg_;	//< 互斥锁: 寄存器、曝光请求与重传队列
+	boost::chrono::steady_clock::time_point tmlast_;	//< 最近一次收到指令的时间
+
+	/* 图像数据 */
+	std::vector<uint8_t> image_;	//< 图像数据, 含64字节校验信息
+	uint16_t block_;		//< 当前帧编号
+	boost::mutex mtxdata_;	//< 互斥锁: 图像数据、数据发送与随机数
+	boost::chrono::steady_clock::time_point tmnext_;	//< 下一个数据包的最早发送时间
+	boost::chrono::steady_clock::time_point tmdrain_;	//< 瓶颈链路队列排空时间
+	bool expose_;			//< 曝光请求
+	bool abort_;			//< 中止请求
+	ResendQueue resend_;	//< 重传队列
+	boost::condition_variable cvexp_;	//< 事件: 启动曝光或请求重传
+	boost::mt19937 rng_;	//< 随机数: 传输损伤
+	boost::uniform_01<> uni_;
+
+	GYEmuMetrics metrics_;	//< 仿真统计
+	boost::mutex mtxmet_;	//< 互斥锁: 统计
+	threadptr thrdcmd_;		//< 线程: GVCP服务
+	threadptr thrdexp_;		//< 线程: 曝光与图像发送
+
+public:
+	/*!
+	 * @brief 启动服务
+	 * @return
+	 * 操作结果
+	 */
+	bool Start();
+	/*!
+	 * @brief 停止服务
+	 */
+	void Stop();
+	/*!
+	 * @brief 查看仿真统计
+	 */
+	GYEmuMetrics GetMetrics();
+	/*!
+	 * @brief 生成仿真统计的文本
+	 */
+	string Summary();
+
+protected:
+	/*!
+	 * @brief 初始化寄存器
+	 */
+	void init_registers();
+	/*!
+	 * @brief 读寄存器. 未定义的地址返回0
+	 */
+	uint32_t reg_get(uint32_t addr);
+	/*!
+	 * @brief 写寄存器, 并处理写入引发的动作
+	 */
+	void reg_set(uint32_t addr, uint32_t val);
+	/*!
+	 * @brief 处理一条GVCP指令
+	 * @param buff  指令
+	 * @param n     指令长度
+	 * @param reply 应答, 含包头
+	 * @return
+	 * 应答长度. 0: 无需应答
+	 */
+	int process_command(const uint8_t *buff, int n, uint8_t *reply);
+	/*!
+	 * @brief 生成一帧图像数据
+	 * @note
+	 * 像素值为(x + y + block) & 0xFFFF, 便于接收端校验
+	 */
+	void make_image();
+	/*!
+	 * @brief 发送测试包
+	 * @param scps GevSCPS寄存器的写入值
+	 */
+	void send_test(uint32_t scps);
+	/*!
+	 * @brief 发送一个GVSP数据包
+	 * @param format 数据包类型
+	 * @param id     数据包编号. 0: 引导; 数据包数量+1: 结尾
+	 * @return
+	 * 是否已发送
+	 */
+	bool send_packet(uint8_t format, uint32_t id);
+	/*!
+	 * @brief 按传输损伤发送编号[first, last]的数据包
+	 * @return
+	 * 实际发送的数据包数量
+	 */
+	int send_range(uint32_t first, uint32_t last);
+	/*!
+	 * @brief 发送重传队列中的数据包. 仅由图像发送线程调用
+	 * @note
+	 * 不属于当前帧的区间被丢弃
+	 */
+	void flush_resend();
+	/*!
+	 * @brief 按传输损伤发送一个数据包: 丢弃或重复
+	 */
+	int impair_packet(uint32_t id);
+	/*!
+	 * @brief 包间延时: 取GevSCPD与参数中的大者
+	 */
+	void packet_delay();
+	/*!
+	 * @brief 瓶颈链路: 数据包进入队列
+	 * @param bytes 数据包长度, 含IP与UDP包头
+	 * @return
+	 * 队列已满, 数据包被丢弃
+	 */
+	bool congest(int bytes);
+	/*!
+	 * @brief 每个数据包的有效数据长度
+	 */
+	int payload_size();
+	/*!
+	 * @brief 数据包数量, 不含引导与结尾
+	 */
+	uint32_t packet_count();
+	/*!
+	 * @brief 线程: GVCP服务. 同时检查心跳超时
+	 */
+	void thread_command();
+	/*!
+	 * @brief 线程: 曝光并发送图像与重传数据包
+	 */
+	void thread_expose();
+};
+
+#endif /* SRC_GYEMULATOR_H_ */
@@ -9,22 +9,75 @@
 #include <boost/bind.hpp>
 #include "IOServiceKeep.h"
 
-IOServiceKeep::IOServiceKeep() {
+//////////////////////////////////////////////////////////////////////////////
+/*---------------- IOExecutor: 执行器 ----------------*/
+int IOExecutor::sharedthreads_ = IO_THREADS_DEFAULT;
+
+IOExecutor::IOExecutor(int threads) {
 	work_.reset(new work(ios_));
-	thrdkeep_.reset(new boost::thread(boost::bind(&IOServiceKeep::thread_keep, this)));
+	if (threads < 1) threads = 1;
+	for (int i = 0; i < threads; ++i)
+		threads_.push_back(threadptr(new boost::thread(boost::bind(&IOExecutor::thread_run, this))));
 }
 
-IOServiceKeep::~IOServiceKeep() {
+IOExecutor::~IOExecutor() {
 	work_.reset();
 	ios_.stop();
-	thrdkeep_->join();
-	thrdkeep_.reset();
+	for (size_t i = 0; i < threads_.size(); ++i) {
+		// 最后一个引用在本执行器的回调函数中释放时, 无法等待自身结束
+		if (threads_[i]->get_id() == boost::this_thread::get_id()) threads_[i]->detach();
+		else threads_[i]->join();
+	}
+	threads_.clear();
 }
 
-io_service& IOServiceKeep::GetService() {
+io_service& IOExecutor::GetService() {
 	return ios_;
 }
 
-void IOServiceKeep::thread_keep() {
+int IOExecutor::Threads() {
+	return int(threads_.size());
+}
+
+IOExecPtr IOExecutor::Shared() {
+	static boost::mutex mtx;
+	static IOExecPtr shared;
+
+	boost::unique_lock<boost::mutex> lck(mtx);
+	if (!shared.use_count()) shared = boost::make_shared<IOExecutor>(sharedthreads_);
+	return shared;
+}
+
+void IOExecutor::SetSharedThreads(int threads) {
+	sharedthreads_ = threads > 0 ? threads : IO_THREADS_DEFAULT;
+}
+
+void IOExecutor::thread_run() {
 	ios_.run();
 }
+
+//////////////////////////////////////////////////////////////////////////////
+/*---------------- IOServiceKeep: 网络连接与执行器的绑定 ----------------*/
+IOServiceKeep::IOServiceKeep(const IOExecPtr& exec)
+	: exec_(exec.use_count() ? exec : IOExecutor::Shared())
+	, strand_(exec_->GetService()) {
+	guard_ = boost::make_shared<Guard>();
+	guard_->alive = true;
+}
+
+IOServiceKeep::~IOServiceKeep() {
+	Shutdown();
+}
+
+io_service& IOServiceKeep::GetService() {
+	return exec_->GetService();
+}
+
+IOExecPtr IOServiceKeep::GetExecutor() {
+	return exec_;
+}
+
+void IOServiceKeep::Shutdown() {
+	guard_lock lck(guard_->mtx);
+	guard_->alive = false;
+}
@@ -7,6 +7,13 @@
  * @li boost::asio::io_service::run()在响应所注册的异步调用后自动退出. 为了避免退出run()函数,
  * 建立ioservice_keep维护其长期有效性
  * @li 使用shared_ptr管理指针
+ *
+ * @date 2026-10-17
+ * @version 0.2
+ * @li IOExecutor: 由多个线程运行的io_service. 进程内的网络连接默认共享同一执行器,
+ * 不再为每个套接字创建线程
+ * @li IOServiceKeep: 将网络连接绑定至执行器. 同一连接的回调函数经strand串行执行,
+ * 保持顺序; Shutdown()后不再调用回调函数, 连接对象可安全析构
  */
 
 #ifndef IOSERVICEKEEP_H_
@@ -16,14 +23,20 @@
 #include <boost/thread.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <vector>
 
 using boost::asio::io_service;
 
-class IOServiceKeep : private boost::noncopyable {
+#define IO_THREADS_DEFAULT	2	//< 共享执行器默认线程数
+
+class IOExecutor : private boost::noncopyable {
 public:
-	// 构造函数与析构函数
-	IOServiceKeep();
-	virtual ~IOServiceKeep();
+	/*!
+	 * @brief 构造函数
+	 * @param threads 运行io_service的线程数
+	 */
+	IOExecutor(int threads = 1);
+	virtual ~IOExecutor();
 
 protected:
 	// 数据类型
@@ -31,21 +44,125 @@ protected:
 	typedef boost::shared_ptr<work> workptr;
 	typedef boost::shared_ptr<boost::thread> threadptr;
 
-private:
+protected:
 	// 成员变量
 	io_service ios_;		//< io_service对象
 	workptr work_;			//< io_service守护对象
-	threadptr thrdkeep_;	//< 线程
+	std::vector<threadptr> threads_;	//< 线程
+
+	static int sharedthreads_;	//< 共享执行器线程数
 
 public:
-	// 属性函数
+	/*!
+	 * @brief 查看io_service对象
+	 */
 	io_service& GetService();
+	/*!
+	 * @brief 查看线程数
+	 */
+	int Threads();
+	/*!
+	 * @brief 进程内共享的执行器. 首次调用时创建
+	 */
+	static boost::shared_ptr<IOExecutor> Shared();
+	/*!
+	 * @brief 设置共享执行器线程数
+	 * @note
+	 * 在首次调用Shared()前有效, 即在建立首个网络连接前调用
+	 */
+	static void SetSharedThreads(int threads);
 
 protected:
 	/*!
 	 * @brief 线程: 运行io_service::run()
 	 */
-	void thread_keep();
+	void thread_run();
+};
+typedef boost::shared_ptr<IOExecutor> IOExecPtr;
+
+class IOServiceKeep : private boost::noncopyable {
+public:
+	// 构造函数与析构函数
+	/*!
+	 * @param exec 执行器. 空指针表示共享执行器
+	 */
+	IOServiceKeep(const IOExecPtr& exec = IOExecPtr());
+	virtual ~IOServiceKeep();
+
+protected:
+	// 数据类型
+	typedef boost::recursive_mutex guard_mutex;	//< 回调函数可能析构其所属对象
+	typedef boost::unique_lock<guard_mutex> guard_lock;
+	typedef boost::asio::io_service::strand strand;
+
+	/*!
+	 * @struct Guard 回调函数有效性
+	 */
+	struct Guard {
+		guard_mutex mtx;	//< 互斥锁: 执行回调函数
+		bool alive;			//< 所属对象有效
+	};
+	typedef boost::shared_ptr<Guard> guardptr;
+
+public:
+	/*!
+	 * @class Guarded 检查所属对象有效性后执行的回调函数
+	 */
+	template <class Handler>
+	class Guarded {
+	public:
+		Guarded(const guardptr& guard, const Handler& handler)
+			: guard_(guard), handler_(handler) {
+		}
+
+		void operator()() {
+			guard_lock lck(guard_->mtx);
+			if (guard_->alive) handler_();
+		}
+
+		template <class A1>
+		void operator()(const A1& a1) {
+			guard_lock lck(guard_->mtx);
+			if (guard_->alive) handler_(a1);
+		}
+
+		template <class A1, class A2>
+		void operator()(const A1& a1, const A2& a2) {
+			guard_lock lck(guard_->mtx);
+			if (guard_->alive) handler_(a1, a2);
+		}
+
+	private:
+		guardptr guard_;	//< 回调函数有效性
+		Handler handler_;	//< 回调函数
+	};
+
+private:
+	// 成员变量
+	IOExecPtr exec_;	//< 执行器
+	strand strand_;		//< 串行执行本连接的回调函数
+	guardptr guard_;	//< 回调函数有效性
+
+public:
+	// 属性函数
+	io_service& GetService();
+	/*!
+	 * @brief 查看执行器
+	 */
+	IOExecPtr GetExecutor();
+	/*!
+	 * @brief 封装异步操作的回调函数: 经strand串行执行, Shutdown()后不再执行
+	 */
+	template <class Handler>
+	auto Wrap(const Handler& handler) -> decltype(strand_.wrap(Guarded<Handler>(guard_, handler))) {
+		return strand_.wrap(Guarded<Handler>(guard_, handler));
+	}
+	/*!
+	 * @brief 停止执行回调函数
+	 * @note
+	 * 等待正在执行的回调函数结束. 所属对象在析构函数起始处调用
+	 */
+	void Shutdown();
 };
 
 #endif /* IOSERVICEKEEP_H_ */
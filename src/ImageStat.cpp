@@ -0,0 +1,327 @@
+/*!
+ * @file ImageStat.cpp 单帧图像统计定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * 16位数据的向量计算:
+ * - 数值翻转最高位后作为有符号数处理, 使SSE2即可比较大小, 并以_mm_madd_epi16计算累加和与平方和
+ * - 16位饱和计数与32位累加和按块回写至64位累加器, 避免溢出
+ * 直方图以4张表交替累加, 减少相邻像素同值时的存储-加载依赖
+ */
+
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "ImageStat.h"
+
+#define HIST_TABLES	4		//< 直方图累加表数量
+#define VEC_BLOCK	4096	//< 向量累加器回写周期, 量纲: 次
+
+/*!
+ * @struct stat_accum 统计累加器
+ */
+struct stat_accum {
+	uint32_t minv, maxv;
+	int64_t sum;		//< 累加和: 16位数据为去偏置后的累加和
+	double sumsq;		//< 平方和: 16位数据为去偏置后的平方和
+	uint64_t sumsq64;	//< 16位数据去偏置后的平方和
+	uint64_t saturated;
+
+public:
+	stat_accum() {
+		minv = UINT32_MAX;
+		maxv = 0;
+		sum = 0;
+		sumsq = 0.0;
+		sumsq64 = 0;
+		saturated = 0;
+	}
+};
+
+uint32_t FrameStat::Percentile(double q) const {
+	if (!pixels || histogram.size() != HISTOGRAM_BINS) return 0;
+	uint64_t rank = uint64_t(ceil(q * 0.01 * pixels)), cum(0);
+	uint32_t i;
+	if (rank < 1) rank = 1;
+	else if (rank > pixels) rank = pixels;
+	for (i = 0; i < HISTOGRAM_BINS && (cum += histogram[i]) < rank; ++i);
+	return i << shift;
+}
+
+/*!
+ * @brief 标量统计, 用于8/32位数据与向量计算的余量
+ * @param offset 累加和与平方和计算前减去的偏置
+ */
+template <class T>
+static void stat_scalar(const T *data, size_t pixels, uint32_t satlevel, int shift, uint32_t offset,
+		uint32_t **hist, stat_accum &acc) {
+	size_t i;
+	for (i = 0; i < pixels; ++i) {
+		uint32_t v = data[i];
+		int64_t c = int64_t(v) - offset;
+		if (v < acc.minv) acc.minv = v;
+		if (v > acc.maxv) acc.maxv = v;
+		if (v >= satlevel) ++acc.saturated;
+		acc.sum   += c;
+		acc.sumsq += double(c) * c;
+		++hist[i & (HIST_TABLES - 1)][v >> shift];
+	}
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+/*!
+ * @brief 对向量累加器中的32位整数求和
+ */
+static int64_t sum_epi32(const int32_t *lanes, int n) {
+	int64_t sum(0);
+	for (int i = 0; i < n; ++i) sum += lanes[i];
+	return sum;
+}
+#endif
+
+/*!
+ * @brief 16位数据统计
+ */
+static void stat_uint16(const uint16_t *data, size_t pixels, uint32_t satlevel, uint32_t **hist, stat_accum &acc) {
+	size_t i(0);
+	uint16_t v;
+
+#if defined(__AVX2__)
+	const __m256i bias = _mm256_set1_epi16(short(0x8000));
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i mask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+	const __m256i satc = _mm256_set1_epi16(short((satlevel ^ 0x8000) - 1));
+	__m256i vmin = _mm256_set1_epi16(0x7FFF), vmax = _mm256_set1_epi16(short(0x8000));
+	__m256i vsq = _mm256_setzero_si256();
+	int32_t lanes[8];
+	int16_t cnts[16];
+
+	while (i + 16 <= pixels) {
+		__m256i vsum = _mm256_setzero_si256(), vsat = _mm256_setzero_si256();
+		for (int blk = 0; blk < VEC_BLOCK && i + 16 <= pixels; ++blk, i += 16) {
+			const uint16_t *ptr = data + i;
+			__m256i c = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) ptr), bias);
+			__m256i sq = _mm256_madd_epi16(c, c);
+			vmin = _mm256_min_epi16(vmin, c);
+			vmax = _mm256_max_epi16(vmax, c);
+			vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(c, ones));
+			vsq  = _mm256_add_epi64(vsq, _mm256_add_epi64(_mm256_and_si256(sq, mask), _mm256_srli_epi64(sq, 32)));
+			vsat = _mm256_sub_epi16(vsat, _mm256_cmpgt_epi16(c, satc));
+			for (int k = 0; k < 16; k += 4) {
+				++hist[0][ptr[k]];
+				++hist[1][ptr[k + 1]];
+				++hist[2][ptr[k + 2]];
+				++hist[3][ptr[k + 3]];
+			}
+		}
+		_mm256_storeu_si256((__m256i*) lanes, vsum);
+		acc.sum += sum_epi32(lanes, 8);
+		_mm256_storeu_si256((__m256i*) cnts, vsat);
+		for (int k = 0; k < 16; ++k) acc.saturated += uint16_t(cnts[k]);
+	}
+	uint64_t sq64[4];
+	int16_t mins[16], maxs[16];
+	_mm256_storeu_si256((__m256i*) sq64, vsq);
+	_mm256_storeu_si256((__m256i*) mins, vmin);
+	_mm256_storeu_si256((__m256i*) maxs, vmax);
+	for (int k = 0; k < 4; ++k) acc.sumsq64 += sq64[k];
+	for (int k = 0; k < 16 && i; ++k) {
+		if ((v = uint16_t(mins[k] ^ 0x8000)) < acc.minv) acc.minv = v;
+		if ((v = uint16_t(maxs[k] ^ 0x8000)) > acc.maxv) acc.maxv = v;
+	}
+#elif defined(__SSE2__)
+	const __m128i bias = _mm_set1_epi16(short(0x8000));
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+	const __m128i satc = _mm_set1_epi16(short((satlevel ^ 0x8000) - 1));
+	__m128i vmin = _mm_set1_epi16(0x7FFF), vmax = _mm_set1_epi16(short(0x8000));
+	__m128i vsq = _mm_setzero_si128();
+	int32_t lanes[4];
+	int16_t cnts[8];
+
+	while (i + 8 <= pixels) {
+		__m128i vsum = _mm_setzero_si128(), vsat = _mm_setzero_si128();
+		for (int blk = 0; blk < VEC_BLOCK && i + 8 <= pixels; ++blk, i += 8) {
+			const uint16_t *ptr = data + i;
+			__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*) ptr), bias);
+			__m128i sq = _mm_madd_epi16(c, c);
+			vmin = _mm_min_epi16(vmin, c);
+			vmax = _mm_max_epi16(vmax, c);
+			vsum = _mm_add_epi32(vsum, _mm_madd_epi16(c, ones));
+			vsq  = _mm_add_epi64(vsq, _mm_add_epi64(_mm_and_si128(sq, mask), _mm_srli_epi64(sq, 32)));
+			vsat = _mm_sub_epi16(vsat, _mm_cmpgt_epi16(c, satc));
+			for (int k = 0; k < 8; k += 4) {
+				++hist[0][ptr[k]];
+				++hist[1][ptr[k + 1]];
+				++hist[2][ptr[k + 2]];
+				++hist[3][ptr[k + 3]];
+			}
+		}
+		_mm_storeu_si128((__m128i*) lanes, vsum);
+		acc.sum += sum_epi32(lanes, 4);
+		_mm_storeu_si128((__m128i*) cnts, vsat);
+		for (int k = 0; k < 8; ++k) acc.saturated += uint16_t(cnts[k]);
+	}
+	uint64_t sq64[2];
+	int16_t mins[8], maxs[8];
+	_mm_storeu_si128((__m128i*) sq64, vsq);
+	_mm_storeu_si128((__m128i*) mins, vmin);
+	_mm_storeu_si128((__m128i*) maxs, vmax);
+	acc.sumsq64 += sq64[0] + sq64[1];
+	for (int k = 0; k < 8 && i; ++k) {
+		if ((v = uint16_t(mins[k] ^ 0x8000)) < acc.minv) acc.minv = v;
+		if ((v = uint16_t(maxs[k] ^ 0x8000)) > acc.maxv) acc.maxv = v;
+	}
+#endif
+	acc.sumsq += double(acc.sumsq64);
+	stat_scalar(data + i, pixels - i, satlevel, 0, 0x8000, hist, acc);
+}
+
+/*!
+ * @brief 32位数据统计
+ */
+static void stat_uint32(const uint32_t *data, size_t pixels, uint32_t satlevel, uint32_t **hist, stat_accum &acc) {
+	size_t i(0);
+
+#if defined(__AVX2__)
+	const __m256i bias = _mm256_set1_epi32(int(0x80000000));
+	const __m256i satc = _mm256_set1_epi32(int(satlevel ^ 0x80000000) - 1);
+	__m256i vmin = _mm256_set1_epi32(-1), vmax = _mm256_setzero_si256();
+	__m256i vsum = _mm256_setzero_si256(), vsat = _mm256_setzero_si256();
+	__m256d vsq = _mm256_setzero_pd();
+
+	for (; i + 8 <= pixels; i += 8) {
+		const uint32_t *ptr = data + i;
+		__m256i v = _mm256_loadu_si256((const __m256i*) ptr);
+		__m256i c = _mm256_xor_si256(v, bias);
+		__m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(c));
+		__m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(c, 1));
+		vmin = _mm256_min_epu32(vmin, v);
+		vmax = _mm256_max_epu32(vmax, v);
+		vsum = _mm256_add_epi64(vsum, _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(c)),
+				_mm256_cvtepi32_epi64(_mm256_extracti128_si256(c, 1))));
+		vsq  = _mm256_add_pd(vsq, _mm256_add_pd(_mm256_mul_pd(lo, lo), _mm256_mul_pd(hi, hi)));
+		vsat = _mm256_sub_epi32(vsat, _mm256_cmpgt_epi32(c, satc));
+		for (int k = 0; k < 8; k += 4) {
+			++hist[0][ptr[k] >> 16];
+			++hist[1][ptr[k + 1] >> 16];
+			++hist[2][ptr[k + 2] >> 16];
+			++hist[3][ptr[k + 3] >> 16];
+		}
+	}
+	uint32_t mins[8], maxs[8], cnts[8];
+	int64_t sums[4];
+	double sqs[4];
+	_mm256_storeu_si256((__m256i*) mins, vmin);
+	_mm256_storeu_si256((__m256i*) maxs, vmax);
+	_mm256_storeu_si256((__m256i*) cnts, vsat);
+	_mm256_storeu_si256((__m256i*) sums, vsum);
+	_mm256_storeu_pd(sqs, vsq);
+	for (int k = 0; k < 8 && i; ++k) {
+		if (mins[k] < acc.minv) acc.minv = mins[k];
+		if (maxs[k] > acc.maxv) acc.maxv = maxs[k];
+		acc.saturated += cnts[k];
+	}
+	for (int k = 0; k < 4; ++k) {
+		acc.sum   += sums[k];
+		acc.sumsq += sqs[k];
+	}
+#elif defined(__SSE2__)
+	// SSE2无32位无符号比较与64位扩展: 以去偏置后的有符号数比较, 符号位扩展后累加
+	const __m128i bias = _mm_set1_epi32(int(0x80000000));
+	const __m128i satc = _mm_set1_epi32(int(satlevel ^ 0x80000000) - 1);
+	__m128i vmin = _mm_set1_epi32(0x7FFFFFFF), vmax = _mm_set1_epi32(int(0x80000000));
+	__m128i vsum = _mm_setzero_si128(), vsat = _mm_setzero_si128();
+	__m128d vsq = _mm_setzero_pd();
+
+	for (; i + 4 <= pixels; i += 4) {
+		const uint32_t *ptr = data + i;
+		__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*) ptr), bias);
+		__m128i sign = _mm_srai_epi32(c, 31);
+		__m128i lt = _mm_cmpgt_epi32(vmin, c);
+		__m128i gt = _mm_cmpgt_epi32(c, vmax);
+		__m128d lo = _mm_cvtepi32_pd(c);
+		__m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2)));
+		vmin = _mm_or_si128(_mm_and_si128(lt, c), _mm_andnot_si128(lt, vmin));
+		vmax = _mm_or_si128(_mm_and_si128(gt, c), _mm_andnot_si128(gt, vmax));
+		vsum = _mm_add_epi64(vsum, _mm_add_epi64(_mm_unpacklo_epi32(c, sign), _mm_unpackhi_epi32(c, sign)));
+		vsq  = _mm_add_pd(vsq, _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+		vsat = _mm_sub_epi32(vsat, _mm_cmpgt_epi32(c, satc));
+		++hist[0][ptr[0] >> 16];
+		++hist[1][ptr[1] >> 16];
+		++hist[2][ptr[2] >> 16];
+		++hist[3][ptr[3] >> 16];
+	}
+	int32_t mins[4], maxs[4];
+	uint32_t cnts[4];
+	int64_t sums[2];
+	double sqs[2];
+	_mm_storeu_si128((__m128i*) mins, vmin);
+	_mm_storeu_si128((__m128i*) maxs, vmax);
+	_mm_storeu_si128((__m128i*) cnts, vsat);
+	_mm_storeu_si128((__m128i*) sums, vsum);
+	_mm_storeu_pd(sqs, vsq);
+	for (int k = 0; k < 4 && i; ++k) {
+		uint32_t v;
+		if ((v = uint32_t(mins[k]) ^ 0x80000000) < acc.minv) acc.minv = v;
+		if ((v = uint32_t(maxs[k]) ^ 0x80000000) > acc.maxv) acc.maxv = v;
+		acc.saturated += cnts[k];
+	}
+	acc.sum   += sums[0] + sums[1];
+	acc.sumsq += sqs[0] + sqs[1];
+#endif
+	stat_scalar(data + i, pixels - i, satlevel, 16, 0x80000000, hist, acc);
+}
+
+bool ImageStatistics(const void *data, size_t pixels, int bytepix, int bitpixel, FrameStat &stat) {
+	stat.Reset();
+	if (!data || !pixels || !(bytepix == 1 || bytepix == 2 || bytepix == 4)) return false;
+
+	std::vector<uint32_t> aux((HIST_TABLES - 1) * HISTOGRAM_BINS, 0);
+	uint32_t *hist[HIST_TABLES];
+	stat_accum acc;
+	uint32_t offset;
+
+	if (bitpixel <= 0 || bitpixel > bytepix * 8) bitpixel = bytepix * 8;
+	stat.satlevel = bitpixel >= 32 ? UINT32_MAX : (uint32_t(1) << bitpixel) - 1;
+	stat.pixels   = pixels;
+	stat.shift    = bytepix == 4 ? 16 : 0;
+	stat.histogram.assign(HISTOGRAM_BINS, 0);
+	hist[0] = &stat.histogram[0];
+	for (int i = 1; i < HIST_TABLES; ++i) hist[i] = &aux[(i - 1) * HISTOGRAM_BINS];
+
+	if (bytepix == 1) {
+		offset = 0;
+		stat_scalar((const uint8_t*) data, pixels, stat.satlevel, 0, offset, hist, acc);
+	}
+	else if (bytepix == 2) {
+		offset = 0x8000;
+		stat_uint16((const uint16_t*) data, pixels, stat.satlevel, hist, acc);
+	}
+	else {
+		offset = 0x80000000;
+		stat_uint32((const uint32_t*) data, pixels, stat.satlevel, hist, acc);
+	}
+	for (int i = 1; i < HIST_TABLES; ++i) {
+		const uint32_t *src = hist[i];
+		for (int j = 0; j < HISTOGRAM_BINS; ++j) hist[0][j] += src[j];
+	}
+
+	double mc  = double(acc.sum) / pixels;
+	double var = acc.sumsq / pixels - mc * mc;
+	stat.minv      = acc.minv;
+	stat.maxv      = acc.maxv;
+	stat.mean      = mc + offset;
+	stat.sigma     = var > 0.0 ? sqrt(var * pixels / (pixels > 1 ? pixels - 1 : 1)) : 0.0;
+	stat.saturated = acc.saturated;
+	stat.median    = stat.Percentile(50.0);
+	stat.p01       = stat.Percentile(1.0);
+	stat.p99       = stat.Percentile(99.0);
+	stat.valid     = true;
+	return true;
+}
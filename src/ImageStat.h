@@ -0,0 +1,72 @@
+/*!
+ * @file ImageStat.h 单帧图像统计声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 每帧完成读出后遍历一次全部像素, 统计结果存储在帧中, 供状态、平场控制与FITS文件头使用
+ * - 最小值、最大值、累加和、平方和与饱和像素数由SSE2/AVX2计算, 同一遍历中以标量累加直方图
+ * - 直方图为65536档: 16位及以下数据逐值统计; 32位数据按高16位统计
+ * - 中值与分位值由直方图得到
+ */
+
+#ifndef SRC_IMAGESTAT_H_
+#define SRC_IMAGESTAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define HISTOGRAM_BINS	65536	//< 直方图档数
+
+/*!
+ * @struct FrameStat 单帧统计结果
+ */
+struct FrameStat {
+	bool valid;			//< 统计结果有效
+	uint32_t minv;		//< 最小值
+	uint32_t maxv;		//< 最大值
+	double mean;		//< 均值
+	double sigma;		//< 标准差
+	uint32_t median;	//< 中值
+	uint32_t p01, p99;	//< 1%与99%分位值
+	uint32_t satlevel;	//< 饱和阈值
+	uint64_t saturated;	//< 饱和像素数
+	uint64_t pixels;	//< 像素数
+	int shift;			//< 直方图档位与数值的换算: 数值 = 档位 << shift
+	std::vector<uint32_t> histogram;	//< 直方图
+
+public:
+	FrameStat() {
+		Reset();
+	}
+
+	void Reset() {
+		valid = false;
+		minv = maxv = median = p01 = p99 = satlevel = 0;
+		mean = sigma = 0.0;
+		saturated = pixels = 0;
+		shift = 0;
+	}
+
+	/*!
+	 * @brief 由直方图计算分位值
+	 * @param q 分位, 量纲: 百分比
+	 * @return
+	 * 分位值
+	 */
+	uint32_t Percentile(double q) const;
+};
+
+/*!
+ * @brief 统计图像
+ * @param data      图像数据, 主机字节序的无符号整数
+ * @param pixels    像素数
+ * @param bytepix   单像素字节数: 1, 2或4
+ * @param bitpixel  单像素有效位数, 用于确定饱和阈值
+ * @param stat      统计结果
+ * @return
+ * 统计结果有效性
+ */
+bool ImageStatistics(const void *data, size_t pixels, int bytepix, int bitpixel, FrameStat &stat);
+
+#endif /* SRC_IMAGESTAT_H_ */
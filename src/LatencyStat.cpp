@@ -0,0 +1,96 @@
+/*!
+ * @file LatencyStat.cpp 单帧采集时延统计定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ */
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include "LatencyStat.h"
+
+LatencyStat::LatencyStat(int window) {
+	window_ = window > 0 ? window : 1024;
+	for (int i = 0; i < LATI_COUNT; ++i) stat_[i].samples.resize(window_);
+	Reset();
+}
+
+LatencyStat::~LatencyStat() {
+}
+
+void LatencyStat::Record(const FrameTimeline &timeline, float exptm) {
+	double ms, texp = exptm * 1000.0;
+
+	if ((ms = timeline.Elapse(LAT_COMMAND, LAT_STARTED)) >= 0.0)
+		Record(LATI_START, ms);
+	if ((ms = timeline.Elapse(LAT_STARTED, LAT_EXPEND)) >= 0.0)
+		Record(LATI_DETECT, ms > texp ? ms - texp : 0.0);
+	if ((ms = timeline.Elapse(LAT_EXPEND, LAT_READBEGIN)) >= 0.0)
+		Record(LATI_HANDOFF, ms);
+	if ((ms = timeline.Elapse(LAT_READBEGIN, LAT_READEND)) >= 0.0)
+		Record(LATI_READOUT, ms);
+	if ((ms = timeline.Elapse(LAT_READEND, LAT_WRITTEN)) >= 0.0)
+		Record(LATI_WRITE, ms);
+	if ((ms = timeline.Elapse(timeline.Marked(LAT_WRITTEN) ? LAT_WRITTEN : LAT_READEND, LAT_PUSHED)) >= 0.0)
+		Record(LATI_PUSH, ms);
+	if ((ms = timeline.Elapse(LAT_COMMAND, LAT_PUSHED)) >= 0.0)
+		Record(LATI_OVERHEAD, ms > texp ? ms - texp : 0.0);
+}
+
+void LatencyStat::Record(LATENCY_INTERVAL item, double ms) {
+	mutex_lock lck(mtx_);
+	Window &win = stat_[item];
+	win.samples[win.next] = ms;
+	if (++win.next == window_) win.next = 0;
+	if (win.count < window_) ++win.count;
+	if (ms > win.maxall) win.maxall = ms;
+}
+
+bool LatencyStat::Query(LATENCY_INTERVAL item, LatencyInfo &info) {
+	std::vector<double> buff;
+	{// 复制样本, 避免排序期间阻塞Record()
+		mutex_lock lck(mtx_);
+		Window &win = stat_[item];
+		if (!(info.count = win.count)) return false;
+		buff.assign(win.samples.begin(), win.samples.begin() + win.count);
+		info.maxall = win.maxall;
+	}
+
+	int n = buff.size();
+	std::vector<double>::iterator it50 = buff.begin() + n / 2;
+	std::vector<double>::iterator it99 = buff.begin() + (n * 99) / 100;
+	std::nth_element(buff.begin(), it99, buff.end());
+	info.p99 = *it99;
+	info.max = *std::max_element(it99, buff.end());
+	std::nth_element(buff.begin(), it50, it99);
+	info.p50 = it50 == it99 ? info.p99 : *it50;
+	return true;
+}
+
+std::string LatencyStat::Summary() {
+	boost::format fmt("\t %-9s: n = %4d, p50 = %8.2f, p99 = %8.2f, max = %8.2f (%.2f) ms\n");
+	std::string text;
+	LatencyInfo info;
+
+	for (int i = 0; i < LATI_COUNT; ++i) {
+		if (!Query(LATENCY_INTERVAL(i), info)) continue;
+		fmt % Name(LATENCY_INTERVAL(i)) % info.count % info.p50 % info.p99 % info.max % info.maxall;
+		text += fmt.str();
+	}
+	return text;
+}
+
+void LatencyStat::Reset() {
+	mutex_lock lck(mtx_);
+	for (int i = 0; i < LATI_COUNT; ++i) {
+		stat_[i].next   = 0;
+		stat_[i].count  = 0;
+		stat_[i].maxall = 0.0;
+	}
+}
+
+const char *LatencyStat::Name(LATENCY_INTERVAL item) {
+	static const char *names[] = {
+		"start", "detect", "handoff", "readout", "write", "push", "overhead"
+	};
+	return item < LATI_COUNT ? names[item] : "";
+}
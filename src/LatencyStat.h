@@ -0,0 +1,155 @@
+/*!
+ * @file LatencyStat.h 单帧采集时延统计声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 使用单调时钟记录单帧从接收指令到发送状态各阶段的时标
+ * - 按阶段维护滑动窗口, 统计中值、99%分位值与最大值
+ */
+
+#ifndef SRC_LATENCYSTAT_H_
+#define SRC_LATENCYSTAT_H_
+
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+enum LATENCY_STAGE {// 单帧采集阶段
+	LAT_COMMAND,	//< 收到曝光指令
+	LAT_STARTED,	//< start_expose()返回
+	LAT_EXPEND,		//< 检测到曝光结束
+	LAT_READBEGIN,	//< 开始读出
+	LAT_READEND,	//< 完成读出
+	LAT_WRITTEN,	//< 完成文件存储
+	LAT_PUSHED,		//< 工作状态进入总控服务器发送队列
+	LAT_STAGES
+};
+
+enum LATENCY_INTERVAL {// 时延统计项
+	LATI_START,		//< 收到指令至启动曝光
+	LATI_DETECT,	//< 检测曝光结束的滞后: 去除积分时间
+	LATI_HANDOFF,	//< 检测到曝光结束至开始读出
+	LATI_READOUT,	//< 读出
+	LATI_WRITE,		//< 完成读出至完成存储
+	LATI_PUSH,		//< 完成读出或存储至发送状态
+	LATI_OVERHEAD,	//< 收到指令至发送状态: 去除积分时间
+	LATI_COUNT
+};
+
+/*!
+ * @struct FrameTimeline 单帧各阶段时标
+ */
+struct FrameTimeline {
+	typedef boost::chrono::steady_clock::time_point steady_time;
+	steady_time stamp[LAT_STAGES];	//< 时标. 默认值表示未经过该阶段
+
+public:
+	/*!
+	 * @brief 清除全部时标
+	 */
+	void Reset() {
+		for (int i = 0; i < LAT_STAGES; ++i) stamp[i] = steady_time();
+	}
+
+	/*!
+	 * @brief 记录阶段时标
+	 * @param stage 阶段
+	 */
+	void Mark(LATENCY_STAGE stage) {
+		stamp[stage] = boost::chrono::steady_clock::now();
+	}
+
+	/*!
+	 * @brief 检查是否已记录阶段时标
+	 */
+	bool Marked(LATENCY_STAGE stage) const {
+		return stamp[stage] != steady_time();
+	}
+
+	/*!
+	 * @brief 计算两个阶段之间的时间
+	 * @return
+	 * 时间, 量纲: 毫秒. 任一阶段未记录时标时返回负值
+	 */
+	double Elapse(LATENCY_STAGE from, LATENCY_STAGE to) const {
+		if (!Marked(from) || !Marked(to)) return -1.0;
+		boost::chrono::duration<double, boost::milli> dt = stamp[to] - stamp[from];
+		return dt.count();
+	}
+};
+
+/*!
+ * @struct LatencyInfo 单项时延统计结果
+ */
+struct LatencyInfo {
+	int count;		//< 样本数量
+	double p50;		//< 中值, 量纲: 毫秒
+	double p99;		//< 99%分位值, 量纲: 毫秒
+	double max;		//< 窗口内最大值, 量纲: 毫秒
+	double maxall;	//< 全部样本的最大值, 量纲: 毫秒
+};
+
+class LatencyStat {
+public:
+	/*!
+	 * @param window 滑动窗口长度, 量纲: 帧
+	 */
+	LatencyStat(int window = 1024);
+	virtual ~LatencyStat();
+
+protected:
+	/*!
+	 * @struct Window 单项时延的滑动窗口
+	 */
+	struct Window {
+		std::vector<double> samples;	//< 样本
+		int next;		//< 下一个样本的存储位置
+		int count;		//< 窗口内样本数量
+		double maxall;	//< 全部样本的最大值
+	};
+	typedef boost::unique_lock<boost::mutex> mutex_lock;
+
+protected:
+	int window_;		//< 滑动窗口长度
+	Window stat_[LATI_COUNT];	//< 各项时延的滑动窗口
+	boost::mutex mtx_;	//< 互斥锁
+
+public:
+	/*!
+	 * @brief 统计单帧各阶段时延
+	 * @param timeline  单帧时标
+	 * @param exptm     积分时间, 量纲: 秒
+	 */
+	void Record(const FrameTimeline &timeline, float exptm);
+	/*!
+	 * @brief 加入单项时延样本
+	 * @param item  时延统计项
+	 * @param ms    时延, 量纲: 毫秒
+	 */
+	void Record(LATENCY_INTERVAL item, double ms);
+	/*!
+	 * @brief 查询单项时延统计结果
+	 * @param item  时延统计项
+	 * @param info  统计结果
+	 * @return
+	 * 窗口内有样本时返回true
+	 */
+	bool Query(LATENCY_INTERVAL item, LatencyInfo &info);
+	/*!
+	 * @brief 生成全部时延统计结果的文本
+	 * @return
+	 * 统计结果, 每项一行
+	 */
+	std::string Summary();
+	/*!
+	 * @brief 清除全部样本
+	 */
+	void Reset();
+	/*!
+	 * @brief 时延统计项名称
+	 */
+	static const char *Name(LATENCY_INTERVAL item);
+};
+
+#endif /* SRC_LATENCYSTAT_H_ */
@@ -0,0 +1,141 @@
+/*!
+ * @file SoftROI.cpp 软件ROI裁剪与像素合并定义文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * 原地处理的前提: 输出第n行时, 其覆盖的地址范围内的原数据已全部读取.
+ * 由于输出宽度不大于原宽度, 且第n行输出仅依赖原图像第n行及其后的数据, 按行顺序处理即可满足
+ */
+
+#include <string.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "SoftROI.h"
+
+/*!
+ * @brief 沿Y轴累加by行, 同时记录各列最大值
+ * @param src    首行起始地址
+ * @param pitch  原图像行宽度, 量纲: 像素
+ * @param rows   累加行数
+ * @param cols   列数
+ * @param acc    各列累加和
+ * @param peak   各列最大值
+ */
+template <class T, class A>
+static void sum_rows(const T *src, int pitch, int rows, int cols, A *acc, T *peak) {
+	int c, k;
+	for (c = 0; c < cols; ++c) acc[c] = peak[c] = src[c];
+	for (k = 1, src += pitch; k < rows; ++k, src += pitch) {
+		for (c = 0; c < cols; ++c) {
+			acc[c] += src[c];
+			if (src[c] > peak[c]) peak[c] = src[c];
+		}
+	}
+}
+
+static void sum_rows(const uint16_t *src, int pitch, int rows, int cols, uint32_t *acc, uint16_t *peak) {
+	int c(0), k;
+
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	for (; c + 16 <= cols; c += 16) {
+		const uint16_t *ptr = src + c;
+		__m256i v  = _mm256_loadu_si256((const __m256i*) ptr);
+		__m256i pk = v;
+		__m256i lo = _mm256_unpacklo_epi16(v, zero);
+		__m256i hi = _mm256_unpackhi_epi16(v, zero);
+		for (k = 1; k < rows; ++k) {
+			ptr += pitch;
+			v  = _mm256_loadu_si256((const __m256i*) ptr);
+			pk = _mm256_max_epu16(pk, v);
+			lo = _mm256_add_epi32(lo, _mm256_unpacklo_epi16(v, zero));
+			hi = _mm256_add_epi32(hi, _mm256_unpackhi_epi16(v, zero));
+		}
+		// unpack按128位通道交错, 还原列顺序
+		_mm256_storeu_si256((__m256i*) (acc + c),     _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*) (acc + c + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+		_mm256_storeu_si256((__m256i*) (peak + c), pk);
+	}
+#elif defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(short(0x8000));
+	for (; c + 8 <= cols; c += 8) {
+		const uint16_t *ptr = src + c;
+		__m128i v  = _mm_loadu_si128((const __m128i*) ptr);
+		__m128i pk = _mm_xor_si128(v, bias);
+		__m128i lo = _mm_unpacklo_epi16(v, zero);
+		__m128i hi = _mm_unpackhi_epi16(v, zero);
+		for (k = 1; k < rows; ++k) {
+			ptr += pitch;
+			v  = _mm_loadu_si128((const __m128i*) ptr);
+			pk = _mm_max_epi16(pk, _mm_xor_si128(v, bias));	// SSE2无无符号16位比较
+			lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+			hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+		}
+		_mm_storeu_si128((__m128i*) (acc + c),     lo);
+		_mm_storeu_si128((__m128i*) (acc + c + 4), hi);
+		_mm_storeu_si128((__m128i*) (peak + c), _mm_xor_si128(pk, bias));
+	}
+#endif
+	if (c < cols) sum_rows<uint16_t, uint32_t>(src + c, pitch, rows, cols - c, acc + c, peak + c);
+}
+
+/*!
+ * @brief 沿X轴合并并输出一行
+ */
+template <class T, class A>
+static void bin_cols(const A *acc, const T *peak, int bx, int n, int outW, int mode, uint32_t satlevel, T *out) {
+	int i, k;
+	A sum;
+	T pk;
+
+	for (i = 0; i < outW; ++i, acc += bx, peak += bx) {
+		for (k = 1, sum = acc[0], pk = peak[0]; k < bx; ++k) {
+			sum += acc[k];
+			if (peak[k] > pk) pk = peak[k];
+		}
+		if (pk >= satlevel) out[i] = T(satlevel);
+		else if (mode == SOFTBIN_MEAN) out[i] = T((sum + n / 2) / n);
+		else out[i] = sum >= satlevel ? T(satlevel) : T(sum);
+	}
+}
+
+template <class T, class A>
+static void crop_bin(T *data, int srcW, int x0, int y0, int bx, int by, int outW, int outH,
+		int mode, uint32_t satlevel) {
+	int cols = outW * bx;
+	std::vector<A> acc(cols);
+	std::vector<T> peak(cols);
+	int oy;
+
+	for (oy = 0; oy < outH; ++oy) {
+		const T *src = data + size_t(y0 + oy * by) * srcW + x0;
+		T *out = data + size_t(oy) * outW;
+		if (bx == 1 && by == 1) memmove(out, src, sizeof(T) * outW);
+		else {
+			sum_rows(src, srcW, by, cols, &acc[0], &peak[0]);
+			bin_cols(&acc[0], &peak[0], bx, bx * by, outW, mode, satlevel, out);
+		}
+	}
+}
+
+bool SoftCropBin(uint8_t *data, int bytepix, int srcW, int srcH, int x0, int y0, int bx, int by,
+		int outW, int outH, int mode, uint32_t satlevel) {
+	if (!data || bx < 1 || by < 1 || outW < 1 || outH < 1 || x0 < 0 || y0 < 0
+			|| x0 + outW * bx > srcW || y0 + outH * by > srcH)
+		return false;
+
+	if (bytepix == 1)
+		crop_bin<uint8_t, uint32_t>(data, srcW, x0, y0, bx, by, outW, outH, mode, satlevel);
+	else if (bytepix == 2)
+		crop_bin<uint16_t, uint32_t>((uint16_t*) data, srcW, x0, y0, bx, by, outW, outH, mode, satlevel);
+	else if (bytepix == 4)
+		crop_bin<uint32_t, uint64_t>((uint32_t*) data, srcW, x0, y0, bx, by, outW, outH, mode, satlevel);
+	else return false;
+	return true;
+}
@@ -0,0 +1,41 @@
+/*!
+ * @file SoftROI.h 软件ROI裁剪与像素合并声明文件
+ * @version 0.1
+ * @date 2026-10-16
+ * @note
+ * - 用于不支持硬件ROI/合并的相机: 读出完整的硬件区域后, 在帧缓存区内原地裁剪与合并
+ * - 16位数据的行方向累加由SSE2/AVX2完成, 列方向合并以标量处理
+ * - 合并区内任一像素饱和时, 输出饱和值; 累加和超出饱和值时截断
+ */
+
+#ifndef SRC_SOFTROI_H_
+#define SRC_SOFTROI_H_
+
+#include <stdint.h>
+
+enum SOFTBIN_MODE {// 软件合并方式
+	SOFTBIN_SUM,	//< 累加
+	SOFTBIN_MEAN	//< 均值
+};
+
+/*!
+ * @brief 原地裁剪与合并图像
+ * @param data      图像数据, 主机字节序的无符号整数. 输出结果自起始地址连续存储
+ * @param bytepix   单像素字节数: 1, 2或4
+ * @param srcW      原图像宽度
+ * @param srcH      原图像高度
+ * @param x0        裁剪区在原图像中的起始列, 起始坐标: 0
+ * @param y0        裁剪区在原图像中的起始行, 起始坐标: 0
+ * @param bx        X轴合并因子
+ * @param by        Y轴合并因子
+ * @param outW      输出图像宽度
+ * @param outH      输出图像高度
+ * @param mode      合并方式, SOFTBIN_MODE
+ * @param satlevel  饱和值
+ * @return
+ * 参数有效性
+ */
+bool SoftCropBin(uint8_t *data, int bytepix, int srcW, int srcH, int x0, int y0, int bx, int by,
+		int outW, int outH, int mode, uint32_t satlevel);
+
+#endif /* SRC_SOFTROI_H_ */
@@ -10,11 +10,15 @@
 #include "CameraFLICCD.h"
 #include "CameraApogee.h"
 #include "CameraGY.h"
+#include "CameraSim.h"
 
 using namespace boost::filesystem;
 
 cameracs::cameracs(boost::asio::io_service* ios) {
-	bufrcv_.reset(new char[TCP_PACK_SIZE]);
+	gcbinary_ = false;
+	gcseqsnd_ = 0;
+	gcseqrcv_ = 0;
+	memset(&cmdstat_, 0, sizeof(cmdstat_));
 }
 
 cameracs::~cameracs() {
@@ -32,6 +36,7 @@ bool cameracs::StartService() {
 		_gLog.Write(LOG_FAULT, NULL, "failed to load configured parameters");
 		return false;
 	}
+	IOExecutor::SetSharedThreads(param_->iothreads);	// 在建立首个网络连接前设置
 	if (!connect_server_gtoaes()) return false;
 	if (!connect_camera()) return false;
 	if (!connect_filter()) {
@@ -65,13 +70,27 @@ void cameracs::StopService() {
 	int_thread(thrd_state_);
 	int_thread(thrd_cool_);
 	int_thread(thrd_reconn_gtoaes_);
+	/*
+	 * 先停止相机分发新的帧, 再完成队列中的存储任务.
+	 * 存储线程经frame_written()访问camera_与gtoaes_, 故二者在存储线程结束后释放
+	 */
+	if (camera_.use_count()) camera_->DisConnect();
+	if (writer_.use_count()) writer_->Stop();
+	if (camera_.use_count()) log_latency();
 
 	/* 显式调用reset(), 以触发析构函数 */
-	gtoaes_.reset();
+	{
+		TcpCPtr gtoaes;
+		{
+			mutex_lock lck(mtx_gc_);
+			gtoaes.swap(gtoaes_);
+		}
+	}
 	ds9_.reset();
 	ntp_.reset();
 	filter_.reset();
 	camera_.reset();
+	writer_.reset();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -79,9 +98,14 @@ void cameracs::StopService() {
 bool cameracs::connect_server_gtoaes() {
 	const TCPClient::CBSlot &slot = boost::bind(&cameracs::receive_gtoaes, this, _1, _2);
 	bool rslt;
-	gtoaes_ = maketcp_client();
-	gtoaes_->RegisterRead(slot);
-	rslt = gtoaes_->Connect(param_->gcip, param_->gcport);
+	TcpCPtr gtoaes = maketcp_client();
+	gtoaes->UseBuffer(true, param_->gcbinary ? GC_BUFF_SIZE : TCP_BUFF_SIZE);
+	gtoaes->RegisterRead(slot);
+	{
+		mutex_lock lck(mtx_gc_);
+		gtoaes_ = gtoaes;
+	}
+	rslt = gtoaes->Connect(param_->gcip, param_->gcport);
 	if (!rslt) {
 		_gLog.Write(LOG_FAULT, NULL, "failed to connect general-control server");
 	}
@@ -117,7 +141,33 @@ bool cameracs::connect_camera() {
 		break;
 	case 4: // GY CCD
 	{
-		boost::shared_ptr<CameraGY> camera = boost::make_shared<CameraGY>(param_->camIP);
+		IOExecPtr exec;
+		if (param_->ioisolate) exec = boost::make_shared<IOExecutor>(1);
+		boost::shared_ptr<CameraGY> camera = boost::make_shared<CameraGY>(param_->camIP, exec);
+		camera->SetPacketSize(param_->packsize);
+		camera->SetRecvBuffer(param_->rcvbuf * 1048576);
+		camera->SetStreamPolicy(param_->streamcpu, param_->streamprio, param_->lockmem);
+		camera->SetPacing(param_->paceauto, param_->pacedelay, param_->pacemax, param_->pacestep, gPacingPath);
+		camera_ = to_cambase(camera);
+	}
+		break;
+	case 5: // 模拟相机
+	{
+		CameraSim::SimParameter sim;
+		sim.sensorW   = param_->simW;
+		sim.sensorH   = param_->simH;
+		sim.bitpixel  = param_->simBitpix;
+		sim.readrate  = param_->simRate;
+		sim.bias      = param_->simBias;
+		sim.readnoise = param_->simNoise;
+		sim.gain      = param_->simGain;
+		sim.sky       = param_->simSky;
+		sim.stars     = param_->simStars;
+		sim.hotpixels = param_->simHots;
+		sim.cosmic    = param_->simCosmic;
+		sim.failure   = param_->simFailure;
+		sim.fatal     = param_->simFatal;
+		boost::shared_ptr<CameraSim> camera = boost::make_shared<CameraSim>(sim);
 		camera_ = to_cambase(camera);
 	}
 		break;
@@ -125,6 +175,22 @@ bool cameracs::connect_camera() {
 		_gLog.Write(LOG_FAULT, NULL, "undefined camera type");
 		return false;
 	}
+	/* 图像文件由存储线程池写入, 不占用曝光与读出流程 */
+	writer_ = boost::make_shared<FitsWriterPool>();
+	writer_->RegisterWriteProc(boost::bind(&cameracs::frame_written, this, _1, _2, _3));
+	writer_->SetKey("TELESCOP", param_->telescope);
+	writer_->SetKey("GROUP_ID", param_->gid);
+	writer_->SetKey("UNIT_ID",  param_->uid);
+	writer_->SetKey("CAM_ID",   param_->cid);
+	writer_->SetCompress(AstroUtil::FitsHandler::CompressMethod(param_->ziptype), param_->ziptile, param_->zipthreads);
+	if (!writer_->Start(param_->wrthreads, param_->wrdepth, param_->wrdirect)) {
+		_gLog.Write(LOG_FAULT, NULL, "failed to start image writer");
+		return false;
+	}
+	camera_->SetFrameSlots(param_->frmslots);
+	camera_->SetSoftBinning(boost::iequals(param_->softbin, "MEAN") ? SOFTBIN_MEAN : SOFTBIN_SUM);
+	camera_->RegisterFrameProc(boost::bind(&cameracs::process_frame, this, _1));
+	tmlatency_ = boost::chrono::steady_clock::now();
 	if (!camera_->Connect()) {
 		_gLog.Write(LOG_FAULT, NULL, "failed to connect camera");
 		return false;
@@ -188,6 +254,39 @@ void cameracs::receive_alone_cooler(const long, const long) {
 
 }
 
+void cameracs::process_frame(const CameraBase::ImgFrmPtr &frame) {
+	// 队列满时在此等待, 帧不被释放, 序列曝光随之等待空闲帧
+	if (!writer_->Submit(frame, image_filepath(frame))) {
+		_gLog.Write(LOG_WARN, NULL, "image writer was stopped, frame#%u discarded", frame->id);
+	}
+}
+
+void cameracs::frame_written(const CameraBase::ImgFrmPtr &frame, const string &filepath, const string &errmsg) {
+	if (errmsg.size()) {
+		_gLog.Write(LOG_FAULT, NULL, "failed to write frame#%u: %s", frame->id, errmsg.c_str());
+	}
+	CameraBase::FrameTransfer &xfer = frame->transfer;
+	if (xfer.lost || xfer.sockdrop || xfer.nicdrop) {// 区分丢包来源: 网卡、内核或传输线路
+		_gLog.Write(LOG_WARN, NULL, "frame#%u: %u bytes, %u of %u packets lost, %u recovered by %u resend requests."
+				" drops: socket = %u, UDP rcvbuf = %u, NIC = %u. GevSCPD = %u",
+				frame->id, xfer.bytes, xfer.lost, xfer.packets, xfer.recovered, xfer.requests,
+				xfer.sockdrop, xfer.udpdrop, xfer.nicdrop, xfer.delay);
+	}
+	// 状态进入发送队列时记录时标. 与总控服务器断开连接时不记录
+	if (push_state(frame, errmsg.empty() ? filepath : string())) frame->timeline.Mark(LAT_PUSHED);
+	latency_.Record(frame->timeline, frame->exptm);
+	/* 每分钟记录一次时延统计 */
+	bool due(false);
+	{
+		mutex_lock lck(mtx_latency_);
+		if (boost::chrono::steady_clock::now() - tmlatency_ >= boost::chrono::minutes(1)) {
+			tmlatency_ = boost::chrono::steady_clock::now();
+			due = true;
+		}
+	}
+	if (due) log_latency();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /* 消息机制 */
 void cameracs::register_message() {
@@ -201,30 +300,246 @@ void cameracs::register_message() {
 }
 
 void cameracs::on_receive_gc(const long, const long) {
-	char term[] = "\n";	   // 换行符作为信息结束标记
-	int len = strlen(term);// 结束符长度
-	int pos;      // 标志符位置
-	int toread;   // 信息长度
+	TcpCPtr gtoaes = gc_client();
+	if (gtoaes.use_count()) gtoaes->Parse(boost::bind(&cameracs::parse_gc, this, _1, _2));
+}
 
-	while ((pos = gtoaes_->Lookup(term, len)) >= 0) {
-		// 读取协议内容并解析执行
-		gtoaes_->Read(bufrcv_.get(), toread);
-		bufrcv_[pos] = 0;
+int cameracs::parse_gc(const char* data, const int n) {
+	bool binary;
+	{
+		mutex_lock lck(mtx_gc_);
+		binary = gcbinary_;
+	}
+	return binary ? parse_gc_frame(data, n) : parse_gc_ascii(data, n);
+}
 
-//		proto = ascproto_->Resolve(bufrcv_.get());
-//		// 检查: 协议有效性及设备标志基本有效性
-//		if (!proto.use_count()
-//				|| (!proto->uid.empty() && proto->gid.empty())
-//				|| (!proto->cid.empty() && (proto->gid.empty() || proto->uid.empty()))) {
-//			_gLog.Write(LOG_FAULT, "cameracs::on_receive_gc",
-//					"illegal protocol. received: %s", bufrcv_.get());
-//			gtoaes_->Close();
-//		}
+int cameracs::parse_gc_ascii(const char* data, const int n) {
+	// 换行符作为信息结束标记
+	const char* eol = (const char*) memchr(data, '\n', n);
+	if (!eol) {// 信息不完整. 超出接收缓冲区容量时丢弃
+		if (n <= (param_->gcbinary ? GC_BUFF_SIZE : TCP_BUFF_SIZE) - TCP_PACK_SIZE) return 0;
+		_gLog.Write(LOG_FAULT, "cameracs::parse_gc_ascii", "message exceeds %d bytes, discarded", n);
+		return n;
+	}
+
+	int len = int(eol - data) + 1;
+	if (param_->gcbinary && len == int(sizeof(GC_HELLO) - 1) && !memcmp(data, GC_HELLO, len)) {
+		// 服务器接受二进制模式: 后续信息采用二进制帧
+		mutex_lock lck(mtx_gc_);
+		gcbinary_ = true;
+		_gLog.Write("general-control server accepted binary framing");
+	}
+	else process_gc(GC_FRAME_TEXT, data, len - 1);
+	return len;
+}
+
+int cameracs::parse_gc_frame(const char* data, const int n) {
+	GCFrameHeader header;
+
+	if (n < GC_HEADER_SIZE) return 0;
+	if (!header.Decode(data)) {// 无法恢复帧同步: 断开连接, 由重连流程恢复
+		_gLog.Write(LOG_FAULT, "cameracs::parse_gc_frame", "illegal frame header: magic = %04X, length = %u",
+				header.magic, header.length);
+		TcpCPtr gtoaes = gc_client();
+		if (gtoaes.use_count()) gtoaes->Close();
+		return n;
+	}
+	if (n < GC_HEADER_SIZE + int(header.length)) return 0;
+	if (header.seq != gcseqrcv_) {
+		_gLog.Write(LOG_WARN, "cameracs::parse_gc_frame", "frame sequence jumped from %u to %u",
+				gcseqrcv_, header.seq);
+	}
+	gcseqrcv_ = header.seq + 1;
+	process_gc(header.type, data + GC_HEADER_SIZE, header.length);
+	return GC_HEADER_SIZE + header.length;
+}
+
+void cameracs::process_gc(int type, const char* data, const int n) {
+	switch (type) {
+	case GC_FRAME_TEXT:
+		process_protocol(data, n);
+		break;
+	case GC_FRAME_PLAN:
+	case GC_FRAME_TARGET:
+	case GC_FRAME_ROI:// 观测计划、目标列表与感兴趣区集合: 尚未支持, 丢弃
+		_gLog.Write(LOG_WARN, "cameracs::process_gc", "unsupported frame type<%d> with %d bytes", type, n);
+		break;
+	default:
+		_gLog.Write(LOG_WARN, "cameracs::process_gc", "unknown frame type<%d> with %d bytes", type, n);
+		break;
+	}
+}
+
+void cameracs::process_protocol(const char* data, const int n) {
+	boost::chrono::steady_clock::time_point tm0 = boost::chrono::steady_clock::now();
+	AsciiCommand cmd;
+	int rslt(-1);	// -1: 无效; 0: 指向其它设备; 1: 已执行; 2: 未定义类型
+
+	// 就地解析协议内容: [data, data + n)
+	if (ascproto_.Resolve(data, n, cmd) && (rslt = check_id(cmd)) > 0) {
+		rslt = dispatch_protocol(cmd, tm0) ? 1 : 2;
+	}
+
+	double us = boost::chrono::duration<double, boost::micro>(boost::chrono::steady_clock::now() - tm0).count();
+	{
+		mutex_lock lck(mtx_latency_);
+		++cmdstat_.count;
+		if      (rslt < 0)  ++cmdstat_.illegal;
+		else if (rslt == 0) ++cmdstat_.ignored;
+		else if (rslt == 2) ++cmdstat_.unknown;
+		cmdstat_.total += us;
+		if (us > cmdstat_.max) cmdstat_.max = us;
+	}
+
+	if (rslt < 0) {
+		_gLog.Write(LOG_FAULT, "cameracs::process_protocol",
+				"illegal protocol. received: %s", string(data, n).c_str());
+		TcpCPtr gtoaes = gc_client();
+		if (gtoaes.use_count()) gtoaes->Close();
+	}
+	else if (rslt == 2) {
+		_gLog.Write(LOG_WARN, "cameracs::process_protocol", "undefined protocol type<%s>",
+				cmd.type.to_string().c_str());
 	}
 }
 
+int cameracs::check_id(const AsciiCommand& cmd) {
+	if ((!cmd.uid.empty() && cmd.gid.empty())
+			|| (!cmd.cid.empty() && (cmd.gid.empty() || cmd.uid.empty())))
+		return -1;
+	if ((!cmd.gid.empty() && cmd.gid != param_->gid)
+			|| (!cmd.uid.empty() && cmd.uid != param_->uid)
+			|| (!cmd.cid.empty() && cmd.cid != param_->cid))
+		return 0;
+	return 1;
+}
+
+/*
+ * @note case标签为编译期散列值: 散列值重复时编译失败
+ */
+bool cameracs::dispatch_protocol(const AsciiCommand& cmd, const FrameTimeline::steady_time& tmrcv) {
+	switch (cmd.hash) {
+	case ap_hash("take_image"):
+		if (cmd.type != "take_image") break;
+		process_take_image(cmd, tmrcv);
+		return true;
+	case ap_hash("abort_image"):
+		if (cmd.type != "abort_image") break;
+		process_abort_image(cmd);
+		return true;
+	case ap_hash("cooler"):
+		if (cmd.type != "cooler") break;
+		process_cooler(cmd);
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+void cameracs::process_take_image(const AsciiCommand& cmd, const FrameTimeline::steady_time& tmrcv) {
+	strref imgtype = cmd.Get("imgtype");
+	double expdur(0.0), delay(0.0);
+	int frmcnt(1);
+	bool light(true);
+
+	cmd.Get("expdur", expdur);
+	cmd.Get("frmcnt", frmcnt);
+	cmd.Get("delay",  delay);
+	if (imgtype == "bias") {
+		expdur = 0.0;
+		light  = false;
+	}
+	else if (imgtype == "dark") light = false;
+
+	if (frmcnt == 0 || frmcnt < -1) {// -1: 持续曝光直至中止
+		_gLog.Write(LOG_WARN, "cameracs::process_take_image", "illegal frame count<%d>", frmcnt);
+	}
+	else if (!camera_.use_count() || !camera_->IsConnected()) {
+		_gLog.Write(LOG_WARN, "cameracs::process_take_image", "camera is not connected");
+	}
+	else if (expdur < 0.0 || !(frmcnt == 1 ? camera_->Expose(expdur, light, tmrcv)
+			: camera_->ExposeSequence(frmcnt, expdur, delay, light, tmrcv))) {
+		_gLog.Write(LOG_WARN, "cameracs::process_take_image", "failed to start exposure: expdur = %.3f, frmcnt = %d",
+				expdur, frmcnt);
+	}
+}
+
+void cameracs::process_abort_image(const AsciiCommand& cmd) {
+	if (camera_.use_count()) camera_->AbortExpose();
+}
+
+void cameracs::process_cooler(const AsciiCommand& cmd) {
+	double coolset(param_->coolset);
+	int onoff(1);
+
+	cmd.Get("onoff",   onoff);
+	cmd.Get("coolset", coolset);
+	if (camera_.use_count() && !camera_->UpdateCooler(onoff != 0, coolset)) {
+		_gLog.Write(LOG_WARN, "cameracs::process_cooler", "failed to update cooler");
+	}
+}
+
+TcpCPtr cameracs::gc_client() {
+	mutex_lock lck(mtx_gc_);
+	return gtoaes_;
+}
+
+bool cameracs::write_gc(const TcpCPtr &gtoaes, int type, const char* data, const int n) {
+	TCPClient::charray buff;
+	int len;
+
+	mutex_lock lck(mtx_gc_);
+	if (gcbinary_) {
+		GCFrameHeader header;
+		header.type   = type;
+		header.seq    = gcseqsnd_;
+		header.length = n;
+		if (n > GC_FRAME_MAX) return false;
+		buff.reset(new char[len = GC_HEADER_SIZE + n]);
+		header.Encode(buff.get());
+		memcpy(buff.get() + GC_HEADER_SIZE, data, n);
+	}
+	else {
+		if (type != GC_FRAME_TEXT) return false;
+		buff.reset(new char[len = n + 1]);
+		memcpy(buff.get(), data, n);
+		buff[n] = '\n';
+	}
+	// 按序列号顺序进入发送队列
+	if (!gtoaes->Write(buff, len)) return false;
+	if (gcbinary_) ++gcseqsnd_;
+	return true;
+}
+
+/*
+ * @note 状态信息: camera_info gid=, uid=, cid=, state=, errcode=, coolget=[, frmno=, filename=]
+ */
+bool cameracs::push_state(const CameraBase::ImgFrmPtr &frame, const string &filepath) {
+	TcpCPtr gtoaes = gc_client();	// 重连线程可能替换gtoaes_
+	if (!gtoaes.use_count() || !gtoaes->IsOpen() || !camera_.use_count()) return false;
+
+	CameraBase::NFCamPtr nfcam = camera_->GetCameraInfo();
+	boost::format fmt("camera_info gid=%s, uid=%s, cid=%s, state=%d, errcode=%d, coolget=%.1f");
+	fmt % param_->gid % param_->uid % param_->cid % int(nfcam->state) % nfcam->errcode % nfcam->coolGet;
+	string text = fmt.str();
+	if (frame.use_count()) {
+		boost::format fmtfrm(", frmno=%u, filename=%s");
+		fmtfrm % frame->id % path(filepath).filename().string();
+		text += fmtfrm.str();
+	}
+	return write_gc(gtoaes, GC_FRAME_TEXT, text.data(), int(text.size()));
+}
+
 void cameracs::on_close_gc(const long, const long ec) {
 	_gLog.Write(LOG_WARN, NULL, "connection with general-control server was broken. re-connect automatically later");
+	TcpCPtr gtoaes = gc_client();
+	if (gtoaes.use_count()) {
+		TCPWriteStat stat = gtoaes->GetWriteStat();
+		_gLog.Write("general-control write queue: %llu messages in %llu writes, max depth = %d messages / %d bytes,"
+				" rejected = %llu, dropped = %llu, timeouts = %llu",
+				stat.messages, stat.writes, stat.maxqueued, stat.maxbytes, stat.rejected, stat.dropped, stat.timeouts);
+	}
 	int_thread(thrd_state_);
 	thrd_reconn_gtoaes_.reset(new boost::thread(boost::bind(&cameracs::thread_reconn_gtoaes, this)));
 }
@@ -232,7 +547,14 @@ void cameracs::on_close_gc(const long, const long ec) {
 void cameracs::on_connect_gc(const long, const long) {
 	_gLog.Write("SUCCESS: connected to general-control server");
 	int_thread(thrd_reconn_gtoaes_);
-	gtoaes_->UseBuffer();
+	{// 新连接以ASCII模式开始, 按配置请求二进制模式
+		mutex_lock lck(mtx_gc_);
+		gcbinary_ = false;
+		gcseqsnd_ = 0;
+		gcseqrcv_ = 0;
+	}
+	TcpCPtr gtoaes = gc_client();
+	if (param_->gcbinary && gtoaes.use_count()) gtoaes->Write(GC_HELLO, sizeof(GC_HELLO) - 1);
 	//... 在服务器上注册相机
 	thrd_state_.reset(new boost::thread(boost::bind(&cameracs::thread_state, this)));
 }
@@ -250,7 +572,7 @@ void cameracs::thread_state() {
 		 * - 状态变化时, 立即发送
 		 */
 		cv_camstate_changed_.wait_for(lck, period);
-		//... 发送工作状态
+		push_state();
 	}
 }
 
@@ -275,10 +597,17 @@ void cameracs::thread_reconn_gtoaes() {
 
 		const TCPClient::CBSlot &slot1 = boost::bind(&cameracs::connect_gtoaes, this, _1, _2);
 		const TCPClient::CBSlot &slot2 = boost::bind(&cameracs::receive_gtoaes, this, _1, _2);
-		gtoaes_ = maketcp_client();
-		gtoaes_->RegisterConnect(slot1);
-		gtoaes_->RegisterRead(slot2);
-		gtoaes_->AsyncConnect(param_->gcip, param_->gcport);
+		TcpCPtr gtoaes = maketcp_client(), old;
+		gtoaes->UseBuffer(true, param_->gcbinary ? GC_BUFF_SIZE : TCP_BUFF_SIZE);
+		gtoaes->RegisterConnect(slot1);
+		gtoaes->RegisterRead(slot2);
+		{
+			mutex_lock lck(mtx_gc_);
+			old = gtoaes_;
+			gtoaes_ = gtoaes;
+		}
+		old.reset();	// 在锁外释放原连接
+		gtoaes->AsyncConnect(param_->gcip, param_->gcport);
 	}
 }
 
@@ -317,3 +646,31 @@ void cameracs::free_local_storage() {
 		_gLog.Write("free storage capacity is currently %d GB", nfspace.available >> 30);
 	}
 }
+
+void cameracs::log_latency() {
+	CommandStat cmdstat;
+	{
+		mutex_lock lck(mtx_latency_);
+		cmdstat = cmdstat_;
+	}
+	string text = latency_.Summary();
+	if (text.size()) _gLog.Write("Acquisition Latency:\n%s", text.c_str());
+	if (writer_.use_count()) _gLog.Write("Image Writer:\n%s", writer_->Summary().c_str());
+	if (cmdstat.count) {
+		_gLog.Write("Control Protocol: %llu commands, illegal = %llu, ignored = %llu, undefined = %llu;"
+				" parse and dispatch: mean = %.2f us, max = %.2f us",
+				cmdstat.count, cmdstat.illegal, cmdstat.ignored, cmdstat.unknown,
+				cmdstat.total / cmdstat.count, cmdstat.max);
+	}
+	if (camera_.use_count() && (text = camera_->TransportSummary()).size())
+		_gLog.Write("Image Transport:\n%s", text.c_str());
+}
+
+string cameracs::image_filepath(const CameraBase::ImgFrmPtr &frame) {
+	boost::format fmt(writer_->IsCompressed() ? "%s_%s_%s_%s.fit.fz" : "%s_%s_%s_%s.fit");
+	path filepath(param_->pathroot);
+	filepath /= to_iso_string(frame->tmobs.date());
+	fmt % param_->gid % param_->uid % param_->cid % to_iso_string(frame->tmobs);
+	filepath /= fmt.str();
+	return filepath.string();
+}
@@ -18,6 +18,10 @@
 #include "tcpasio.h"
 #include "udpasio.h"
 #include "FlatField_Sky.h"
+#include "LatencyStat.h"
+#include "FitsWriterPool.h"
+#include "GCFrame.h"
+#include "AsciiProtocol.h"
 
 typedef boost::shared_ptr<ConfigParameter> ParamPtr;
 typedef boost::shared_ptr<CDs9> CDs9Ptr;
@@ -39,16 +43,40 @@ protected:
 	/*---- 成员变量 ----*/
 	/* 操作对象访问接口 */
 	ParamPtr param_;	//< 配置参数
-	TcpCPtr gtoaes_;	//< 总控服务器访问指针
+	TcpCPtr gtoaes_;	//< 总控服务器访问指针. 由mtx_gc_保护, 重连线程可能替换
 	CameraBasePtr camera_;	//< 相机访问指针
 	FilterCtrlPtr filter_;	//< 滤光片访问指针
 	NTPCliPtr ntp_;			//< NTP时钟同步
 	CDs9Ptr ds9_;			//< ds9访问指针
 	FlatField_Sky flatsky_;	//< 天光平场控制参数
 	UdpPtr cool_alone_;		//< 单独的温控接口
+	FitsWriterPoolPtr writer_;	//< 异步存储图像文件
 	//...缺文件服务器, 网络信息解析/封装接口
 
-	boost::shared_array<char> bufrcv_;	//< 网络信息存储区: 消息队列中调用
+	/* 时延统计 */
+	LatencyStat latency_;	//< 单帧各阶段时延
+	boost::chrono::steady_clock::time_point tmlatency_;	//< 最近一次记录时延统计的时间
+	boost::mutex mtx_latency_;	//< 互斥锁: 记录时延统计
+
+	/* 与总控服务器通信 */
+	bool gcbinary_;			//< 已协商采用二进制帧
+	uint32_t gcseqsnd_;		//< 二进制帧发送序列号
+	uint32_t gcseqrcv_;		//< 期待接收的二进制帧序列号
+	boost::mutex mtx_gc_;	//< 互斥锁: 总控服务器访问指针、通信模式与发送序列号
+	AsciiProtocol ascproto_;	//< ASCII协议解析
+
+	/*!
+	 * @struct CommandStat 协议解析与分派统计
+	 */
+	struct CommandStat {
+		uint64_t count;		//< 已处理协议数量
+		uint64_t illegal;	//< 格式或设备标志无效的协议数量
+		uint64_t ignored;	//< 设备标志不指向本相机的协议数量
+		uint64_t unknown;	//< 未定义类型的协议数量
+		double total;		//< 累计解析与分派时间, 量纲: 微秒
+		double max;			//< 最长解析与分派时间, 量纲: 微秒
+	};
+	CommandStat cmdstat_;	//< 协议统计. 由mtx_latency_保护
 
 	/* 线程 */
 	threadptr thrd_state_;	//< 向总控服务器发送相机工作状态
@@ -121,6 +149,22 @@ protected:
 	 * @brief 回调函数: 处理来自独立温控的反馈信息
 	 */
 	void receive_alone_cooler(const long, const long);
+	/*!
+	 * @brief 回调函数: 处理已完成读出的帧
+	 * @param frame 帧
+	 * @note
+	 * 在相机的帧分发线程中调用
+	 */
+	void process_frame(const CameraBase::ImgFrmPtr &frame);
+	/*!
+	 * @brief 回调函数: 处理图像文件存储结果
+	 * @param frame     帧
+	 * @param filepath  文件路径
+	 * @param errmsg    错误提示. 空字符串表示存储成功
+	 * @note
+	 * 在存储线程中调用
+	 */
+	void frame_written(const CameraBase::ImgFrmPtr &frame, const string &filepath, const string &errmsg);
 
 /////////////////////////////////////////////////////////////////////////////
 protected:
@@ -133,6 +177,94 @@ protected:
 	 * @brief 处理来自总控服务器的信息
 	 */
 	void on_receive_gc(const long addr = 0, const long ec = 0);
+	/*!
+	 * @brief 在接收缓冲区中就地解析一条来自总控服务器的信息
+	 * @param data 已接收信息首地址
+	 * @param n    已接收信息长度
+	 * @return
+	 * 已解析信息长度, 含结束符或帧头. 0: 信息不完整
+	 * @note
+	 * 按协商结果解析换行符结束的ASCII信息或二进制帧
+	 */
+	int parse_gc(const char* data, const int n);
+	/*!
+	 * @brief 解析ASCII信息. 识别二进制模式协商应答
+	 */
+	int parse_gc_ascii(const char* data, const int n);
+	/*!
+	 * @brief 解析二进制帧. 帧头无效时断开连接
+	 */
+	int parse_gc_frame(const char* data, const int n);
+	/*!
+	 * @brief 处理一条完整信息
+	 * @param type 帧类型, GC_FRAME_TYPE. ASCII模式为GC_FRAME_TEXT
+	 * @param data 负载首地址, 位于接收缓冲区中
+	 * @param n    负载长度
+	 */
+	void process_gc(int type, const char* data, const int n);
+	/*!
+	 * @brief 解析并执行一条ASCII协议, 统计耗时
+	 */
+	void process_protocol(const char* data, const int n);
+	/*!
+	 * @brief 检查协议中的设备标志
+	 * @return
+	 * 1: 指向本相机; 0: 指向其它设备; -1: 无效组合
+	 * @note
+	 * 空标志匹配所有设备. 指定uid时须指定gid; 指定cid时须指定gid与uid
+	 */
+	int check_id(const AsciiCommand& cmd);
+	/*!
+	 * @brief 按协议类型分派
+	 * @param cmd   协议
+	 * @param tmrcv 开始处理协议的时间, 作为曝光指令的接收时间
+	 * @return
+	 * 协议类型是否已定义
+	 */
+	bool dispatch_protocol(const AsciiCommand& cmd, const FrameTimeline::steady_time& tmrcv);
+	/*!
+	 * @brief 协议take_image: 启动曝光
+	 * @note
+	 * 关键字: imgtype(bias, dark, flat, object), expdur(秒), frmcnt(帧数), delay(帧间隔, 秒)
+	 * - frmcnt缺省为1. frmcnt = -1: 持续曝光直至abort_image
+	 * - frmcnt为0或小于-1时拒绝执行, 避免无效字段启动无休止的序列曝光
+	 */
+	void process_take_image(const AsciiCommand& cmd, const FrameTimeline::steady_time& tmrcv);
+	/*!
+	 * @brief 协议abort_image: 中止曝光
+	 */
+	void process_abort_image(const AsciiCommand& cmd);
+	/*!
+	 * @brief 协议cooler: 设置制冷
+	 * @note
+	 * 关键字: onoff(0或1), coolset(制冷温度)
+	 */
+	void process_cooler(const AsciiCommand& cmd);
+	/*!
+	 * @brief 查看总控服务器访问指针
+	 * @return
+	 * gtoaes_的副本. 调用者通过副本访问连接, 不受重连线程替换gtoaes_的影响
+	 */
+	TcpCPtr gc_client();
+	/*!
+	 * @brief 向总控服务器发送一条信息
+	 * @param gtoaes 总控服务器连接, 由gc_client()取得
+	 * @param type   帧类型. ASCII模式仅支持GC_FRAME_TEXT
+	 * @param data   信息内容, 不含换行符
+	 * @param n      信息长度
+	 * @return
+	 * 信息是否进入发送队列
+	 */
+	bool write_gc(const TcpCPtr &gtoaes, int type, const char* data, const int n);
+	/*!
+	 * @brief 向总控服务器发送相机工作状态
+	 * @param frame    已完成存储的帧. 空指针时仅发送相机状态
+	 * @param filepath 图像文件路径. 存储失败时为空
+	 * @return
+	 * 状态信息是否进入发送队列
+	 */
+	bool push_state(const CameraBase::ImgFrmPtr &frame = CameraBase::ImgFrmPtr(),
+			const string &filepath = string());
 	/*!
 	 * @brief 总控服务器断开连接
 	 */
@@ -153,6 +285,7 @@ protected:
 	 * 发送时间:
 	 * - 当相机工作状态发生变化时
 	 * - 周期: 10秒
+	 * 完成存储的帧由frame_written()直接发送
 	 */
 	void thread_state();
 	/*!
@@ -176,5 +309,18 @@ protected:
 	 * @brief 清理本地磁盘空间
 	 */
 	void free_local_storage();
+	/*!
+	 * @brief 在日志中记录时延统计结果
+	 * @note
+	 * 内部获取mtx_latency_, 调用者不可持有该锁
+	 */
+	void log_latency();
+	/*!
+	 * @brief 生成图像文件路径
+	 * @param frame 帧
+	 * @return
+	 * 文件路径: <PathRoot>/<曝光起始日期>/<gid>_<uid>_<cid>_<曝光起始时间>.fit[.fz]
+	 */
+	string image_filepath(const CameraBase::ImgFrmPtr &frame);
 };
 #endif /* SRC_CAMERACS_H_ */
@@ -17,6 +17,9 @@ const char gLogPrefix[] = "camagent_";
 // 软件配置文件
 const char gConfigPath[] = "/usr/local/etc/camagent.xml";
 
+// 网络相机包间延时记录
+const char gPacingPath[] = "/usr/local/etc/camagent.pacing";
+
 // 文件锁位置
 const char gPIDPath[] = "/var/run/camagent.pid";
 
@@ -0,0 +1,89 @@
+/*!
+ Name        : gyemulator.cpp
+ Author      : Xiaomeng Lu
+ Version     : 0.1
+ Copyright   : SVOM Group, NAOC
+ Description : GWAC-GY相机GigE-Vision协议仿真程序, 用于无相机时测试camagent
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include "GYEmulator.h"
+
+void usage() {
+	printf("Usage: gyemulator [options]\n"
+			"  -a ip        camera IP replied to DISCOVERY, default 127.0.0.1\n"
+			"  -p port      GVCP port, default 3956\n"
+			"  -w width     image width, default 4096\n"
+			"  -h height    image height, default 4096\n"
+			"  -m mtu       link MTU for packets with DF flag, default 9000\n"
+			"  -d delay     minimum inter-packet delay in microseconds, default 0\n"
+			"  -l loss      packet loss probability, default 0\n"
+			"  -r reorder   packet reorder probability, default 0\n"
+			"  -u dup       packet duplication probability, default 0\n"
+			"  -b Mbps      bottleneck bandwidth, default 0 (unlimited)\n"
+			"  -q packets   bottleneck queue length, default 64\n"
+			"  -s seed      random seed, default 1\n"
+			"  -i seconds   period of printing statistics, default 10. 0: only on exit\n");
+}
+
+void print_summary(GYEmulator *emu, boost::asio::deadline_timer *timer, int period,
+		const boost::system::error_code &ec) {
+	if (ec) return;
+	printf("%s\n", emu->Summary().c_str());
+	timer->expires_from_now(boost::posix_time::seconds(period));
+	timer->async_wait(boost::bind(print_summary, emu, timer, period, boost::asio::placeholders::error));
+}
+
+int main(int argc, char **argv) {
+	GYEmuParameter param;
+	int ch, period(10);
+
+	while ((ch = getopt(argc, argv, "a:p:w:h:m:d:l:r:u:b:q:s:i:")) != -1) {
+		switch (ch) {
+		case 'a': param.ip        = optarg;              break;
+		case 'p': param.port      = atoi(optarg);        break;
+		case 'w': param.width     = atoi(optarg);        break;
+		case 'h': param.height    = atoi(optarg);        break;
+		case 'm': param.mtu       = atoi(optarg);        break;
+		case 'd': param.delay     = atoi(optarg);        break;
+		case 'l': param.loss      = atof(optarg);        break;
+		case 'r': param.reorder   = atof(optarg);        break;
+		case 'u': param.duplicate = atof(optarg);        break;
+		case 'b': param.bandwidth = atoi(optarg);        break;
+		case 'q': param.queue     = atoi(optarg);        break;
+		case 's': param.seed      = strtoul(optarg, NULL, 0); break;
+		case 'i': period          = atoi(optarg);        break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (param.width <= 0 || param.height <= 0) {
+		usage();
+		return 1;
+	}
+
+	GYEmulator emu(param);
+	if (!emu.Start()) return 2;
+	printf("GY emulator <%s:%u> running: %d x %d, loss = %.4f, reorder = %.4f, duplicate = %.4f\n",
+			param.ip.c_str(), param.port, param.width, param.height,
+			param.loss, param.reorder, param.duplicate);
+
+	boost::asio::io_service ios;
+	boost::asio::signal_set signals(ios, SIGINT, SIGTERM); // interrupt signal
+	boost::asio::deadline_timer timer(ios);
+	signals.async_wait(boost::bind(&boost::asio::io_service::stop, &ios));
+	if (period > 0) {
+		timer.expires_from_now(boost::posix_time::seconds(period));
+		timer.async_wait(boost::bind(print_summary, &emu, &timer, period, boost::asio::placeholders::error));
+	}
+	ios.run();
+
+	emu.Stop();
+	printf("%s", emu.Summary().c_str());
+	return 0;
+}
@@ -3,25 +3,109 @@
  */
 #include <boost/make_shared.hpp>
 #include <boost/lexical_cast.hpp>
+#include <string.h>
 #include "tcpasio.h"
 
 using std::string;
 using namespace boost::asio;
+//////////////////////////////////////////////////////////////////////////////
+/*---------------- ByteRing: 字节环 ----------------*/
+ByteRing::ByteRing() {
+	capacity_ = 0;
+	head_ = tail_ = 0;
+}
+
+void ByteRing::SetCapacity(int capacity) {
+	if (capacity != capacity_) {
+		capacity_ = capacity > 0 ? capacity : 0;
+		buff_.reset(capacity_ ? new char[capacity_] : NULL);
+	}
+	Clear();
+}
+
+void ByteRing::Clear() {
+	head_ = tail_ = 0;
+}
+
+int ByteRing::Capacity() const {
+	return capacity_;
+}
+
+int ByteRing::Size() const {
+	return tail_ - head_;
+}
+
+const char* ByteRing::Data() const {
+	return buff_.get() + head_;
+}
+
+char* ByteRing::Space() {
+	return buff_.get() + tail_;
+}
+
+int ByteRing::Room() const {
+	return capacity_ - tail_;
+}
+
+void ByteRing::Compact() {
+	if (head_) {
+		if (tail_ > head_) memmove(buff_.get(), buff_.get() + head_, tail_ - head_);
+		tail_ -= head_;
+		head_ = 0;
+	}
+}
+
+void ByteRing::Commit(int n) {
+	if (n > 0) tail_ += n < Room() ? n : Room();
+}
+
+void ByteRing::Consume(int n) {
+	if (n > 0) head_ += n < Size() ? n : Size();
+}
+
+int ByteRing::Append(const char* data, int n) {
+	if (n > Room()) n = Room();
+	if (n > 0) {
+		memcpy(buff_.get() + tail_, data, n);
+		tail_ += n;
+	}
+	return n > 0 ? n : 0;
+}
+
+int ByteRing::Find(const char* flag, int len, int from) const {
+	int n = Size() - from;
+	if (!flag || len <= 0 || from < 0 || n < len) return -1;
+
+	const char* data = Data() + from;
+	const char* pos = len == 1 ? (const char*) memchr(data, flag[0], n)
+			: (const char*) memmem(data, n, flag, len);
+	return pos ? int(pos - Data()) : -1;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 /*---------------- TCPClient: 客户端 ----------------*/
-TcpCPtr maketcp_client() {// 工厂函数, 创建TcpCPtr
-	return boost::make_shared<TCPClient>();
+TcpCPtr maketcp_client(const IOExecPtr& exec) {// 工厂函数, 创建TcpCPtr
+	return boost::make_shared<TCPClient>(exec);
 }
 
-TCPClient::TCPClient()
-	: sock_(keep_.GetService()) {
+TCPClient::TCPClient(const IOExecPtr& exec)
+	: keep_(exec)
+	, sock_(keep_.GetService()) {
 	bytercv_ = 0;
 	bufrcv_.reset(new char[TCP_PACK_SIZE]);
 	usebuf_ = false;
 	pause_rcv_ = false;
+	reading_ = false;
+	sndbusy_ = 0;
+	sndoff_  = 0;
+	sndlimit_  = TCP_BUFF_SIZE;
+	sndpolicy_ = TCP_WRITE_REJECT;
+	sndwait_   = 1000;
+	memset(&sndstat_, 0, sizeof(sndstat_));
 }
 
 TCPClient::~TCPClient() {
+	keep_.Shutdown();
 	Close();
 }
 
@@ -30,7 +114,7 @@ tcp::socket& TCPClient::GetSocket() {
 }
 
 /*
- * @note 同步方式连接服务器
+ * @note 同步方式连接服务器. 连接成功后启动接收流程
  */
 bool TCPClient::Connect(const string& host, const uint16_t port) {
 	tcp::resolver resolver(keep_.GetService());
@@ -38,7 +122,7 @@ bool TCPClient::Connect(const string& host, const uint16_t port) {
 	tcp::resolver::iterator itertor = resolver.resolve(query);
 	boost::system::error_code ec;
 	sock_.connect(*itertor, ec);
-	if (!ec) sock_.set_option(socket_base::keep_alive(true));
+	if (!ec) start();
 	return !ec;
 }
 
@@ -51,12 +135,14 @@ void TCPClient::AsyncConnect(const string& host, const uint16_t port) {
 	tcp::resolver::iterator itertor = resolver.resolve(query);
 
 	sock_.async_connect(*itertor,
-			boost::bind(&TCPClient::handle_connect, this, placeholders::error));
+			keep_.Wrap(boost::bind(&TCPClient::handle_connect, this, placeholders::error)));
 }
 
 int TCPClient::Close() {
 	boost::system::error_code ec;
 	if (sock_.is_open()) sock_.close(ec);
+	mutex_lock lck(mtxsnd_);
+	cvsnd_.notify_all();
 	return ec.value();
 }
 
@@ -67,18 +153,12 @@ bool TCPClient::IsOpen() {
 /*
  * @note UseBuffer()应在建立连接前仅调用一次
  */
-void TCPClient::UseBuffer(bool usebuf) {
-	if (usebuf_ != usebuf) {
-		usebuf_ = usebuf;
-		if (usebuf_) {
-			crcrcv_.set_capacity(TCP_PACK_SIZE * 100);
-			crcsnd_.set_capacity(TCP_PACK_SIZE * 100);
-		}
-		else {
-			crcrcv_.clear();
-			crcsnd_.clear();
-		}
-	}
+void TCPClient::UseBuffer(bool usebuf, int capacity) {
+	if (capacity < TCP_PACK_SIZE * 2) capacity = TCP_PACK_SIZE * 2;
+	usebuf_ = usebuf;
+	crcrcv_.SetCapacity(usebuf_ ? capacity : 0);
+	mutex_lock lck(mtxsnd_);
+	sndlimit_ = capacity;
 }
 
 /*
@@ -108,58 +188,67 @@ void TCPClient::RegisterWrite(const CBSlot& slot) {
 }
 
 int TCPClient::Lookup(char* first) {
-	int n = usebuf_ ? crcrcv_.size() : bytercv_;
+	mutex_lock lck(mtxrcv_);
+	int n = usebuf_ ? crcrcv_.Size() : bytercv_;
 	if (!(first && n)) return -1;
-	*first = usebuf_ ? crcrcv_[0] : bufrcv_[0];
+	*first = usebuf_ ? crcrcv_.Data()[0] : bufrcv_[0];
 	return n;
 }
 
 int TCPClient::Lookup(const char* flag, const int len, const int from) {
 	if (!flag || len <= 0 || from < 0) return -1;
 
-	int n = usebuf_ ? (crcrcv_.size() - len) : (bytercv_ - len);
-	int i(-1), j, pos;
-
-	if (usebuf_) {
-		mutex_lock lck(mtxrcv_);
-		for (pos = from; i != len && pos <= n; ++pos) {
-			for (i = 0, j = pos; i < len && flag[i] == crcrcv_[j]; ++i, ++j);
-		}
-	}
-	else {
-		for (pos = from; i != len && pos <= n; ++pos) {
-			for (i = 0, j = pos; i < len && flag[i] == bufrcv_[j]; ++i, ++j);
-		}
-	}
-	return i != len ? -1 : (pos - 1);
+	mutex_lock lck(mtxrcv_);
+	if (usebuf_) return crcrcv_.Find(flag, len, from);
+
+	int n = bytercv_ - from;
+	if (n < len) return -1;
+	const char* data = bufrcv_.get() + from;
+	const char* pos = len == 1 ? (const char*) memchr(data, flag[0], n)
+			: (const char*) memmem(data, n, flag, len);
+	return pos ? int(pos - bufrcv_.get()) : -1;
 }
 
+/*
+ * @note 清除缓冲区中截至被读出数据末尾的全部数据
+ */
 int TCPClient::Read(char* buff, const int len, const int from) {
 	if (!buff || len <= 0 || from < 0) return 0;
 
 	mutex_lock lck(mtxrcv_);
-	int n0(from + len), i(0), j;
+	const char* data = usebuf_ ? crcrcv_.Data() : bufrcv_.get();
+	int size = usebuf_ ? crcrcv_.Size() : bytercv_;
+	int n = size - from < len ? size - from : len;
+
+	if (n <= 0) return 0;
+	memcpy(buff, data + from, n);
 	if (usebuf_) {
-		int n(crcrcv_.size());
-		if (n > n0) n = n0;
-		for (j = from; j < n; ++i, ++j) buff[i] = crcrcv_[j];
-		if (i) {
-			crcrcv_.erase_begin(i);
-			if (pause_rcv_) {
-				pause_rcv_ = (crcrcv_.capacity() - crcrcv_.size()) < TCP_PACK_SIZE;
-				if (!pause_rcv_) start_read();
-			}
-		}
+		crcrcv_.Consume(from + n);
+		if (pause_rcv_) start_read();
 	}
 	else {
-		int n = bytercv_ < n0 ? (bytercv_ - from) : len;
-		if (n > 0) {
-			memcpy(buff, bufrcv_.get() + from, n);
-			bytercv_ -= n;
+		if ((bytercv_ -= from + n) > 0) memmove(bufrcv_.get(), data + from + n, bytercv_);
+	}
+	return n;
+}
+
+int TCPClient::Parse(const ParseFunc& proc) {
+	mutex_lock lck(mtxrcv_);
+	const char* data = usebuf_ ? crcrcv_.Data() : bufrcv_.get();
+	int size = usebuf_ ? crcrcv_.Size() : bytercv_;
+	int total(0), n;
+
+	while (total < size && (n = proc(data + total, size - total)) > 0) {
+		total += n < size - total ? n : size - total;
+	}
+	if (total) {
+		if (usebuf_) {
+			crcrcv_.Consume(total);
+			if (pause_rcv_) start_read();
 		}
-		i = n > 0 ? n : 0;
+		else if ((bytercv_ -= total) > 0) memmove(bufrcv_.get(), data + total, bytercv_);
 	}
-	return i;
+	return total;
 }
 
 int TCPClient::Write(const char* buff, const int len) {
@@ -168,10 +257,9 @@ int TCPClient::Write(const char* buff, const int len) {
 	mutex_lock lck(mtxsnd_);
 	int n;
 	if (usebuf_) {
-		int n0(crcsnd_.size()), i;
-		if ((n = crcsnd_.capacity() - n0) > len) n = len;
-		for (i = 0; i < n; ++i) crcsnd_.push_back(buff[i]);
-		if (!n0 && n) start_write();
+		charray copy(new char[len]);
+		memcpy(copy.get(), buff, len);
+		n = enqueue(lck, copy, len) ? len : 0;
 	}
 	else {
 		n = sock_.write_some(buffer(buff, len));
@@ -179,69 +267,180 @@ int TCPClient::Write(const char* buff, const int len) {
 	return n;
 }
 
+bool TCPClient::Write(const charray& buff, const int len) {
+	if (!(usebuf_ && buff && len > 0)) return false;
+	mutex_lock lck(mtxsnd_);
+	return enqueue(lck, buff, len);
+}
+
+void TCPClient::SetWritePolicy(int limit, int policy, int timeout) {
+	mutex_lock lck(mtxsnd_);
+	sndlimit_  = limit > 0 ? limit : TCP_BUFF_SIZE;
+	sndpolicy_ = policy;
+	sndwait_   = timeout > 0 ? timeout : 0;
+	cvsnd_.notify_all();
+}
+
+TCPWriteStat TCPClient::GetWriteStat() {
+	mutex_lock lck(mtxsnd_);
+	return sndstat_;
+}
+
+bool TCPClient::enqueue(mutex_lock& lck, const charray& buff, const int len) {
+	TCPWriteStat& stat = sndstat_;
+
+	if (len > sndlimit_ || !sock_.is_open()) {
+		++stat.rejected;
+		return false;
+	}
+	if (stat.bytes + len > sndlimit_) {
+		if (sndpolicy_ == TCP_WRITE_DROP_OLDEST) {// 正在发送或已部分发送的信息不可丢弃
+			int keep = sndbusy_ ? sndbusy_ : (sndoff_ ? 1 : 0);
+			while (stat.bytes + len > sndlimit_ && int(sndque_.size()) > keep) {
+				std::deque<message>::iterator it = sndque_.begin() + keep;
+				stat.bytes -= it->second;
+				sndque_.erase(it);
+				++stat.dropped;
+			}
+		}
+		else if (sndpolicy_ == TCP_WRITE_WAIT) {
+			boost::chrono::steady_clock::time_point tmend = boost::chrono::steady_clock::now()
+					+ boost::chrono::milliseconds(sndwait_);
+			while (stat.bytes + len > sndlimit_ && sock_.is_open()) {
+				if (cvsnd_.wait_until(lck, tmend) == boost::cv_status::timeout) {
+					if (stat.bytes + len > sndlimit_) ++stat.timeouts;
+					break;
+				}
+			}
+		}
+		if (stat.bytes + len > sndlimit_ || !sock_.is_open()) {
+			++stat.rejected;
+			return false;
+		}
+	}
+
+	sndque_.push_back(message(buff, len));
+	stat.queued = sndque_.size();
+	stat.bytes += len;
+	if (stat.queued > stat.maxqueued) stat.maxqueued = stat.queued;
+	if (stat.bytes > stat.maxbytes)   stat.maxbytes  = stat.bytes;
+	start_write();
+	return true;
+}
+
 void TCPClient::handle_connect(const boost::system::error_code& ec) {
 	if (!cbconn_.empty()) cbconn_((const long) this, ec.value());
-	if (!ec) {
-		sock_.set_option(socket_base::keep_alive(true));
-		start_read();
-	}
+	if (!ec) start();
 }
 
 void TCPClient::handle_read(const boost::system::error_code& ec, int n) {
-	if (!ec){
+	{
 		mutex_lock lock(mtxrcv_);
-		if (usebuf_) {
-			for(int i = 0; i < n; ++i) crcrcv_.push_back(bufrcv_[i]);
-			pause_rcv_ = (crcrcv_.capacity() - crcrcv_.size()) < TCP_PACK_SIZE;
+		reading_ = false;
+		if (!ec) {
+			if (usebuf_) crcrcv_.Commit(n);
+			else bytercv_ = n;
 		}
-		else bytercv_ = n;
 	}
 	if (!cbrcv_.empty()) cbrcv_((const long) this, ec.value());
-	if (!(ec || pause_rcv_)) start_read();
+	if (!ec) {
+		mutex_lock lock(mtxrcv_);
+		start_read();
+	}
 }
 
 void TCPClient::handle_write(const boost::system::error_code& ec, int n) {
-	if (!ec) {
-		mutex_lock lock(mtxsnd_);
-		crcsnd_.erase_begin(n);
-		if (!cbsnd_.empty()) cbsnd_((const long) this, n);
-		start_write();
+	mutex_lock lock(mtxsnd_);
+	TCPWriteStat& stat = sndstat_;
+
+	sndbusy_ = 0;
+	if (ec) {// 连接异常: 丢弃未发送信息
+		stat.dropped += sndque_.size();
+		sndque_.clear();
+		sndoff_ = 0;
+		stat.queued = stat.bytes = 0;
+		cvsnd_.notify_all();
+		return;
 	}
+	stat.sent  += n;
+	stat.bytes -= n;
+	for (int left = n; left > 0 && sndque_.size(); ) {
+		int remain = sndque_.front().second - sndoff_;
+		if (left < remain) {
+			sndoff_ += left;
+			break;
+		}
+		left -= remain;
+		sndoff_ = 0;
+		sndque_.pop_front();
+		++stat.messages;
+	}
+	stat.queued = sndque_.size();
+	cvsnd_.notify_all();
+	if (!cbsnd_.empty()) cbsnd_((const long) this, n);
+	start_write();
 }
 
+/*
+ * @note 缓冲模式下直接接收至字节环尾部空间. 空间不足时先整理, 仍不足时暂停接收,
+ * 待Read()或Parse()清除数据后恢复
+ */
 void TCPClient::start_read() {
-	if (sock_.is_open()) {
-		sock_.async_read_some(buffer(bufrcv_.get(), TCP_PACK_SIZE),
-				boost::bind(&TCPClient::handle_read, this,
-						placeholders::error, placeholders::bytes_transferred));
+	if (reading_ || !sock_.is_open()) return;
+
+	char* buff = bufrcv_.get();
+	int n(TCP_PACK_SIZE);
+	if (usebuf_) {
+		if (crcrcv_.Room() < TCP_PACK_SIZE) crcrcv_.Compact();
+		if ((pause_rcv_ = crcrcv_.Room() < TCP_PACK_SIZE)) return;
+		buff = crcrcv_.Space();
+		n    = crcrcv_.Room();
 	}
+	reading_ = true;
+	sock_.async_read_some(buffer(buff, n),
+			keep_.Wrap(boost::bind(&TCPClient::handle_read, this,
+					placeholders::error, placeholders::bytes_transferred)));
 }
 
+/*
+ * @note 同一时刻仅有一个异步发送. 发送期间新信息追加至队尾, 不影响正在发送的存储区
+ */
 void TCPClient::start_write() {
-	int n(crcsnd_.size());
-	if (n) {
-		sock_.async_write_some(buffer(crcsnd_.linearize(), n),
-				boost::bind(&TCPClient::handle_write, this,
-						placeholders::error, placeholders::bytes_transferred));
-	}
+	if (sndbusy_ || sndque_.empty() || !sock_.is_open()) return;
+
+	std::vector<const_buffer> bufs;
+	std::deque<message>::iterator it = sndque_.begin();
+	int n = sndque_.size() < TCP_GATHER_MAX ? int(sndque_.size()) : TCP_GATHER_MAX;
+
+	bufs.reserve(n);
+	bufs.push_back(buffer(it->first.get() + sndoff_, it->second - sndoff_));
+	for (++it; int(bufs.size()) < n; ++it) bufs.push_back(buffer(it->first.get(), it->second));
+	sndbusy_ = n;
+	++sndstat_.writes;
+	sock_.async_write_some(bufs,
+			keep_.Wrap(boost::bind(&TCPClient::handle_write, this,
+					placeholders::error, placeholders::bytes_transferred)));
 }
 
 void TCPClient::start() {
 	sock_.set_option(socket_base::keep_alive(true));
+	mutex_lock lock(mtxrcv_);
 	start_read();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 /*---------------- TCPServer: 服务器 ----------------*/
-TcpSPtr maketcp_server() {// 工厂函数, 创建TcpSPtr
-	return boost::make_shared<TCPServer>();
+TcpSPtr maketcp_server(const IOExecPtr& exec) {// 工厂函数, 创建TcpSPtr
+	return boost::make_shared<TCPServer>(exec);
 }
 
-TCPServer::TCPServer()
-	: acceptor_(keep_.GetService()) {
+TCPServer::TCPServer(const IOExecPtr& exec)
+	: keep_(exec)
+	, acceptor_(keep_.GetService()) {
 }
 
 TCPServer::~TCPServer() {
+	keep_.Shutdown();
 	boost::system::error_code ec;
 	if (acceptor_.is_open()) acceptor_.close(ec);
 }
@@ -269,9 +468,9 @@ int TCPServer::CreateServer(const uint16_t port) {
 
 void TCPServer::start_accept() {
 	if (acceptor_.is_open()) {
-		TcpCPtr client = maketcp_client();
+		TcpCPtr client = maketcp_client(keep_.GetExecutor());
 		acceptor_.async_accept(client->GetSocket(),
-				boost::bind(&TCPServer::handle_accept, this, client, placeholders::error));
+				keep_.Wrap(boost::bind(&TCPServer::handle_accept, this, client, placeholders::error)));
 	}
 }
 
@@ -10,13 +10,22 @@
  * - 支持无缓冲工作模式
  * - 客户端建立连接后设置KEEP_ALIVE
  * - 优化缓冲区操作
+ * @version 0.4
+ * @date 2026-10-17
+ * - 循环缓冲区改为连续存储的字节环: 批量拷贝收发数据, memchr/memmem查找标识符
+ * - 缓冲模式下直接接收至字节环, 发送时无需线性化
+ * - 支持在接收缓冲区中就地解析信息
+ * - 发送改为共享存储区的信息队列: 聚合写入, 排队的多条信息由一次系统调用发出
+ * - 队列容量受限时按策略拒绝、丢弃最早信息或限时等待, 不再截断信息
+ * - 绑定至共享或指定的执行器, 不再独占线程
  */
 
 #ifndef TCPASIO_H_
 #define TCPASIO_H_
 
 #include <boost/signals2.hpp>
-#include <boost/circular_buffer.hpp>
+#include <boost/function.hpp>
+#include <deque>
 #include <string>
 #include "IOServiceKeep.h"
 
@@ -25,10 +34,109 @@ using boost::asio::ip::tcp;
 //////////////////////////////////////////////////////////////////////////////
 /*---------------- TCPClient: 客户端 ----------------*/
 #define TCP_PACK_SIZE	1500		//< TCP包容量, 量纲: 字节
+#define TCP_BUFF_SIZE	(TCP_PACK_SIZE * 100)	//< 收发缓冲区容量, 量纲: 字节
+#define TCP_GATHER_MAX	64			//< 单次聚合写入的最大信息数量
+
+enum TCP_WRITE_POLICY {// 发送队列已满时的处理策略
+	TCP_WRITE_REJECT,		//< 拒绝新信息
+	TCP_WRITE_DROP_OLDEST,	//< 丢弃尚未发送的最早信息
+	TCP_WRITE_WAIT			//< 限时等待队列空间, 超时后拒绝
+};
+
+/*!
+ * @struct TCPWriteStat 发送队列统计
+ */
+struct TCPWriteStat {
+	int queued;			//< 排队信息数量
+	int bytes;			//< 排队数据长度, 量纲: 字节
+	int maxqueued;		//< 最大排队信息数量
+	int maxbytes;		//< 最大排队数据长度
+	uint64_t messages;	//< 已发送信息数量
+	uint64_t sent;		//< 已发送数据长度
+	uint64_t writes;	//< 发送操作次数
+	uint64_t rejected;	//< 被拒绝的信息数量
+	uint64_t dropped;	//< 被丢弃的信息数量, 含连接异常时未发送的信息
+	uint64_t timeouts;	//< 等待队列空间超时次数
+};
+
+/*!
+ * @class ByteRing 连续存储的字节环
+ * @note
+ * - 有效数据始终连续存储于[head, tail), 可直接用memchr/memmem查找或就地解析
+ * - 读出数据仅移动head; 尾部空间不足时由Compact()将数据移至存储区首部
+ * - 异步收发操作引用存储区期间不得调用Compact()
+ */
+class ByteRing {
+public:
+	ByteRing();
+
+protected:
+	boost::shared_array<char> buff_;	//< 存储区
+	int capacity_;	//< 存储区容量
+	int head_;		//< 有效数据起始位置
+	int tail_;		//< 有效数据结束位置
+
+public:
+	/*!
+	 * @brief 设置容量, 并清除已存储数据
+	 */
+	void SetCapacity(int capacity);
+	/*!
+	 * @brief 清除已存储数据
+	 */
+	void Clear();
+	/*!
+	 * @brief 查看容量
+	 */
+	int Capacity() const;
+	/*!
+	 * @brief 查看有效数据长度
+	 */
+	int Size() const;
+	/*!
+	 * @brief 查看有效数据首地址
+	 */
+	const char* Data() const;
+	/*!
+	 * @brief 查看尾部可写空间首地址
+	 */
+	char* Space();
+	/*!
+	 * @brief 查看尾部可写空间长度
+	 */
+	int Room() const;
+	/*!
+	 * @brief 将有效数据移至存储区首部
+	 */
+	void Compact();
+	/*!
+	 * @brief 确认已写入尾部空间的数据长度
+	 */
+	void Commit(int n);
+	/*!
+	 * @brief 从头部清除数据
+	 */
+	void Consume(int n);
+	/*!
+	 * @brief 向尾部空间拷贝数据
+	 * @return
+	 * 实际拷贝数据长度
+	 */
+	int Append(const char* data, int n);
+	/*!
+	 * @brief 查找标识串第一次出现的位置
+	 * @return
+	 * 相对有效数据首地址的位置. 若flag不存在则返回-1
+	 */
+	int Find(const char* flag, int len, int from = 0) const;
+};
 
 class TCPClient {
 public:
-	TCPClient();
+	/*!
+	 * @param exec 执行器. 空指针表示共享执行器
+	 */
+	TCPClient(const IOExecPtr& exec = IOExecPtr());
 	virtual ~TCPClient();
 
 public:
@@ -38,14 +146,22 @@ public:
 	// 基于boost::signals2声明插槽类型
 	typedef CallbackFunc::slot_type CBSlot;
 	typedef boost::unique_lock<boost::mutex> mutex_lock;	//< 互斥锁
-	typedef boost::circular_buffer<char> crcbuff;	//< 循环缓冲区
 	typedef boost::shared_array<char> charray;	//< 字符型数组
+	typedef std::pair<charray, int> message;	//< 待发送信息: 存储区与长度
+	/*!
+	 * @brief 就地解析函数
+	 * @param data 已接收信息首地址
+	 * @param n    已接收信息长度
+	 * @return
+	 * 已解析并可清除的数据长度. 0: 信息不完整, 等待后续数据
+	 */
+	typedef boost::function<int (const char* data, const int n)> ParseFunc;
 
 	friend class TCPServer;
 
 protected:
 	// 成员变量
-	IOServiceKeep keep_;	//< 提供io_service对象
+	IOServiceKeep keep_;	//< 绑定执行器
 	tcp::socket   sock_;	//< 套接字
 	CallbackFunc  cbconn_;	//< connect回调函数
 	CallbackFunc  cbrcv_;	//< receive回调函数
@@ -54,12 +170,20 @@ protected:
 	bool usebuf_;	//< 启用循环缓冲区
 	int bytercv_;	//< 已接收信息长度
 	charray bufrcv_;	//< 单条接收缓冲区
-	crcbuff crcrcv_;		//< 循环接收缓冲区
-	crcbuff crcsnd_;		//< 循环发送缓冲区
+	ByteRing crcrcv_;		//< 循环接收缓冲区
+	std::deque<message> sndque_;	//< 发送队列
+	int sndbusy_;			//< 正在发送的信息数量, 位于队首
+	int sndoff_;			//< 队首信息已发送长度
+	int sndlimit_;			//< 发送队列容量, 量纲: 字节
+	int sndpolicy_;			//< 发送队列已满时的处理策略
+	int sndwait_;			//< 等待队列空间的时限, 量纲: 毫秒
+	TCPWriteStat sndstat_;	//< 发送队列统计
 	boost::mutex mtxrcv_;	//< 接收互斥锁
 	boost::mutex mtxsnd_;	//< 发送互斥锁
+	boost::condition_variable cvsnd_;	//< 事件: 发送队列出现空间
 
 	bool pause_rcv_;	//< 暂停接收
+	bool reading_;		//< 存在未完成的异步接收
 
 public:
 	// 接口
@@ -99,9 +223,10 @@ public:
 	bool IsOpen();
 	/*!
 	 * @brief 启用或禁用TCPClient自带缓冲区功能
-	 * @param usebuf true启用, false禁用
+	 * @param usebuf   true启用, false禁用
+	 * @param capacity 接收缓冲区容量, 同时作为发送队列容量. 应不小于最长信息与TCP_PACK_SIZE之和
 	 */
-	void UseBuffer(bool usebuf = true);
+	void UseBuffer(bool usebuf = true, int capacity = TCP_BUFF_SIZE);
 	/*!
 	 * @brief 注册connect回调函数, 处理与服务器的连接结果
 	 * @param slot 函数插槽
@@ -142,14 +267,46 @@ public:
 	 * 实际读取数据长度
 	 */
 	int Read(char* buff, const int len, const int from = 0);
+	/*!
+	 * @brief 就地解析已接收信息, 并从缓冲区中清除已解析数据
+	 * @param proc 解析函数. 循环调用直至其返回0或数据全部解析
+	 * @return
+	 * 已清除数据长度
+	 * @note
+	 * 解析函数在持有接收锁时调用, 不得调用本对象的Lookup()、Read()或Parse()
+	 */
+	int Parse(const ParseFunc& proc);
 	/*!
 	 * @brief 发送指定数据
 	 * @param buff 待发送数据存储区指针
 	 * @param len  待发送数据长度
 	 * @return
-	 * 实际发送数据长度
+	 * 实际发送数据长度. 缓冲模式下拷贝后整条排队, 队列不接收时返回0
 	 */
 	int Write(const char* buff, const int len);
+	/*!
+	 * @brief 发送共享存储区中的数据, 无需拷贝
+	 * @param buff 待发送数据存储区. 排队期间不得修改
+	 * @param len  待发送数据长度
+	 * @return
+	 * 信息是否进入发送队列
+	 * @note
+	 * 同一存储区可同时提交给多个连接. 仅用于缓冲模式
+	 */
+	bool Write(const charray& buff, const int len);
+	/*!
+	 * @brief 设置发送队列容量与已满时的处理策略
+	 * @param limit   队列容量, 量纲: 字节
+	 * @param policy  处理策略, TCP_WRITE_POLICY
+	 * @param timeout TCP_WRITE_WAIT策略的等待时限, 量纲: 毫秒
+	 * @note
+	 * TCP_WRITE_WAIT策略阻塞调用线程, 不得在本连接的回调函数中发送
+	 */
+	void SetWritePolicy(int limit, int policy = TCP_WRITE_REJECT, int timeout = 1000);
+	/*!
+	 * @brief 查看发送队列统计
+	 */
+	TCPWriteStat GetWriteStat();
 
 protected:
 	// 功能
@@ -173,10 +330,20 @@ protected:
 	void handle_write(const boost::system::error_code& ec, int n);
 	/*!
 	 * @brief 尝试接收网络信息
+	 * @note
+	 * 调用者持有mtxrcv_
 	 */
 	void start_read();
 	/*!
-	 * @brief 尝试发送缓冲区数据
+	 * @brief 信息进入发送队列
+	 * @note
+	 * 调用者持有mtxsnd_
+	 */
+	bool enqueue(mutex_lock& lck, const charray& buff, const int len);
+	/*!
+	 * @brief 尝试发送队列中的信息: 聚合写入队首起的多条信息
+	 * @note
+	 * 调用者持有mtxsnd_
 	 */
 	void start_write();
 	/*!
@@ -187,16 +354,20 @@ protected:
 typedef boost::shared_ptr<TCPClient> TcpCPtr;	//< 客户端网络资源访问指针类型
 /*!
  * @brief 工厂函数, 创建TCP客户端指针
+ * @param exec 执行器. 空指针表示共享执行器
  * @return
  * 基于TCPClient的指针
  */
-extern TcpCPtr maketcp_client();
+extern TcpCPtr maketcp_client(const IOExecPtr& exec = IOExecPtr());
 
 //////////////////////////////////////////////////////////////////////////////
 /*---------------- TCPServer: 服务器 ----------------*/
 class TCPServer {
 public:
-	TCPServer();
+	/*!
+	 * @param exec 执行器. 空指针表示共享执行器. 已接受的连接使用同一执行器
+	 */
+	TCPServer(const IOExecPtr& exec = IOExecPtr());
 	virtual ~TCPServer();
 
 public:
@@ -208,7 +379,7 @@ public:
 
 protected:
 	// 成员变量
-	IOServiceKeep keep_;		//< 提供io_service对象
+	IOServiceKeep keep_;		//< 绑定执行器
 	tcp::acceptor acceptor_;	//< 服务套接口
 	CallbackFunc  cbaccept_;	//< accept回调函数
 
@@ -245,10 +416,11 @@ protected:
 typedef boost::shared_ptr<TCPServer> TcpSPtr;	//< 服务器网络资源访问指针类型
 /*!
  * @brief 工厂函数, 创建TCP服务器指针
+ * @param exec 执行器. 空指针表示共享执行器
  * @return
  * 基于TCPServer的指针
  */
-extern TcpSPtr maketcp_server();
+extern TcpSPtr maketcp_server(const IOExecPtr& exec = IOExecPtr());
 
 //////////////////////////////////////////////////////////////////////////////
 
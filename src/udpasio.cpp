@@ -13,11 +13,12 @@ using std::string;
 using namespace boost::asio;
 
 //////////////////////////////////////////////////////////////////////////////
-UdpPtr makeudp_session(uint16_t port) {
-	return boost::make_shared<UDPSession>(port);
+UdpPtr makeudp_session(uint16_t port, const IOExecPtr& exec) {
+	return boost::make_shared<UDPSession>(port, exec);
 }
 
-UDPSession::UDPSession(const uint16_t portLoc) {
+UDPSession::UDPSession(const uint16_t portLoc, const IOExecPtr& exec)
+	: keep_(exec) {
 	bufrcv_.reset(new char[UDP_PACK_SIZE]);
 	bytercv_ = 0;
 	connected_ = false;
@@ -29,6 +30,7 @@ UDPSession::UDPSession(const uint16_t portLoc) {
 }
 
 UDPSession::~UDPSession() {
+	keep_.Shutdown();
 	Close();
 }
 
@@ -36,7 +38,7 @@ void UDPSession::Connect(const char *ip, const uint16_t port) {
 	udp::resolver resolver(keep_.GetService());
 	udp::resolver::query query(ip, boost::lexical_cast<string>(port));
 	udp::endpoint remote = *(resolver.resolve(query));
-	sock_->async_connect(remote, boost::bind(&UDPSession::handle_connect, this, placeholders::error));
+	sock_->async_connect(remote, keep_.Wrap(boost::bind(&UDPSession::handle_connect, this, placeholders::error)));
 }
 
 void UDPSession::Close() {
@@ -92,13 +94,13 @@ void UDPSession::Write(const void *data, const int n) {
 
 	if (connected_) {
 		sock_->async_send(buffer(data, n),
-				boost::bind(&UDPSession::handle_write, this,
-						placeholders::error, placeholders::bytes_transferred));
+				keep_.Wrap(boost::bind(&UDPSession::handle_write, this,
+						placeholders::error, placeholders::bytes_transferred)));
 	}
 	else {
 		sock_->async_send_to(buffer(data, n), remote_,
-				boost::bind(&UDPSession::handle_write, this,
-						placeholders::error, placeholders::bytes_transferred));
+				keep_.Wrap(boost::bind(&UDPSession::handle_write, this,
+						placeholders::error, placeholders::bytes_transferred)));
 	}
 }
 
@@ -124,12 +126,12 @@ void UDPSession::handle_write(const error_code& ec, const int n) {
 void UDPSession::start_read() {
 	if (connected_) {
 		sock_->async_receive(buffer(bufrcv_.get(), UDP_PACK_SIZE),
-				boost::bind(&UDPSession::handle_read, this,
-						placeholders::error, placeholders::bytes_transferred));
+				keep_.Wrap(boost::bind(&UDPSession::handle_read, this,
+						placeholders::error, placeholders::bytes_transferred)));
 	}
 	else {
 		sock_->async_receive_from(buffer(bufrcv_.get(), UDP_PACK_SIZE), remote_,
-				boost::bind(&UDPSession::handle_read, this,
-						placeholders::error, placeholders::bytes_transferred));
+				keep_.Wrap(boost::bind(&UDPSession::handle_read, this,
+						placeholders::error, placeholders::bytes_transferred)));
 	}
 }
@@ -23,8 +23,9 @@ public:
 	/*!
 	 * @brief 构造函数
 	 * @param portLoc 本地UDP端口. 0代表由系统分配
+	 * @param exec    执行器. 空指针表示共享执行器
 	 */
-	UDPSession(const uint16_t portLoc = 0);
+	UDPSession(const uint16_t portLoc = 0, const IOExecPtr& exec = IOExecPtr());
 	virtual ~UDPSession();
 
 public:
@@ -40,7 +41,7 @@ protected:
 
 protected:
 	// 成员变量
-	IOServiceKeep keep_;	//< 维持boost::asio::io_service对象有效
+	IOServiceKeep keep_;	//< 绑定执行器
 	sockptr sock_;			//< UDP套接口
 	bool connected_;		//< 是否面向连接
 	udp::endpoint remote_;	//< 对应远程端点地址
@@ -145,9 +146,11 @@ protected:
 typedef boost::shared_ptr<UDPSession> UdpPtr;
 /*!
  * @brief 工厂函数, 创建UDP客户端指针
+ * @param port 本地UDP端口. 0代表由系统分配
+ * @param exec 执行器. 空指针表示共享执行器
  * @return
  * 基于UDPClient的指针
  */
-extern UdpPtr makeudp_session(uint16_t port = 0);
+extern UdpPtr makeudp_session(uint16_t port = 0, const IOExecPtr& exec = IOExecPtr());
 
 #endif